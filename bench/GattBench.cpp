@@ -0,0 +1,2113 @@
+/*
+ * Host-side microbenchmark for the CustomBLE GATT hot paths.
+ *
+ * Runs against the NimBLE stand-in in host_sim/ and reports, for 1, 10, 100
+ * and 1000 characteristics:
+ *   - GATT table build time (ServiceManager -> add_services_to_nimble -> start),
+ *     on the heap, in one Arena sized by a dry run, and for a compile-time
+ *     StaticGatt table
+ *   - read/write dispatch through Characteristic::handle_access
+ *   - read/write dispatch through ServiceManager::ble_conn_access_cb
+ *   - characteristic lookup by value handle and by UUID (checks every entry),
+ *     and GAP subscribe events, which resolve the characteristic by handle
+ *   - notifications to one subscribed central, sent immediately and batched
+ *     through the NotificationEngine (one host task wakeup per round), and
+ *     suppressed by change detection when the value did not change
+ *   - reads of a slow read callback with and without the read cache
+ *   - reads/writes of a TypedCharacteristic struct (checks the wire encoding)
+ *   - a 25-sensor dashboard refreshed with 25 Reads, one Read Multiple
+ *     Variable and one read of an AggregateCharacteristic (checks the payloads)
+ *   - PublishedValue publish and GATT read cost, reads racing a publishing
+ *     thread (checks that no torn value is served) and publish-triggered notifications
+ *   - host task cost of writes to a slow (2 us) write callback, run directly and
+ *     through a DeferredWriteQueue drained by another thread (checks order,
+ *     rejection when full and the drop policy)
+ *   - a 256 KiB Write Without Response upload into an IngestCharacteristic,
+ *     drained in batches (checks content, gap, stale and overflow counters)
+ *   - a 256 KiB StreamCharacteristic transfer with credits, acks and a
+ *     reconnect/resume midway (checks sequence numbers and content)
+ *   - LZ4 compression ratio and speed on JSON config, log text and random
+ *     data, as 480-byte values and as a stream of linked 244-byte blocks; reads,
+ *     writes and notifications of a compressed characteristic, and a compressed
+ *     256 KiB log stream with a resume midway (checks round trips and the descriptor)
+ *   - 256 KiB sent and 64 KiB received over an L2capEndpoint channel to the
+ *     stand-in's peer, with credit stalls and a paused receiver (checks content)
+ *   - advertising payloads packed by AdvertisingBuilder in legacy (with scan
+ *     response) and extended mode (checks the exact bytes, the incomplete UUID
+ *     list, name shortening and what apply() hands to the stack)
+ *   - complete long reads (Read + Read Blob) of a 396-byte value
+ *   - complete long writes (Prepare Write + Execute Write) of a 396-byte value
+ *   - GATT metadata memory (ServiceManager::memory_usage()), checked against a budget
+ *   - built as customble_bench_stats: the same cases with CONFIG_CUSTOMBLE_ACCESS_STATS,
+ *     plus a read of the diagnostic service
+ * together with heap allocations per operation.
+ *
+ * Usage: customble_bench [min_ops_per_case]
+ */
+#include <CustomBLE/AdvertisingBuilder.hpp>
+#include <CustomBLE/AggregateCharacteristic.hpp>
+#include <CustomBLE/Arena.hpp>
+#include <CustomBLE/ServiceManager.hpp>
+#include <CustomBLE/Service.hpp>
+#include <CustomBLE/Characteristic.hpp>
+#include <CustomBLE/Compression.hpp>
+#include <CustomBLE/DeferredWriteQueue.hpp>
+#include <CustomBLE/IngestCharacteristic.hpp>
+#include <CustomBLE/L2capEndpoint.hpp>
+#include <CustomBLE/PublishedValue.hpp>
+#include <CustomBLE/StaticGattTable.hpp>
+#include <CustomBLE/StreamCharacteristic.hpp>
+#include <CustomBLE/TypedCharacteristic.hpp>
+#include <HostSim.hpp>
+#include <esp_timer.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__GLIBC__)
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+}
+#endif
+
+namespace {
+
+size_t g_allocations = 0;
+
+} // namespace
+
+#if defined(__GLIBC__)
+// Count every heap allocation in the process; operator new ends up here too.
+extern "C" void* malloc(size_t size) {
+    ++g_allocations;
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+    ++g_allocations;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+    ++g_allocations;
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void free(void* ptr) {
+    __libc_free(ptr);
+}
+#endif
+
+using namespace CustomBLE;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+const size_t kSizes[] = {1, 10, 100, 1000};
+const char* const kFixedValue = "firmware-2.4.1+build.20240611";
+const int64_t kSlowReadUs = 2;
+
+enum class Kind {
+    Pointer,
+    String,
+    Fixed,
+    Slow,
+};
+
+struct Result {
+    double ns_per_op;
+    double allocs_per_op;
+};
+
+constexpr ble_uuid128_t make_uuid(uint32_t index, uint8_t salt) {
+    ble_uuid128_t uuid = BLE_UUID128_INIT(0x00, 0x00, 0x00, 0x00, 0x8B, 0xC1, 0x6D, 0x4E,
+                                          0xB9, 0xCC, 0x87, 0x82, 0xD8, 0xAA, 0x42, 0xC5);
+    uuid.value[0] = static_cast<uint8_t>(index);
+    uuid.value[1] = static_cast<uint8_t>(index >> 8);
+    uuid.value[2] = static_cast<uint8_t>(index >> 16);
+    uuid.value[3] = salt;
+    return uuid;
+}
+
+// Compile-time GATT tables of N pointer characteristics, placed in .rodata.
+uint32_t g_static_values[1000];
+uint16_t g_static_handles[1000];
+
+template<size_t N>
+constexpr std::array<ble_uuid128_t, N> make_static_uuids() {
+    std::array<ble_uuid128_t, N> uuids {};
+    for (size_t i = 0; i < N; ++i) {
+        uuids[i] = make_uuid(static_cast<uint32_t>(i), 0x04);
+    }
+    return uuids;
+}
+
+template<size_t N>
+constexpr std::array<ble_uuid128_t, N> kStaticUuids = make_static_uuids<N>();
+constexpr ble_uuid128_t kStaticServiceUuid = make_uuid(0xFFFFFF, 0xEF);
+
+template<size_t N>
+constexpr std::array<ble_gatt_chr_def, N + 1> make_static_chrs() {
+    std::array<ble_gatt_chr_def, N + 1> chrs {};
+    for (size_t i = 0; i < N; ++i) {
+        chrs[i] = StaticGatt::pointer_read_write(kStaticUuids<N>[i], &g_static_values[i], &g_static_handles[i]);
+    }
+    return chrs;
+}
+
+template<size_t N>
+constexpr std::array<ble_gatt_chr_def, N + 1> kStaticChrs = make_static_chrs<N>();
+template<size_t N>
+constexpr auto kStaticSvcs = StaticGatt::services(StaticGatt::primary_service(kStaticServiceUuid, kStaticChrs<N>.data()));
+
+/**
+ * One GATT database of N characteristics of a single kind, registered with
+ * both the NimBLE stand-in and the connection manager stand-in.
+ */
+struct Fixture {
+    std::vector<std::string> names;
+    std::vector<uint32_t> pointer_values;
+    std::vector<std::string> string_values;
+    std::vector<uint16_t> handles;
+    std::vector<Characteristic*> characteristics;
+    ServiceManager manager;
+
+    Fixture(Kind kind, size_t count) : names(count), pointer_values(count, 0), string_values(count) {
+        HostSim::reset();
+        for (size_t i = 0; i < count; ++i) {
+            names[i] = "Bench characteristic " + std::to_string(i);
+        }
+        auto service = manager.emplace_service("Bench", make_uuid(0xFFFFFF, 0xEE));
+        for (size_t i = 0; i < count; ++i) {
+            ble_uuid128_t uuid = make_uuid(static_cast<uint32_t>(i), 0x01);
+            switch (kind) {
+                case Kind::Pointer:
+                    service->add_characteristic(Characteristic::from_pointer_read_write(uuid, &pointer_values[i], names[i].c_str()));
+                    break;
+                case Kind::String: {
+                    std::string* value = &string_values[i];
+                    service->emplace_characteristic(names[i].c_str(), uuid,
+                        [value]() { return *value; },
+                        [value](const std::string& data) { *value = data; });
+                    break;
+                }
+                case Kind::Fixed:
+                    service->add_characteristic(Characteristic::from_fixed_value(uuid, kFixedValue, names[i].c_str()));
+                    break;
+                case Kind::Slow: {
+                    // Stands in for an I2C/ADC transaction in the read callback.
+                    uint32_t* value = &pointer_values[i];
+                    service->emplace_characteristic(names[i].c_str(), uuid, [value](ValueWriter& out) {
+                        int64_t until = esp_timer_get_time() + kSlowReadUs;
+                        while (esp_timer_get_time() < until) {
+                        }
+                        return out.append(value, sizeof(*value));
+                    });
+                    break;
+                }
+            }
+        }
+        if (manager.add_services_to_nimble("bench") != 0 || HostSim::start() != 0) {
+            fprintf(stderr, "GATT registration failed\n");
+            exit(1);
+        }
+        if (manager.register_with_conn_mgr() != ESP_OK) {
+            fprintf(stderr, "conn-mgr registration failed\n");
+            exit(1);
+        }
+        handles.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            ble_uuid128_t uuid = make_uuid(static_cast<uint32_t>(i), 0x01);
+            handles.push_back(HostSim::find_value_handle(&uuid.u));
+        }
+        for (const auto& entry : service->get_characteristics_manager().get_entries()) {
+            characteristics.push_back(entry.characteristic.get());
+        }
+        HostSim::set_gap_listener(&ServiceManager::gap_event_callback, &manager);
+    }
+};
+
+template<typename Op>
+Result measure(size_t count, size_t min_ops, Op&& op) {
+    size_t rounds = (min_ops + count - 1) / count;
+    // Warm-up pass so lazily grown buffers do not count against steady state.
+    for (size_t i = 0; i < count; ++i) {
+        op(i);
+    }
+    size_t allocs_before = g_allocations;
+    auto start = Clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        for (size_t i = 0; i < count; ++i) {
+            op(i);
+        }
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    double ops = static_cast<double>(rounds * count);
+    return {elapsed / ops, static_cast<double>(g_allocations - allocs_before) / ops};
+}
+
+void check(int rc, const char* what) {
+    if (rc != 0) {
+        fprintf(stderr, "%s failed: %d\n", what, rc);
+        exit(1);
+    }
+}
+
+// Silences the log lines of tag that a case provokes on purpose, so they do not interleave with the table.
+struct ExpectedLogs {
+    explicit ExpectedLogs(const char* tag) : tag(tag) { esp_log_level_set(tag, ESP_LOG_NONE); }
+    ~ExpectedLogs() { esp_log_level_set(tag, ESP_LOG_WARN); }
+    const char* tag;
+};
+
+void print_row(const char* name, size_t count, const Result& result) {
+    printf("%-28s %6zu %12.1f %12.2f\n", name, count, result.ns_per_op, result.allocs_per_op);
+}
+
+void build_table(Arena* arena, const std::vector<std::string>& names, std::vector<uint32_t>& values) {
+    ServiceManager manager(arena);
+    manager.reserve(1);
+    auto service = manager.emplace_service("Bench", make_uuid(0xFFFFFF, 0xEE));
+    service->reserve(names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+        service->add_characteristic(Characteristic::from_pointer_read_write(
+            make_uuid(static_cast<uint32_t>(i), 0x01), &values[i], names[i].c_str()));
+    }
+    check(manager.add_services_to_nimble("bench"), "add_services_to_nimble");
+    check(HostSim::start(), "HostSim::start");
+}
+
+void bench_build(size_t count) {
+    std::vector<std::string> names(count);
+    std::vector<uint32_t> values(count, 0);
+    for (size_t i = 0; i < count; ++i) {
+        names[i] = "Bench characteristic " + std::to_string(i);
+    }
+    HostSim::reset();
+    size_t allocs_before = g_allocations;
+    auto start = Clock::now();
+    build_table(nullptr, names, values);
+    auto elapsed = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    printf("%-28s %6zu %12.1f %12zu\n", "build/gatt-table (us, allocs)", count, elapsed, g_allocations - allocs_before);
+
+    // Dry run against a measuring arena, then the same build in one exactly sized block.
+    Arena dry_run;
+    HostSim::reset();
+    build_table(&dry_run, names, values);
+    HostSim::reset();
+    Arena arena(dry_run.required());
+    allocs_before = g_allocations;
+    start = Clock::now();
+    build_table(&arena, names, values);
+    elapsed = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    printf("%-28s %6zu %12.1f %12zu\n", "build/arena (us, allocs)", count, elapsed, g_allocations - allocs_before);
+    if (arena.overflow_bytes() != 0 || arena.used() > arena.required()) {
+        fprintf(stderr, "arena sized from the dry run overflowed: %zu of %zu bytes\n", arena.overflow_bytes(), arena.capacity());
+        exit(1);
+    }
+}
+
+template<size_t N>
+void bench_static_table(size_t min_ops) {
+    HostSim::reset();
+    size_t allocs_before = g_allocations;
+    auto start = Clock::now();
+    check(ServiceManager::add_services_to_nimble(kStaticSvcs<N>.data(), "bench"), "add_services_to_nimble");
+    check(HostSim::start(), "HostSim::start");
+    auto elapsed = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    printf("%-28s %6zu %12.1f %12zu\n", "build/static-table (us, allocs)", N, elapsed, g_allocations - allocs_before);
+
+    uint16_t conn = HostSim::connect(247);
+    uint8_t out[BLE_ATT_MTU_MAX];
+    size_t out_len = 0;
+    print_row("read/static pointer", N, measure(N, min_ops, [&](size_t i) {
+        check(HostSim::read(conn, g_static_handles[i], out, sizeof(out), &out_len), "read");
+    }));
+}
+
+// Memory budget of the pointer fixture (see ServiceManager::memory_usage()); the bench fails above it.
+constexpr size_t kMemoryBudgetBase = 4096;
+constexpr size_t kMemoryBudgetPerCharacteristic = 640;
+
+void check_memory_budget(const ServiceManager& manager, size_t count) {
+    ServiceManager::MemoryUsage usage = manager.memory_usage();
+    printf("%-28s %6zu %12zu %12zu\n", "memory/gatt-table (B, allocs)", count, usage.total(), usage.heap_allocations);
+    size_t budget = kMemoryBudgetBase + count * kMemoryBudgetPerCharacteristic;
+    if (usage.total() > budget) {
+        fprintf(stderr, "GATT metadata uses %zu bytes, budget is %zu\n%s", usage.total(), budget, manager.memory_report().c_str());
+        exit(1);
+    }
+}
+
+void bench_dispatch(size_t count, size_t min_ops) {
+    uint8_t out[BLE_ATT_MTU_MAX];
+    size_t out_len = 0;
+
+    {
+        Fixture fixture(Kind::Pointer, count);
+        check_memory_budget(fixture.manager, count);
+        uint16_t conn = HostSim::connect(247);
+        print_row("read/pointer", count, measure(count, min_ops, [&](size_t i) {
+            check(HostSim::read(conn, fixture.handles[i], out, sizeof(out), &out_len), "read");
+        }));
+        uint32_t value = 0x12345678;
+        print_row("write/pointer", count, measure(count, min_ops, [&](size_t i) {
+            check(HostSim::write(conn, fixture.handles[i], &value, sizeof(value)), "write");
+        }));
+        print_row("conn-mgr read/pointer", count, measure(count, min_ops, [&](size_t i) {
+            check(HostSim::conn_mgr_read(0, i, out, sizeof(out), &out_len), "conn_mgr_read");
+        }));
+        print_row("conn-mgr write/pointer", count, measure(count, min_ops, [&](size_t i) {
+            check(HostSim::conn_mgr_write(0, i, &value, sizeof(value)), "conn_mgr_write");
+        }));
+        for (size_t i = 0; i < count; ++i) {
+            if (fixture.manager.find_by_value_handle(fixture.handles[i]) != fixture.characteristics[i] ||
+                fixture.manager.find_by_uuid(make_uuid(static_cast<uint32_t>(i), 0x01)) != fixture.characteristics[i]) {
+                fprintf(stderr, "lookup: characteristic %zu not found by handle or UUID\n", i);
+                exit(1);
+            }
+        }
+        if (fixture.manager.find_by_value_handle(0) || fixture.manager.find_by_value_handle(fixture.handles[0] - 1) ||
+            fixture.manager.find_by_uuid(make_uuid(static_cast<uint32_t>(count), 0x01))) {
+            fprintf(stderr, "lookup: unknown handle or UUID resolved to a characteristic\n");
+            exit(1);
+        }
+        print_row("lookup/value handle", count, measure(count, min_ops, [&](size_t i) {
+            check(fixture.manager.find_by_value_handle(fixture.handles[i]) ? 0 : -1, "find_by_value_handle");
+        }));
+        print_row("lookup/uuid", count, measure(count, min_ops, [&](size_t i) {
+            check(fixture.manager.find_by_uuid(make_uuid(static_cast<uint32_t>(i), 0x01)) ? 0 : -1, "find_by_uuid");
+        }));
+        // Every CCCD write raises a GAP subscribe event, which resolves the characteristic by handle.
+        print_row("subscribe/gap event", count, measure(count, min_ops, [&](size_t i) {
+            check(HostSim::subscribe(conn, fixture.handles[i], true), "subscribe");
+        }));
+        if (!fixture.characteristics[count - 1]->has_subscribers()) {
+            fprintf(stderr, "subscribe: GAP event did not reach the characteristic\n");
+            exit(1);
+        }
+        print_row("notify/pointer", count, measure(count, min_ops, [&](size_t i) {
+            check(fixture.characteristics[i]->notify(), "notify");
+        }));
+        size_t wakeups_before = fixture.manager.get_notification_engine().wakeup_count();
+        size_t sent_before = HostSim::notifications_sent();
+        print_row("notify/pointer batched", count, measure(count, min_ops, [&](size_t i) {
+            fixture.characteristics[i]->schedule_notify();
+            if (i + 1 == count) {
+                HostSim::run_host_events();
+            }
+        }));
+        size_t wakeups = fixture.manager.get_notification_engine().wakeup_count() - wakeups_before;
+        size_t sent = HostSim::notifications_sent() - sent_before;
+        if (wakeups == 0 || sent != wakeups * count) {
+            fprintf(stderr, "batched notify: %zu notifications in %zu wakeups\n", sent, wakeups);
+            exit(1);
+        }
+        for (Characteristic* characteristic : fixture.characteristics) {
+            characteristic->set_notify_on_change(true);
+        }
+        sent_before = HostSim::notifications_sent();
+        print_row("notify/pointer unchanged", count, measure(count, min_ops, [&](size_t i) {
+            check(fixture.characteristics[i]->notify(), "notify");
+        }));
+        // Only the warm-up pass may reach the air; every later value is identical.
+        if (HostSim::notifications_sent() - sent_before != count) {
+            fprintf(stderr, "on-change notify sent %zu of unchanged values\n",
+                    HostSim::notifications_sent() - sent_before);
+            exit(1);
+        }
+    }
+    {
+        Fixture fixture(Kind::String, count);
+        uint16_t conn = HostSim::connect(247);
+        const char payload[] = "set-point=42.5;mode=auto;rate=10";
+        print_row("write/string", count, measure(count, min_ops, [&](size_t i) {
+            check(HostSim::write(conn, fixture.handles[i], payload, sizeof(payload) - 1), "write");
+        }));
+        print_row("read/string", count, measure(count, min_ops, [&](size_t i) {
+            check(HostSim::read(conn, fixture.handles[i], out, sizeof(out), &out_len), "read");
+        }));
+    }
+    {
+        Fixture fixture(Kind::Fixed, count);
+        uint16_t conn = HostSim::connect(247);
+        print_row("read/fixed", count, measure(count, min_ops, [&](size_t i) {
+            check(HostSim::read(conn, fixture.handles[i], out, sizeof(out), &out_len), "read");
+        }));
+    }
+    {
+        Fixture fixture(Kind::Slow, count);
+        uint16_t conn = HostSim::connect(247);
+        print_row("read/slow", count, measure(count, min_ops, [&](size_t i) {
+            check(HostSim::read(conn, fixture.handles[i], out, sizeof(out), &out_len), "read");
+        }));
+        for (Characteristic* characteristic : fixture.characteristics) {
+            characteristic->set_read_cache_ttl(60000);
+        }
+        print_row("read/slow cached", count, measure(count, min_ops, [&](size_t i) {
+            check(HostSim::read(conn, fixture.handles[i], out, sizeof(out), &out_len), "read");
+        }));
+        print_row("conn-mgr read/slow cached", count, measure(count, min_ops, [&](size_t i) {
+            check(HostSim::conn_mgr_read(0, i, out, sizeof(out), &out_len), "conn_mgr_read");
+        }));
+    }
+}
+
+struct TypedSample {
+    uint8_t id;
+    uint32_t timestamp;
+    float value;
+    int16_t axes[3];
+};
+
+} // namespace
+
+template<>
+struct CustomBLE::WireFields<TypedSample> {
+    static constexpr auto members = std::make_tuple(&TypedSample::id, &TypedSample::timestamp,
+                                                    &TypedSample::value, &TypedSample::axes);
+};
+
+namespace {
+
+// Flags changed after a characteristic was added must still reach the GATT table.
+void check_late_flags() {
+    HostSim::reset();
+    ServiceManager manager;
+    static uint32_t value = 7;
+    ble_uuid128_t indicate_uuid = make_uuid(0, 0x0A);
+    auto service = manager.emplace_service("Bench", make_uuid(0xFFFFFF, 0xE9));
+    auto indicated = service->emplace_characteristic("Indicated", indicate_uuid, [](ValueWriter& out) {
+        return out.append(&value, sizeof(value));
+    });
+    indicated->set_indicate_enabled(true);
+    static uint32_t command_value = 0;
+    ble_uuid128_t command_uuid = make_uuid(1, 0x0A);
+    auto command = service->emplace_characteristic("Command", command_uuid, nullptr, [](ValueReader& in) {
+        return in.copy_to(&command_value, sizeof(command_value));
+    });
+    command->set_write_without_response_enabled(true);
+    check(manager.add_services_to_nimble("bench"), "add_services_to_nimble");
+    check(HostSim::start(), "HostSim::start");
+    HostSim::set_gap_listener(&ServiceManager::gap_event_callback, &manager);
+    uint16_t conn = HostSim::connect(247);
+    check(HostSim::subscribe(conn, indicated->get_handle(), false, true), "subscribe to indications");
+    if (!indicated->has_subscribers()) {
+        fprintf(stderr, "late flags: indication subscription not recorded\n");
+        exit(1);
+    }
+    uint32_t written = 0x5A5A1234;
+    check(HostSim::write_no_response(conn, command->get_handle(), &written, sizeof(written)), "write command");
+    if (command_value != written) {
+        fprintf(stderr, "late flags: write command not delivered\n");
+        exit(1);
+    }
+    HostSim::disconnect(conn);
+
+    // Adding to the frozen table is refused, by value as well as by pointer.
+    esp_err_t late;
+    {
+        ExpectedLogs quiet("CustomBLE/Service");
+        late = service->add_characteristic(Characteristic("Late", make_uuid(2, 0x0A), nullptr, nullptr));
+    }
+    if (late != ESP_ERR_INVALID_STATE || service->get_characteristics_manager().size() != 2) {
+        fprintf(stderr, "late flags: characteristic added to a frozen table (%d)\n", late);
+        exit(1);
+    }
+}
+
+// A copied characteristic's change detector keeps its mode but sends its first value.
+void check_change_detector_copy() {
+    const uint8_t value[4] = {1, 2, 3, 4};
+    ChangeDetector original;
+    original.enable_deadband<int32_t>(2);
+    original.should_send(ValueReader(value, sizeof(value)));
+    bool suppressed = !original.should_send(ValueReader(value, sizeof(value)));
+    ChangeDetector copy(original);
+    ChangeDetector assigned;
+    assigned = original;
+    for (ChangeDetector* detector : {&copy, &assigned}) {
+        if (!suppressed || detector->get_mode() != ChangeDetector::Mode::Deadband || detector->suppressed_count() != 0 ||
+            !detector->should_send(ValueReader(value, sizeof(value))) ||
+            detector->should_send(ValueReader(value, sizeof(value)))) {
+            fprintf(stderr, "change detector: copy kept the last value or lost the deadband\n");
+            exit(1);
+        }
+    }
+}
+
+// The read callback runs once per cache miss, also for values too long to cache.
+void check_read_cache() {
+    HostSim::reset();
+    ServiceManager manager;
+    static size_t calls = 0;
+    calls = 0;
+    ble_uuid128_t uuid = make_uuid(0, 0x0B);
+    auto service = manager.emplace_service("Bench", make_uuid(0xFFFFFF, 0xE8));
+    auto sampled = service->emplace_characteristic("Sampled", uuid, [](ValueWriter& out) {
+        ++calls;
+        uint64_t sample = 0x0102030405060708;
+        return out.append(&sample, sizeof(sample));
+    });
+    sampled->set_read_cache_ttl(60000);
+    check(manager.add_services_to_nimble("bench"), "add_services_to_nimble");
+    check(HostSim::start(), "HostSim::start");
+    uint16_t conn = HostSim::connect(247);
+    uint8_t out[16];
+    size_t out_len = 0;
+    size_t allocated = sampled->get_read_cache().get_capacity();
+    for (int i = 0; i < 2; ++i) {
+        check(HostSim::read(conn, sampled->get_handle(), out, sizeof(out), &out_len), "read");
+    }
+    if (allocated != 0 || calls != 1 || out_len != 8 || sampled->get_read_cache().get_capacity() != 8) {
+        fprintf(stderr, "read cache: %zu calls, %zu B cached (%zu B before the first read)\n",
+                calls, sampled->get_read_cache().get_capacity(), allocated);
+        exit(1);
+    }
+    sampled->set_max_length(4);
+    for (int i = 0; i < 2; ++i) {
+        check(HostSim::read(conn, sampled->get_handle(), out, sizeof(out), &out_len), "read");
+    }
+    if (calls != 3 || out_len != 8) {
+        fprintf(stderr, "read cache: %zu calls for two reads of an uncacheable value\n", calls - 1);
+        exit(1);
+    }
+    HostSim::disconnect(conn);
+}
+
+// Two managers side by side, reached by the registered name pointers and by copies of the names.
+void check_conn_mgr_names() {
+    HostSim::reset();
+    static uint32_t values[2] = {0x11223344, 0x55667788};
+    ServiceManager managers[2];
+    for (size_t i = 0; i < 2; ++i) {
+        auto service = managers[i].emplace_service("Bench", make_uuid(0xFFFFFF - i, 0xE7));
+        service->add_characteristic(
+            Characteristic::from_pointer_read_write(make_uuid(i, 0x0C), &values[i], i ? "Other" : "Value"));
+        if (i == 0) {
+            // Longer than its declared max length: refused, not rendered into a heap string.
+            service->emplace_characteristic("Oversize", make_uuid(2, 0x0C), []() { return std::string(16, 'x'); })
+                ->set_max_length(8);
+        }
+        check(managers[i].register_with_conn_mgr() == ESP_OK ? 0 : -1, "register_with_conn_mgr");
+    }
+    uint8_t oversize[32];
+    size_t oversize_len = 0;
+    uint8_t status = ESP_IOT_ATT_SUCCESS;
+    if (HostSim::conn_mgr_read(0, 1, oversize, sizeof(oversize), &oversize_len, &status) == ESP_OK ||
+        status != ESP_IOT_ATT_INSUF_RESOURCE || oversize_len != 0) {
+        fprintf(stderr, "conn-mgr: value over its max length was served (%zu bytes, status %u)\n", oversize_len, status);
+        exit(1);
+    }
+    for (bool copy : {false, true}) {
+        HostSim::conn_mgr_copy_names(copy);
+        for (size_t i = 0; i < 2; ++i) {
+            uint32_t read = 0;
+            size_t out_len = 0;
+            check(HostSim::conn_mgr_read(i, 0, reinterpret_cast<uint8_t*>(&read), sizeof(read), &out_len), "conn_mgr_read");
+            if (out_len != sizeof(read) || read != values[i]) {
+                fprintf(stderr, "conn-mgr: manager %zu read the wrong value (copied names %d)\n", i, copy);
+                exit(1);
+            }
+        }
+        uint32_t update = copy ? 0xCAFEF00D : 0x0BADF00D;
+        check(HostSim::conn_mgr_write(1, 0, &update, sizeof(update)), "conn_mgr_write");
+        if (values[1] != update || values[0] != 0x11223344) {
+            fprintf(stderr, "conn-mgr: write reached the wrong characteristic (copied names %d)\n", copy);
+            exit(1);
+        }
+    }
+    HostSim::conn_mgr_copy_names(false);
+}
+
+void bench_typed(size_t min_ops) {
+    static_assert(TypedCharacteristic<TypedSample>::wire_size == 15, "TypedSample encodes without padding");
+    HostSim::reset();
+    ServiceManager manager;
+    static TypedSample sample {0x11, 0x22334455, 1.0f, {1, -1, 0x0102}};
+    ble_uuid128_t uuid = make_uuid(0, 0x04);
+    manager.emplace_service("Bench", make_uuid(0xFFFFFF, 0xEE))->add_characteristic(
+        TypedCharacteristic<TypedSample>("Sample", uuid, &sample));
+    check(manager.add_services_to_nimble("bench"), "add_services_to_nimble");
+    check(HostSim::start(), "HostSim::start");
+    uint16_t handle = HostSim::find_value_handle(&uuid.u);
+    uint16_t conn = HostSim::connect(247);
+
+    static const uint8_t expected[15] = {0x11, 0x55, 0x44, 0x33, 0x22, 0x00, 0x00, 0x80, 0x3F,
+                                         0x01, 0x00, 0xFF, 0xFF, 0x02, 0x01};
+    uint8_t out[BLE_ATT_MTU_MAX];
+    size_t out_len = 0;
+    check(HostSim::read(conn, handle, out, sizeof(out), &out_len), "read");
+    if (out_len != sizeof(expected) || memcmp(out, expected, sizeof(expected)) != 0) {
+        fprintf(stderr, "typed characteristic encoded %zu bytes, not the expected wire format\n", out_len);
+        exit(1);
+    }
+    print_row("read/typed struct", 1, measure(1, min_ops, [&](size_t) {
+        check(HostSim::read(conn, handle, out, sizeof(out), &out_len), "read");
+    }));
+    print_row("write/typed struct", 1, measure(1, min_ops, [&](size_t) {
+        check(HostSim::write(conn, handle, expected, sizeof(expected)), "write");
+    }));
+    if (sample.timestamp != 0x22334455 || sample.axes[2] != 0x0102 || sample.value != 1.0f) {
+        fprintf(stderr, "typed characteristic decoded the wrong value\n");
+        exit(1);
+    }
+    HostSim::disconnect(conn);
+}
+
+// Parses [length u16][value] tuples (Read Multiple Variable or an aggregate) into values.
+bool parse_tuples(const uint8_t* data, size_t len, const std::vector<uint32_t>& expected) {
+    size_t offset = 0;
+    for (uint32_t value : expected) {
+        if (len - offset < AggregateCharacteristic::length_size + sizeof(value) ||
+            (data[offset] | (data[offset + 1] << 8)) != sizeof(value) ||
+            memcmp(data + offset + AggregateCharacteristic::length_size, &value, sizeof(value)) != 0) {
+            return false;
+        }
+        offset += AggregateCharacteristic::length_size + sizeof(value);
+    }
+    return offset == len;
+}
+
+void bench_dashboard(size_t min_ops) {
+    constexpr size_t kSensors = 25;
+    HostSim::reset();
+    ServiceManager manager;
+    std::vector<uint32_t> values(kSensors);
+    std::vector<std::string> names(kSensors);
+    auto service = manager.emplace_service("Dashboard", make_uuid(0xFFFFFF, 0xEB));
+    std::vector<std::shared_ptr<Characteristic>> sensors;
+    for (size_t i = 0; i < kSensors; ++i) {
+        values[i] = static_cast<uint32_t>(1000 + i * 17);
+        names[i] = "Sensor " + std::to_string(i);
+        auto sensor = std::make_shared<Characteristic>(Characteristic::from_pointer_read_only(
+            make_uuid(static_cast<uint32_t>(i), 0x08), &values[i], names[i].c_str()));
+        service->add_characteristic(sensor);
+        sensors.push_back(sensor);
+    }
+    ble_uuid128_t aggregate_uuid = make_uuid(kSensors, 0x08);
+    auto aggregate = AggregateCharacteristic::create("Dashboard", aggregate_uuid, {
+        sensors[0], sensors[1], sensors[2], sensors[3], sensors[4], sensors[5], sensors[6], sensors[7], sensors[8],
+        sensors[9], sensors[10], sensors[11], sensors[12], sensors[13], sensors[14], sensors[15], sensors[16],
+        sensors[17], sensors[18], sensors[19], sensors[20], sensors[21], sensors[22], sensors[23], sensors[24]});
+    service->add_characteristic(aggregate);
+    check(manager.add_services_to_nimble("bench"), "add_services_to_nimble");
+    check(HostSim::start(), "HostSim::start");
+    HostSim::set_gap_listener(&ServiceManager::gap_event_callback, &manager);
+    std::vector<uint16_t> handles(kSensors);
+    for (size_t i = 0; i < kSensors; ++i) {
+        handles[i] = sensors[i]->get_handle();
+    }
+    uint16_t aggregate_handle = aggregate->get_handle();
+    uint16_t conn = HostSim::connect(247);
+
+    uint8_t out[BLE_ATT_MTU_MAX];
+    size_t out_len = 0;
+    std::vector<uint32_t> seen(kSensors);
+    Result result = measure(1, min_ops / kSensors, [&](size_t) {
+        for (size_t i = 0; i < kSensors; ++i) {
+            check(HostSim::read(conn, handles[i], out, sizeof(out), &out_len), "read");
+            memcpy(&seen[i], out, sizeof(seen[i]));
+        }
+    });
+    if (seen != values) {
+        fprintf(stderr, "dashboard: single reads returned wrong values\n");
+        exit(1);
+    }
+    print_row("dashboard/25 reads (25 req)", kSensors, result);
+
+    result = measure(1, min_ops / kSensors, [&](size_t) {
+        check(HostSim::read_multiple(conn, handles.data(), kSensors, true, out, sizeof(out), &out_len), "read_multiple");
+    });
+    if (!parse_tuples(out, out_len, values)) {
+        fprintf(stderr, "dashboard: Read Multiple Variable returned a wrong payload (%zu bytes)\n", out_len);
+        exit(1);
+    }
+    print_row("dashboard/read mult var (1)", kSensors, result);
+
+    check(HostSim::read_multiple(conn, handles.data(), kSensors, false, out, sizeof(out), &out_len), "read_multiple");
+    if (out_len != kSensors * sizeof(uint32_t) || memcmp(out, values.data(), out_len) != 0) {
+        fprintf(stderr, "dashboard: Read Multiple returned a wrong payload (%zu bytes)\n", out_len);
+        exit(1);
+    }
+
+    result = measure(1, min_ops / kSensors, [&](size_t) {
+        check(HostSim::read(conn, aggregate_handle, out, sizeof(out), &out_len), "read aggregate");
+    });
+    if (aggregate->get_max_length() != kSensors * (AggregateCharacteristic::length_size + sizeof(uint32_t)) ||
+        !parse_tuples(out, out_len, values)) {
+        fprintf(stderr, "dashboard: aggregate returned a wrong payload (%zu bytes)\n", out_len);
+        exit(1);
+    }
+    print_row("dashboard/aggregate (1 req)", kSensors, result);
+    HostSim::disconnect(conn);
+}
+
+struct PublishedSample {
+    uint32_t sequence;
+    uint32_t derived[15];  // sequence * (i + 1): a torn copy mixes two sequences
+};
+
+PublishedSample make_published_sample(uint32_t sequence) {
+    PublishedSample sample;
+    sample.sequence = sequence;
+    for (uint32_t i = 0; i < 15; ++i) {
+        sample.derived[i] = sequence * (i + 1);
+    }
+    return sample;
+}
+
+bool is_consistent(const PublishedSample& sample) {
+    for (uint32_t i = 0; i < 15; ++i) {
+        if (sample.derived[i] != sample.sequence * (i + 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void on_published_notification(uint16_t, uint16_t, const uint8_t* data, size_t len, bool, void* arg) {
+    if (len == sizeof(PublishedSample)) {
+        memcpy(arg, data, len);
+    }
+}
+
+void bench_published(size_t min_ops) {
+    HostSim::reset();
+    ServiceManager manager;
+    static PublishedSample raw = make_published_sample(0);
+    static PublishedValue<PublishedSample> published(make_published_sample(0));
+    ble_uuid128_t raw_uuid = make_uuid(0, 0x07);
+    ble_uuid128_t published_uuid = make_uuid(1, 0x07);
+    auto service = manager.emplace_service("Bench", make_uuid(0xFFFFFF, 0xEC));
+    service->add_characteristic(Characteristic::from_pointer_read_only(raw_uuid, &raw, "Raw"));
+    auto characteristic = std::make_shared<Characteristic>(
+        Characteristic::from_pointer_read_only(published_uuid, &published, "Published"));
+    service->add_characteristic(characteristic);
+    check(manager.add_services_to_nimble("bench"), "add_services_to_nimble");
+    check(HostSim::start(), "HostSim::start");
+    HostSim::set_gap_listener(&ServiceManager::gap_event_callback, &manager);
+    uint16_t raw_handle = HostSim::find_value_handle(&raw_uuid.u);
+    uint16_t published_handle = HostSim::find_value_handle(&published_uuid.u);
+    uint16_t conn = HostSim::connect(247);
+
+    uint8_t out[BLE_ATT_MTU_MAX];
+    size_t out_len = 0;
+    print_row("read/pointer 64B", 1, measure(1, min_ops, [&](size_t) {
+        check(HostSim::read(conn, raw_handle, out, sizeof(out), &out_len), "read");
+    }));
+    print_row("read/published 64B", 1, measure(1, min_ops, [&](size_t) {
+        check(HostSim::read(conn, published_handle, out, sizeof(out), &out_len), "read");
+    }));
+    uint32_t next = 1;
+    print_row("publish 64B", 1, measure(1, min_ops, [&](size_t) {
+        published.publish(make_published_sample(next++));
+    }));
+
+    // GATT reads on this thread while a producer thread publishes as fast as it can.
+    std::atomic<bool> stop {false};
+    std::thread producer([&stop, next]() mutable {
+        while (!stop.load(std::memory_order_relaxed)) {
+            published.publish(make_published_sample(next++));
+        }
+    });
+    size_t torn = 0;
+    size_t changes = 0;
+    uint32_t last = 0;
+    for (size_t i = 0; i < min_ops; ++i) {
+        check(HostSim::read(conn, published_handle, out, sizeof(out), &out_len), "read");
+        PublishedSample sample;
+        memcpy(&sample, out, sizeof(sample));
+        torn += out_len == sizeof(sample) && is_consistent(sample) ? 0 : 1;
+        changes += sample.sequence != last ? 1 : 0;
+        last = sample.sequence;
+    }
+    stop.store(true);
+    producer.join();
+    if (torn != 0) {
+        fprintf(stderr, "published value: %zu of %zu concurrent reads were torn\n", torn, min_ops);
+        exit(1);
+    }
+
+    // Publishing with a notify target queues one notification per host task wakeup.
+    PublishedSample notified {};
+    HostSim::set_notification_listener(&on_published_notification, &notified);
+    check(HostSim::subscribe(conn, published_handle, true), "subscribe");
+    published.set_notify_target(characteristic.get());
+    published.publish(make_published_sample(0x12345));
+    HostSim::run_host_events();
+    published.set_notify_target(nullptr);
+    HostSim::set_notification_listener(nullptr, nullptr);
+    if (notified.sequence != 0x12345 || !is_consistent(notified)) {
+        fprintf(stderr, "published value: publish did not notify the subscriber\n");
+        exit(1);
+    }
+    printf("%-28s %6zu %12zu %12s\n", "published/racing reads", min_ops, changes, "changes");
+    HostSim::disconnect(conn);
+}
+
+struct DeferredSink {
+    uint32_t expected {0};
+    size_t out_of_order {0};
+};
+
+// Stands in for a flash write: 2 us of work per value.
+void slow_write(DeferredSink& sink, uint32_t value) {
+    auto until = Clock::now() + std::chrono::microseconds(2);
+    while (Clock::now() < until) {
+    }
+    sink.out_of_order += value == sink.expected ? 0 : 1;
+    sink.expected = value + 1;
+}
+
+void bench_deferred(size_t min_ops) {
+    constexpr size_t kBatch = 32;
+    HostSim::reset();
+    ServiceManager manager;
+    DeferredSink sink;
+    auto write_cb = [&sink](ValueReader& in) {
+        uint32_t value = 0;
+        int rc = in.copy_to(&value, sizeof(value));
+        if (rc == 0) {
+            slow_write(sink, value);
+        }
+        return rc;
+    };
+    ble_uuid128_t direct_uuid = make_uuid(0, 0x08);
+    ble_uuid128_t deferred_uuid = make_uuid(1, 0x08);
+    auto service = manager.emplace_service("Bench", make_uuid(0xFFFFFF, 0xEB));
+    service->emplace_characteristic("Direct", direct_uuid, nullptr, write_cb);
+    auto deferred = std::make_shared<Characteristic>("Deferred", deferred_uuid, nullptr, write_cb);
+    DeferredWriteQueue queue(kBatch * 32);
+    deferred->set_write_queue(&queue);
+    service->add_characteristic(deferred);
+    check(manager.add_services_to_nimble("bench"), "add_services_to_nimble");
+    check(HostSim::start(), "HostSim::start");
+    uint16_t direct_handle = HostSim::find_value_handle(&direct_uuid.u);
+    uint16_t deferred_handle = HostSim::find_value_handle(&deferred_uuid.u);
+    uint16_t conn = HostSim::connect(247);
+
+    // Host task time per write: batches of writes, the queue drained between batches (untimed).
+    auto host_time = [&](uint16_t handle, uint32_t& next) {
+        size_t rounds = std::max<size_t>(1, min_ops / 10 / kBatch);
+        size_t allocs_before = g_allocations;
+        double elapsed = 0;
+        for (size_t r = 0; r < rounds; ++r) {
+            auto start = Clock::now();
+            for (size_t i = 0; i < kBatch; ++i) {
+                check(HostSim::write(conn, handle, &next, sizeof(next)), "write");
+                ++next;
+            }
+            elapsed += std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            queue.drain();
+        }
+        double ops = static_cast<double>(rounds * kBatch);
+        return Result {elapsed / ops, static_cast<double>(g_allocations - allocs_before) / ops};
+    };
+    uint32_t next = 0;
+    print_row("write/slow direct", 1, host_time(direct_handle, next));
+    print_row("write/slow deferred", 1, host_time(deferred_handle, next));
+
+    // Full queue: Reject fails the write, after a drain it succeeds again.
+    uint32_t value = next;
+    int rc = 0;
+    size_t accepted = 0;
+    {
+        ExpectedLogs quiet("CustomBLE/DeferredWriteQueue");
+        while ((rc = HostSim::write(conn, deferred_handle, &value, sizeof(value))) == 0) {
+            ++value;
+            ++accepted;
+        }
+    }
+    if (rc != BLE_ATT_ERR_INSUFFICIENT_RES || queue.rejected_count() != 1 || accepted == 0) {
+        fprintf(stderr, "deferred writes: full queue returned %d after %zu writes\n", rc, accepted);
+        exit(1);
+    }
+    queue.drain();
+
+    // A producer (this thread, as the host task) racing a consumer thread; rejected writes are retried.
+    std::atomic<bool> stop {false};
+    std::thread consumer([&queue, &stop]() {
+        while (!stop.load(std::memory_order_acquire) || !queue.empty()) {
+            if (queue.drain() == 0) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    size_t retries = 0;
+    for (size_t i = 0; i < min_ops / 20; ++i) {
+        while (HostSim::write(conn, deferred_handle, &value, sizeof(value)) != 0) {
+            ++retries;
+            std::this_thread::yield();
+        }
+        ++value;
+    }
+    stop.store(true, std::memory_order_release);
+    consumer.join();
+    if (sink.out_of_order != 0 || sink.expected != value || queue.dispatched_count() != queue.queued_count()) {
+        fprintf(stderr, "deferred writes: %zu out of order, last %u of %u\n", sink.out_of_order, sink.expected, value);
+        exit(1);
+    }
+
+    // Wrap-around: with room for four records, three queued and two drained, the next two wrap to the start.
+    DeferredWriteQueue probe(256);
+    deferred->set_write_queue(&probe);
+    check(HostSim::write(conn, deferred_handle, &value, sizeof(value)), "write");
+    ++value;
+    size_t record = probe.pending_bytes();
+    probe.drain();
+    DeferredWriteQueue ring(4 * record);
+    deferred->set_write_queue(&ring);
+    auto push = [&](size_t writes) {
+        for (size_t i = 0; i < writes; ++i) {
+            check(HostSim::write(conn, deferred_handle, &value, sizeof(value)), "write");
+            ++value;
+        }
+    };
+    push(3);
+    ring.drain(2);
+    push(1);
+    size_t wrapped = ring.pending_bytes();
+    push(1);
+    if (wrapped != 2 * record || ring.pending_bytes() != 3 * record || ring.high_water() != 3 * record) {
+        fprintf(stderr, "deferred writes: wrapped ring has %zu then %zu bytes pending (high water %zu), record %zu\n",
+                wrapped, ring.pending_bytes(), ring.high_water(), record);
+        exit(1);
+    }
+    ring.drain();
+    if (ring.pending_bytes() != 0 || sink.expected != value) {
+        fprintf(stderr, "deferred writes: %zu bytes left after draining the wrapped ring\n", ring.pending_bytes());
+        exit(1);
+    }
+
+    // Drop policy: overflowing writes are acknowledged and counted.
+    DeferredWriteQueue dropping(64, DeferredWriteQueue::OverflowPolicy::Drop);
+    deferred->set_write_queue(&dropping);
+    for (int i = 0; i < 16; ++i) {
+        check(HostSim::write(conn, deferred_handle, &value, sizeof(value)), "write");
+    }
+    deferred->set_write_queue(nullptr);
+    if (dropping.dropped_count() == 0 || dropping.queued_count() + dropping.dropped_count() != 16) {
+        fprintf(stderr, "deferred writes: drop policy queued %zu, dropped %zu\n", dropping.queued_count(), dropping.dropped_count());
+        exit(1);
+    }
+    printf("%-28s %6zu %12zu %12s\n", "deferred/racing writes", min_ops / 20, retries, "retries");
+    HostSim::disconnect(conn);
+}
+
+void ingest_packet(uint16_t conn, uint16_t handle, uint16_t sequence, const uint8_t* payload, size_t len) {
+    uint8_t packet[BLE_ATT_MTU_MAX];
+    packet[0] = static_cast<uint8_t>(sequence);
+    packet[1] = static_cast<uint8_t>(sequence >> 8);
+    memcpy(packet + IngestCharacteristic::header_size, payload, len);
+    HostSim::write_no_response(conn, handle, packet, IngestCharacteristic::header_size + len);
+}
+
+void bench_ingest() {
+    constexpr size_t kUploadSize = 256 * 1024;
+    constexpr uint16_t kPayload = 247 - 5;
+    constexpr size_t kBatch = 16;
+    static std::vector<uint8_t> source(kUploadSize);
+    for (size_t i = 0; i < kUploadSize; ++i) {
+        source[i] = static_cast<uint8_t>(i * 17 + 3);
+    }
+    HostSim::reset();
+    ServiceManager manager;
+    ble_uuid128_t uuid = make_uuid(0, 0x09);
+    auto ingest = IngestCharacteristic::create("Upload", uuid, 64, kPayload);
+    manager.emplace_service("Bench", make_uuid(0xFFFFFF, 0xEA))->add_characteristic(ingest);
+    check(manager.add_services_to_nimble("bench"), "add_services_to_nimble");
+    check(HostSim::start(), "HostSim::start");
+    uint16_t handle = HostSim::find_value_handle(&uuid.u);
+    uint16_t conn = HostSim::connect(247);
+
+    std::vector<uint8_t> uploaded;
+    uploaded.reserve(kUploadSize);
+    uint16_t next_sequence = 0;
+    bool order_error = false;
+    auto consume = [&](uint16_t sequence, const uint8_t* data, size_t len) {
+        order_error |= sequence != next_sequence++;
+        uploaded.insert(uploaded.end(), data, data + len);
+    };
+
+    // Upload: the consumer drains a batch every kBatch packets.
+    size_t allocs_before = g_allocations;
+    auto start = Clock::now();
+    uint16_t sequence = 0;
+    for (size_t offset = 0; offset < kUploadSize; offset += kPayload) {
+        ingest_packet(conn, handle, sequence++, source.data() + offset, std::min<size_t>(kPayload, kUploadSize - offset));
+        if (ingest->pending() >= kBatch) {
+            ingest->drain(consume);
+        }
+    }
+    ingest->drain(consume);
+    auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    size_t allocs = g_allocations - allocs_before;
+    IngestCharacteristic::Counters counters = ingest->get_counters();
+    if (order_error || uploaded != source || counters.gaps != 0 || counters.overflows != 0) {
+        fprintf(stderr, "ingest: %zu of %zu bytes, %u gaps, %u overflows\n", uploaded.size(), kUploadSize,
+                counters.gaps, counters.overflows);
+        exit(1);
+    }
+    double kib = static_cast<double>(kUploadSize) / 1024.0;
+    print_row("ingest/256KiB mtu247 per KiB", 1, Result {elapsed / kib, static_cast<double>(allocs) / kib});
+
+    // Counters: a skipped sequence number, a stale packet and a full ring.
+    ingest->reset();
+    uint8_t payload[kPayload] = {};
+    ingest_packet(conn, handle, 100, payload, sizeof(payload));
+    ingest_packet(conn, handle, 102, payload, sizeof(payload));
+    ingest_packet(conn, handle, 101, payload, sizeof(payload));
+    for (uint16_t s = 103; s < 103 + 70; ++s) {
+        ingest_packet(conn, handle, s, payload, sizeof(payload));
+    }
+    counters = ingest->get_counters();
+    size_t drained = ingest->drain([](uint16_t, const uint8_t*, size_t) {});
+    uint8_t status[32];
+    size_t status_len = 0;
+    check(HostSim::read(conn, handle, status, sizeof(status), &status_len), "read status");
+    uint16_t expected = static_cast<uint16_t>(status[0] | (status[1] << 8));
+    // The rejected packets did not advance the expected sequence: the central resumes at 165.
+    if (counters.gaps != 1 || counters.stale != 1 || counters.received != 64 || counters.overflows != 8 ||
+        drained != 64 || status_len != 18 || expected != 165 || status[10] != 8) {
+        fprintf(stderr, "ingest: counters gaps %u stale %u received %u overflows %u, drained %zu, expected %u\n",
+                counters.gaps, counters.stale, counters.received, counters.overflows, drained, expected);
+        exit(1);
+    }
+    // Retrying the first rejected packet delivers it.
+    payload[0] = 0xA5;
+    ingest_packet(conn, handle, 165, payload, sizeof(payload));
+    uint16_t retried = 0;
+    uint8_t retried_first = 0;
+    drained = ingest->drain([&](uint16_t s, const uint8_t* data, size_t) { retried = s; retried_first = data[0]; });
+    counters = ingest->get_counters();
+    if (drained != 1 || retried != 165 || retried_first != 0xA5 || counters.stale != 1 || counters.gaps != 1) {
+        fprintf(stderr, "ingest: retry after overflow not delivered (drained %zu, sequence %u, stale %u)\n",
+                drained, retried, counters.stale);
+        exit(1);
+    }
+    HostSim::disconnect(conn);
+}
+
+struct StreamReceiver {
+    std::vector<uint8_t> data;
+    uint16_t next_sequence {0};
+    size_t unacknowledged_packets {0};
+    bool finished {false};
+    bool sequence_error {false};
+};
+
+void on_stream_packet(uint16_t, uint16_t, const uint8_t* data, size_t len, bool, void* arg) {
+    auto* receiver = static_cast<StreamReceiver*>(arg);
+    uint16_t sequence = static_cast<uint16_t>(data[0] | (data[1] << 8));
+    if (len < StreamCharacteristic::header_size || sequence != receiver->next_sequence) {
+        receiver->sequence_error = true;
+        return;
+    }
+    ++receiver->next_sequence;
+    ++receiver->unacknowledged_packets;
+    if (len == StreamCharacteristic::header_size) {
+        receiver->finished = true;
+    }
+    receiver->data.insert(receiver->data.end(), data + StreamCharacteristic::header_size, data + len);
+}
+
+void stream_command(uint16_t conn, uint16_t handle, uint8_t command, uint32_t offset, uint16_t credits) {
+    uint8_t payload[7] = {command,
+                          static_cast<uint8_t>(offset), static_cast<uint8_t>(offset >> 8),
+                          static_cast<uint8_t>(offset >> 16), static_cast<uint8_t>(offset >> 24),
+                          static_cast<uint8_t>(credits), static_cast<uint8_t>(credits >> 8)};
+    check(HostSim::write(conn, handle, payload, sizeof(payload)), "stream command");
+}
+
+void bench_stream() {
+    constexpr size_t kStreamSize = 256 * 1024;
+    constexpr uint16_t kWindow = 16;
+    static std::vector<uint8_t> source(kStreamSize);
+    for (size_t i = 0; i < kStreamSize; ++i) {
+        source[i] = static_cast<uint8_t>(i * 31 + 7);
+    }
+    HostSim::reset();
+    ServiceManager manager;
+    ble_uuid128_t uuid = make_uuid(0, 0x05);
+    auto stream = StreamCharacteristic::create("Log stream", uuid, [](uint32_t offset, uint8_t* buffer, size_t capacity) {
+        if (offset >= kStreamSize) {
+            return StreamCharacteristic::end_of_stream;
+        }
+        size_t length = std::min(capacity, kStreamSize - offset);
+        memcpy(buffer, source.data() + offset, length);
+        return static_cast<int>(length);
+    });
+    manager.emplace_service("Bench", make_uuid(0xFFFFFF, 0xEE))->add_characteristic(stream);
+    check(manager.add_services_to_nimble("bench"), "add_services_to_nimble");
+    check(HostSim::start(), "HostSim::start");
+    HostSim::set_gap_listener(&ServiceManager::gap_event_callback, &manager);
+    uint16_t handle = HostSim::find_value_handle(&uuid.u);
+
+    StreamReceiver receiver;
+    receiver.data.reserve(kStreamSize);
+    HostSim::set_notification_listener(&on_stream_packet, &receiver);
+    uint16_t conn = HostSim::connect(247);
+    check(HostSim::subscribe(conn, handle, true), "subscribe");
+
+    size_t allocs_before = g_allocations;
+    auto start = Clock::now();
+    stream_command(conn, handle, StreamCharacteristic::CommandStart, 0, kWindow);
+    bool resumed = false;
+    while (!receiver.finished && !receiver.sequence_error) {
+        if (HostSim::run_host_events() == 0 && receiver.unacknowledged_packets == 0) {
+            fprintf(stderr, "stream stalled at %zu bytes\n", receiver.data.size());
+            exit(1);
+        }
+        if (!resumed && receiver.data.size() >= kStreamSize / 3) {
+            // Drop the link mid-transfer, reconnect and resume from what was acknowledged.
+            uint32_t acknowledged = stream->get_acknowledged();
+            HostSim::disconnect(conn);
+            HostSim::run_host_events();
+            conn = HostSim::connect(247);
+            check(HostSim::subscribe(conn, handle, true), "subscribe");
+            receiver.data.resize(acknowledged);
+            receiver.next_sequence = 0;
+            receiver.unacknowledged_packets = 0;
+            stream_command(conn, handle, StreamCharacteristic::CommandStart, acknowledged, kWindow);
+            resumed = true;
+            continue;
+        }
+        if (receiver.unacknowledged_packets >= kWindow / 2) {
+            stream_command(conn, handle, StreamCharacteristic::CommandAck,
+                           static_cast<uint32_t>(receiver.data.size()), static_cast<uint16_t>(receiver.unacknowledged_packets));
+            receiver.unacknowledged_packets = 0;
+        }
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    size_t allocs = g_allocations - allocs_before;
+    HostSim::set_notification_listener(nullptr, nullptr);
+    if (receiver.sequence_error || receiver.data != source) {
+        fprintf(stderr, "stream delivered %zu bytes with %s\n", receiver.data.size(),
+                receiver.sequence_error ? "a sequence gap" : "wrong content");
+        exit(1);
+    }
+    double kib = static_cast<double>(kStreamSize) / 1024.0;
+    print_row("stream/256KiB mtu247 per KiB", 1, Result {elapsed / kib, static_cast<double>(allocs) / kib});
+
+    // Out of buffers: the stream backs off on a timer instead of re-posting itself.
+    HostSim::fail_notifications(1);
+    stream_command(conn, handle, StreamCharacteristic::CommandStart, 0, 4);
+    HostSim::run_host_events();
+    size_t sent_before = HostSim::notifications_sent();
+    size_t spins = HostSim::run_host_events();
+    if (spins != 0 || HostSim::active_callouts() != 1 || stream->get_offset() != 0) {
+        fprintf(stderr, "stream: %zu events after ENOMEM, %zu callouts\n", spins, HostSim::active_callouts());
+        exit(1);
+    }
+    HostSim::advance_time(StreamCharacteristic::retry_delay_ms * 1000);
+    HostSim::run_host_events();
+    if (HostSim::notifications_sent() - sent_before != 4 || stream->get_credits() != 0) {
+        fprintf(stderr, "stream: %zu packets after the retry delay\n", HostSim::notifications_sent() - sent_before);
+        exit(1);
+    }
+
+    // Notifications must be enabled: START is refused without, unsubscribing stops the stream.
+    check(HostSim::subscribe(conn, handle, false), "unsubscribe");
+    stream_command(conn, handle, StreamCharacteristic::CommandAck, stream->get_offset(), 4);
+    HostSim::run_host_events();
+    uint8_t restart[7] = {StreamCharacteristic::CommandStart, 0, 0, 0, 0, 4, 0};
+    int rc = HostSim::write(conn, handle, restart, sizeof(restart));
+    if (stream->get_state() != StreamCharacteristic::State::Idle || rc != StreamCharacteristic::cccd_improperly_configured ||
+        HostSim::notifications_sent() - sent_before != 4) {
+        fprintf(stderr, "stream: START without a subscription returned %d\n", rc);
+        exit(1);
+    }
+    HostSim::disconnect(conn);
+}
+
+// Representative payloads for the compression cases, generated deterministically.
+struct Lcg {
+    uint32_t state;
+    uint32_t next(uint32_t range) {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) % range;
+    }
+};
+
+std::vector<uint8_t> make_json_config(size_t size) {
+    static const char* const kKinds[] = {"temperature", "humidity", "pressure", "voltage", "current"};
+    static const char* const kUnits[] = {"C", "%", "hPa", "V", "A"};
+    Lcg lcg {1};
+    std::string text = "{\"device\":{\"name\":\"gateway-04\",\"firmware\":\"2.4.1\"},\"sensors\":[";
+    for (size_t i = 0; text.size() < size; ++i) {
+        size_t kind = lcg.next(5);
+        char entry[256];
+        snprintf(entry, sizeof(entry),
+                 "{\"id\":%zu,\"type\":\"%s\",\"unit\":\"%s\",\"enabled\":%s,\"interval_ms\":%u,"
+                 "\"threshold\":{\"low\":%u.%u,\"high\":%u.%u},\"tags\":[\"floor-%u\",\"zone-%c\"]},",
+                 i, kKinds[kind], kUnits[kind], lcg.next(4) ? "true" : "false", 250u * (1 + lcg.next(8)),
+                 lcg.next(40), lcg.next(10), 40 + lcg.next(60), lcg.next(10), lcg.next(6), 'A' + static_cast<char>(lcg.next(4)));
+        text += entry;
+    }
+    text.resize(size);
+    return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+std::vector<uint8_t> make_log_text(size_t size) {
+    static const char* const kTags[] = {"wifi", "mqtt", "sensor", "ota", "ble"};
+    static const char* const kMessages[] = {
+        "connected to AP 'office-3' rssi=%d ch=%u",
+        "publish topic=site/%u/telemetry qos=1 bytes=%u",
+        "sample ready value=%d.%u after %u ms",
+        "chunk %u of %u written",
+        "conn %u mtu updated to %u",
+    };
+    static const char kLevels[] = {'I', 'I', 'I', 'W', 'D'};
+    Lcg lcg {2};
+    std::string text;
+    uint32_t ms = 1000;
+    while (text.size() < size) {
+        size_t tag = lcg.next(5);
+        ms += lcg.next(400);
+        char line[160];
+        int n = snprintf(line, sizeof(line), "%c (%u) %s: ", kLevels[lcg.next(5)], ms, kTags[tag]);
+        snprintf(line + n, sizeof(line) - n, kMessages[tag], -40 - static_cast<int>(lcg.next(50)), lcg.next(300), lcg.next(2000));
+        text += line;
+        text += '\n';
+    }
+    text.resize(size);
+    return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+std::vector<uint8_t> make_random_bytes(size_t size) {
+    Lcg lcg {3};
+    std::vector<uint8_t> bytes(size);
+    for (auto& byte : bytes) {
+        byte = static_cast<uint8_t>(lcg.next(256));
+    }
+    return bytes;
+}
+
+void print_compression_row(const char* name, size_t raw, size_t packed, double compress_ns, double decompress_ns) {
+    double mb = static_cast<double>(raw) / 1e6;
+    printf("%-28s %6.2fx %9.1f MB/s %9.1f MB/s\n", name, static_cast<double>(raw) / static_cast<double>(packed),
+           mb / (compress_ns / 1e9), mb / (decompress_ns / 1e9));
+}
+
+// Values of 480 bytes as independent blocks (compressed characteristics), and the
+// same data as a stream of 244-byte linked blocks (one notification payload each).
+void bench_codec(const char* name, const std::vector<uint8_t>& data) {
+    constexpr size_t kValue = 480;
+    constexpr size_t kChunk = 244;
+    static uint8_t packed[256 * 1024];
+    static uint8_t decoded[256 * 1024];
+    static uint16_t block_sizes[4096];
+    static LzStreamEncoder encoder;
+    static LzStreamDecoder decoder;
+    size_t allocs_before = g_allocations;
+    size_t rounds = 4;
+
+    size_t packed_size = 0;
+    auto start = Clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        packed_size = 0;
+        size_t block = 0;
+        for (size_t offset = 0; offset < data.size(); offset += kValue, ++block) {
+            ValueWriter out(packed + packed_size, sizeof(packed) - packed_size);
+            check(LzCodec::compress(data.data() + offset, std::min(kValue, data.size() - offset), out), "LzCodec::compress");
+            block_sizes[block] = static_cast<uint16_t>(out.size());
+            packed_size += out.size();
+        }
+    }
+    double compress_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / rounds;
+    start = Clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        size_t in = 0;
+        size_t out = 0;
+        for (size_t block = 0; out < data.size(); ++block) {
+            int n = LzCodec::decompress(packed + in, block_sizes[block], decoded + out, kValue);
+            check(n < 0 ? -1 : 0, "LzCodec::decompress");
+            in += block_sizes[block];
+            out += static_cast<size_t>(n);
+        }
+    }
+    double decompress_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / rounds;
+    if (memcmp(decoded, data.data(), data.size()) != 0) {
+        fprintf(stderr, "lz: %s values did not round-trip\n", name);
+        exit(1);
+    }
+    char row[64];
+    snprintf(row, sizeof(row), "lz/%s value480", name);
+    print_compression_row(row, data.size(), packed_size, compress_ns, decompress_ns);
+
+    start = Clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        encoder.reset();
+        packed_size = 0;
+        size_t block = 0;
+        for (size_t offset = 0; offset < data.size(); offset += kChunk, ++block) {
+            int n = encoder.compress(data.data() + offset, std::min(kChunk, data.size() - offset),
+                                     packed + packed_size, sizeof(packed) - packed_size);
+            check(n < 0 ? -1 : 0, "LzStreamEncoder::compress");
+            encoder.commit();
+            block_sizes[block] = static_cast<uint16_t>(n);
+            packed_size += static_cast<size_t>(n);
+        }
+    }
+    compress_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / rounds;
+    start = Clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        decoder.reset();
+        size_t in = 0;
+        size_t out = 0;
+        for (size_t block = 0; out < data.size(); ++block) {
+            const uint8_t* chunk = nullptr;
+            int n = decoder.decompress(packed + in, block_sizes[block], &chunk);
+            check(n < 0 ? -1 : 0, "LzStreamDecoder::decompress");
+            memcpy(decoded + out, chunk, static_cast<size_t>(n));
+            in += block_sizes[block];
+            out += static_cast<size_t>(n);
+        }
+    }
+    decompress_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / rounds;
+    if (memcmp(decoded, data.data(), data.size()) != 0) {
+        fprintf(stderr, "lz: %s stream did not round-trip\n", name);
+        exit(1);
+    }
+    snprintf(row, sizeof(row), "lz/%s stream244", name);
+    print_compression_row(row, data.size(), packed_size, compress_ns, decompress_ns);
+    if (g_allocations != allocs_before) {
+        fprintf(stderr, "lz: codec allocated %zu times\n", g_allocations - allocs_before);
+        exit(1);
+    }
+}
+
+// Reads the whole value of a characteristic with Read and Read Blob requests.
+size_t read_long(uint16_t conn, uint16_t handle, uint16_t mtu, uint8_t* out, size_t capacity) {
+    size_t total = 0;
+    for (;;) {
+        size_t len = 0;
+        check(HostSim::read(conn, handle, out + total, capacity - total, &len, static_cast<uint16_t>(total)), "read");
+        total += len;
+        if (len < static_cast<size_t>(mtu - 1)) {
+            return total;
+        }
+    }
+}
+
+struct CompressedReceiver {
+    LzStreamDecoder decoder;
+    std::vector<uint8_t> data;
+    size_t notifications {0};
+    size_t packets {0};
+    size_t unacknowledged_packets {0};
+    uint16_t next_sequence {0};
+    bool finished {false};
+    bool error {false};
+};
+
+void on_compressed_notification(uint16_t, uint16_t, const uint8_t* data, size_t len, bool, void* arg) {
+    auto* receiver = static_cast<CompressedReceiver*>(arg);
+    const uint8_t* chunk = nullptr;
+    int n = receiver->decoder.decompress(data, len, &chunk);
+    if (n < 0) {
+        receiver->error = true;
+        return;
+    }
+    receiver->data.assign(chunk, chunk + n);
+    ++receiver->notifications;
+}
+
+void on_compressed_stream_packet(uint16_t, uint16_t, const uint8_t* data, size_t len, bool, void* arg) {
+    auto* receiver = static_cast<CompressedReceiver*>(arg);
+    uint16_t sequence = static_cast<uint16_t>(data[0] | (data[1] << 8));
+    if (len < StreamCharacteristic::header_size || sequence != receiver->next_sequence) {
+        receiver->error = true;
+        return;
+    }
+    ++receiver->next_sequence;
+    ++receiver->unacknowledged_packets;
+    ++receiver->packets;
+    if (len == StreamCharacteristic::header_size) {
+        receiver->finished = true;
+        return;
+    }
+    const uint8_t* chunk = nullptr;
+    int n = receiver->decoder.decompress(data + StreamCharacteristic::header_size, len - StreamCharacteristic::header_size, &chunk);
+    if (n < 0) {
+        receiver->error = true;
+        return;
+    }
+    receiver->data.insert(receiver->data.end(), chunk, chunk + n);
+}
+
+void bench_compression() {
+    constexpr size_t kSampleSize = 64 * 1024;
+    const std::vector<uint8_t> json = make_json_config(kSampleSize);
+    const std::vector<uint8_t> log = make_log_text(kSampleSize);
+    const std::vector<uint8_t> random = make_random_bytes(kSampleSize);
+    printf("%-28s %7s %14s %14s\n", "codec", "ratio", "compress", "decompress");
+    bench_codec("json", json);
+    bench_codec("log", log);
+    bench_codec("random", random);
+
+    // A compressed configuration characteristic: reads, writes, notifications and the descriptor.
+    HostSim::reset();
+    ServiceManager manager;
+    std::string config(json.begin(), json.begin() + 480);
+    std::string written;
+    ble_uuid128_t uuid = make_uuid(0, 0x07);
+    auto service = manager.emplace_service("Bench", make_uuid(0xFFFFFF, 0xEC));
+    auto characteristic = service->emplace_characteristic("Config", uuid,
+        [&config](ValueWriter& out) { return out.append(config); },
+        [&written](ValueReader& in) { written = in.to_string(); return 0; });
+    characteristic->set_max_length(480);
+    characteristic->set_compression(Characteristic::CompressReads | Characteristic::CompressWrites);
+    // A compressed aggregate of it: the member compresses while the aggregate holds the shared scratch.
+    ble_uuid128_t aggregate_uuid = make_uuid(2, 0x07);
+    auto aggregate = AggregateCharacteristic::create("Config summary", aggregate_uuid, {characteristic});
+    aggregate->set_compression(Characteristic::CompressReads);
+    service->add_characteristic(aggregate);
+    check(manager.add_services_to_nimble("bench"), "add_services_to_nimble");
+    check(HostSim::start(), "HostSim::start");
+    check(manager.register_with_conn_mgr() == ESP_OK ? 0 : -1, "register_with_conn_mgr");
+    HostSim::set_gap_listener(&ServiceManager::gap_event_callback, &manager);
+    uint16_t handle = HostSim::find_value_handle(&uuid.u);
+    uint16_t conn = HostSim::connect(BLE_ATT_MTU_DFLT);
+
+    uint8_t descriptor[16] = {};
+    size_t descriptor_len = 0;
+    check(HostSim::read(conn, HostSim::find_descriptor_handle(handle, &LzCodec::descriptor_uuid.u), descriptor,
+                        sizeof(descriptor), &descriptor_len), "read compression descriptor");
+    if (descriptor_len != LzCodec::descriptor_size || descriptor[0] != LzCodec::format_lz4_block ||
+        descriptor[1] != (Characteristic::CompressReads | Characteristic::CompressWrites) ||
+        (descriptor[2] | (descriptor[3] << 8)) != 480) {
+        fprintf(stderr, "lz: wrong compression descriptor (%zu bytes)\n", descriptor_len);
+        exit(1);
+    }
+
+    uint8_t packed[BLE_ATT_ATTR_MAX_LEN];
+    uint8_t plain[BLE_ATT_ATTR_MAX_LEN];
+    size_t packed_len = 0;
+    Result result = measure(1, 2000, [&](size_t) {
+        packed_len = read_long(conn, handle, BLE_ATT_MTU_DFLT, packed, sizeof(packed));
+    });
+    int plain_len = LzCodec::decompress(packed, packed_len, plain, sizeof(plain));
+    if (plain_len != static_cast<int>(config.size()) || memcmp(plain, config.data(), config.size()) != 0) {
+        fprintf(stderr, "lz: compressed read did not round-trip (%d bytes)\n", plain_len);
+        exit(1);
+    }
+    char row[64];
+    snprintf(row, sizeof(row), "lz/read json 480B->%zuB", packed_len);
+    print_row(row, 1, result);
+
+    HostSim::disconnect(conn);
+    conn = HostSim::connect(247);
+    ValueWriter request(packed, sizeof(packed));
+    const std::string update(log.begin(), log.begin() + 200);
+    check(LzCodec::compress(reinterpret_cast<const uint8_t*>(update.data()), update.size(), request), "LzCodec::compress");
+    check(HostSim::write(conn, handle, packed, request.size()), "compressed write");
+    const uint8_t garbage[] = {0xF0, 0x01};
+    if (written != update || HostSim::write(conn, handle, garbage, sizeof(garbage)) != BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN) {
+        fprintf(stderr, "lz: compressed write was not decoded or a malformed one was accepted\n");
+        exit(1);
+    }
+
+    CompressedReceiver notified;
+    HostSim::set_notification_listener(&on_compressed_notification, &notified);
+    check(HostSim::subscribe(conn, handle, true), "subscribe");
+    // Notifications carry at most ATT_MTU - 3 bytes: notify a shorter configuration.
+    config.resize(240);
+    check(characteristic->notify(), "notify");
+    bool notified_config = std::string(notified.data.begin(), notified.data.end()) == config;
+    check(characteristic->notify(update), "notify(value)");
+    if (notified.error || notified.notifications != 2 || !notified_config ||
+        std::string(notified.data.begin(), notified.data.end()) != update) {
+        fprintf(stderr, "lz: compressed notifications did not decode\n");
+        exit(1);
+    }
+    HostSim::set_notification_listener(nullptr, nullptr);
+
+    packed_len = read_long(conn, HostSim::find_value_handle(&aggregate_uuid.u), 247, packed, sizeof(packed));
+    plain_len = LzCodec::decompress(packed, packed_len, plain, sizeof(plain));
+    uint8_t member[BLE_ATT_ATTR_MAX_LEN];
+    int member_len = -1;
+    size_t length_size = AggregateCharacteristic::length_size;
+    if (plain_len >= static_cast<int>(length_size) &&
+        static_cast<size_t>(plain_len) == length_size + (plain[0] | (plain[1] << 8))) {
+        member_len = LzCodec::decompress(plain + length_size, plain_len - length_size, member, sizeof(member));
+    }
+    if (member_len != static_cast<int>(config.size()) || memcmp(member, config.data(), config.size()) != 0) {
+        fprintf(stderr, "lz: compressed aggregate of a compressed member did not decode (%d bytes)\n", member_len);
+        exit(1);
+    }
+    HostSim::disconnect(conn);
+
+    // A compressed log stream: 256 KiB with credits, acks and a resume midway.
+    constexpr size_t kStreamSize = 256 * 1024;
+    constexpr uint16_t kWindow = 16;
+    static std::vector<uint8_t> source;
+    source = make_log_text(kStreamSize);
+    HostSim::reset();
+    ServiceManager stream_manager;
+    static LzStreamEncoder encoder;
+    ble_uuid128_t stream_uuid = make_uuid(1, 0x07);
+    auto stream = StreamCharacteristic::create("Log stream", stream_uuid, [](uint32_t offset, uint8_t* buffer, size_t capacity) {
+        if (offset >= kStreamSize) {
+            return StreamCharacteristic::end_of_stream;
+        }
+        size_t length = std::min(capacity, kStreamSize - offset);
+        memcpy(buffer, source.data() + offset, length);
+        return static_cast<int>(length);
+    });
+    stream->set_encoder(&encoder);
+    stream_manager.emplace_service("Bench", make_uuid(0xFFFFFF, 0xEC))->add_characteristic(stream);
+    check(stream_manager.add_services_to_nimble("bench"), "add_services_to_nimble");
+    check(HostSim::start(), "HostSim::start");
+    HostSim::set_gap_listener(&ServiceManager::gap_event_callback, &stream_manager);
+    uint16_t stream_handle = HostSim::find_value_handle(&stream_uuid.u);
+    if (HostSim::find_descriptor_handle(stream_handle, &LzCodec::descriptor_uuid.u) == 0) {
+        fprintf(stderr, "lz: compressed stream has no compression descriptor\n");
+        exit(1);
+    }
+
+    static CompressedReceiver receiver;
+    receiver.data.reserve(kStreamSize);
+    HostSim::set_notification_listener(&on_compressed_stream_packet, &receiver);
+    conn = HostSim::connect(247);
+    check(HostSim::subscribe(conn, stream_handle, true), "subscribe");
+    size_t allocs_before = g_allocations;
+    auto start = Clock::now();
+    stream_command(conn, stream_handle, StreamCharacteristic::CommandStart, 0, kWindow);
+    bool resumed = false;
+    while (!receiver.finished && !receiver.error) {
+        if (HostSim::run_host_events() == 0 && receiver.unacknowledged_packets == 0) {
+            fprintf(stderr, "lz: compressed stream stalled at %zu bytes\n", receiver.data.size());
+            exit(1);
+        }
+        if (!resumed && receiver.data.size() >= kStreamSize / 3) {
+            uint32_t acknowledged = stream->get_acknowledged();
+            HostSim::disconnect(conn);
+            HostSim::run_host_events();
+            conn = HostSim::connect(247);
+            check(HostSim::subscribe(conn, stream_handle, true), "subscribe");
+            receiver.data.resize(acknowledged);
+            receiver.decoder.reset();
+            receiver.next_sequence = 0;
+            receiver.unacknowledged_packets = 0;
+            stream_command(conn, stream_handle, StreamCharacteristic::CommandStart, acknowledged, kWindow);
+            resumed = true;
+            continue;
+        }
+        if (receiver.unacknowledged_packets >= kWindow / 2) {
+            stream_command(conn, stream_handle, StreamCharacteristic::CommandAck,
+                           static_cast<uint32_t>(receiver.data.size()), static_cast<uint16_t>(receiver.unacknowledged_packets));
+            receiver.unacknowledged_packets = 0;
+        }
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    size_t allocs = g_allocations - allocs_before;
+    HostSim::set_notification_listener(nullptr, nullptr);
+    if (receiver.error || receiver.data != source) {
+        fprintf(stderr, "lz: compressed stream delivered %zu bytes with %s\n", receiver.data.size(),
+                receiver.error ? "a sequence or decode error" : "wrong content");
+        exit(1);
+    }
+    double kib = static_cast<double>(kStreamSize) / 1024.0;
+    snprintf(row, sizeof(row), "lz/stream log %zu pkts", receiver.packets);
+    print_row(row, 1, Result {elapsed / kib, static_cast<double>(allocs) / kib});
+    HostSim::disconnect(conn);
+}
+
+struct L2capPeer {
+    std::vector<uint8_t> received;   // device -> peer
+    std::vector<uint8_t> delivered;  // peer -> device, as seen by the receive callback
+    size_t tx_ready_events {0};
+    size_t disconnect_events {0};
+    bool pause_next {false};
+};
+
+void on_l2cap_sdu(int, const uint8_t* data, size_t len, void* arg) {
+    auto* peer = static_cast<L2capPeer*>(arg);
+    peer->received.insert(peer->received.end(), data, data + len);
+}
+
+void bench_l2cap() {
+    constexpr size_t kTxSize = 256 * 1024;
+    constexpr size_t kRxSize = 64 * 1024;
+    constexpr uint16_t kPsm = 0x0080;
+    constexpr uint16_t kMtu = 512;
+    constexpr uint16_t kMps = 247;
+    constexpr uint16_t kCredits = 16;
+    static std::vector<uint8_t> source(kTxSize);
+    for (size_t i = 0; i < kTxSize; ++i) {
+        source[i] = static_cast<uint8_t>(i * 13 + 5);
+    }
+    HostSim::reset();
+    ServiceManager manager;
+    L2capEndpoint endpoint(kPsm, kMtu);
+    ble_uuid128_t uuid = make_uuid(0, 0x06);
+    manager.emplace_service("Bench", make_uuid(0xFFFFFF, 0xED))->add_characteristic(endpoint.psm_characteristic("PSM", uuid));
+    check(manager.add_services_to_nimble("bench"), "add_services_to_nimble");
+    check(HostSim::start(), "HostSim::start");
+    check(endpoint.start(), "L2capEndpoint::start");
+    HostSim::set_gap_listener(&ServiceManager::gap_event_callback, &manager);
+
+    L2capPeer peer;
+    peer.received.reserve(kTxSize);
+    peer.delivered.reserve(kRxSize);
+    HostSim::set_l2cap_listener(&on_l2cap_sdu, &peer);
+    endpoint.set_event_callback([&peer](uint16_t, L2capEndpoint::Event event) {
+        peer.tx_ready_events += event == L2capEndpoint::Event::TxReady ? 1 : 0;
+        peer.disconnect_events += event == L2capEndpoint::Event::Disconnected ? 1 : 0;
+    });
+    endpoint.set_receive_callback([&peer](uint16_t, os_mbuf* sdu) {
+        size_t offset = peer.delivered.size();
+        peer.delivered.resize(offset + OS_MBUF_PKTLEN(sdu));
+        os_mbuf_copydata(sdu, 0, OS_MBUF_PKTLEN(sdu), peer.delivered.data() + offset);
+        os_mbuf_free_chain(sdu);
+        bool more = !peer.pause_next;
+        peer.pause_next = false;
+        return more;
+    });
+
+    // The central discovers the PSM over GATT, then opens the channel.
+    uint16_t conn = HostSim::connect(247);
+    uint8_t psm_value[2] = {};
+    size_t psm_len = 0;
+    check(HostSim::read(conn, HostSim::find_value_handle(&uuid.u), psm_value, sizeof(psm_value), &psm_len), "read PSM");
+    uint16_t psm = static_cast<uint16_t>(psm_value[0] | (psm_value[1] << 8));
+    int channel = HostSim::l2cap_connect(conn, psm, kMtu, kMps, kCredits);
+    if (psm_len != 2 || psm != kPsm || channel < 0 || !endpoint.is_connected(conn) || endpoint.get_peer_mtu(conn) != kMtu) {
+        fprintf(stderr, "l2cap: channel setup failed (psm 0x%04x, channel %d)\n", psm, channel);
+        exit(1);
+    }
+
+    // Device -> peer: full-MTU SDUs built straight into mbufs; the peer grants credits when stalled.
+    size_t allocs_before = g_allocations;
+    auto start = Clock::now();
+    size_t sent = 0;
+    while (sent < kTxSize) {
+        if (!endpoint.can_send(conn)) {
+            check(HostSim::l2cap_give_credits(channel, kCredits), "l2cap_give_credits");
+            continue;
+        }
+        uint16_t len = static_cast<uint16_t>(std::min<size_t>(kMtu, kTxSize - sent));
+        os_mbuf* sdu = os_msys_get_pkthdr(len, 0);
+        check(sdu && os_mbuf_append(sdu, source.data() + sent, len) == 0 ? 0 : BLE_HS_ENOMEM, "SDU allocation");
+        check(endpoint.send(conn, sdu), "L2capEndpoint::send");
+        sent += len;
+    }
+    while (!endpoint.can_send(conn)) {
+        check(HostSim::l2cap_give_credits(channel, kCredits), "l2cap_give_credits");
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    size_t allocs = g_allocations - allocs_before;
+    if (peer.received != source || peer.tx_ready_events == 0) {
+        fprintf(stderr, "l2cap: peer received %zu of %zu bytes (%zu unstalls)\n",
+                peer.received.size(), kTxSize, peer.tx_ready_events);
+        exit(1);
+    }
+    double kib = static_cast<double>(kTxSize) / 1024.0;
+    print_row("l2cap/256KiB tx per KiB", 1, Result {elapsed / kib, static_cast<double>(allocs) / kib});
+
+    // SDUs from other tasks are handed over and sent by the host task, one per connection at a time.
+    size_t received_before = peer.received.size();
+    os_mbuf* sdus[2];
+    for (os_mbuf*& sdu : sdus) {
+        sdu = os_msys_get_pkthdr(kMtu, 0);
+        check(sdu && os_mbuf_append(sdu, source.data(), kMtu) == 0 ? 0 : BLE_HS_ENOMEM, "SDU allocation");
+    }
+    check(endpoint.post_send(conn, sdus[0]), "L2capEndpoint::post_send");
+    int second = endpoint.post_send(conn, sdus[1]);
+    os_mbuf_free_chain(sdus[1]);
+    if (second != BLE_HS_EBUSY || peer.received.size() != received_before) {
+        fprintf(stderr, "l2cap: posted SDU sent outside the host task or a second one accepted (%d)\n", second);
+        exit(1);
+    }
+    HostSim::run_host_events();
+    while (!endpoint.can_send(conn)) {
+        check(HostSim::l2cap_give_credits(channel, kCredits), "l2cap_give_credits");
+    }
+    if (peer.received.size() != received_before + kMtu ||
+        memcmp(peer.received.data() + received_before, source.data(), kMtu) != 0) {
+        fprintf(stderr, "l2cap: posted SDU did not arrive (%zu bytes)\n", peer.received.size() - received_before);
+        exit(1);
+    }
+
+    // Peer -> device: the receive callback pauses once halfway, which stalls the peer until resumed.
+    allocs_before = g_allocations;
+    start = Clock::now();
+    bool paused = false;
+    for (size_t offset = 0; offset < kRxSize;) {
+        if (!paused && offset == kRxSize / 2) {
+            peer.pause_next = true;
+        }
+        int rc = HostSim::l2cap_send(channel, source.data() + offset, kMtu);
+        if (rc == BLE_HS_ESTALLED && !paused) {
+            paused = true;
+            endpoint.resume_receive(conn);
+            continue;
+        }
+        check(rc, "peer l2cap_send");
+        offset += kMtu;
+    }
+    elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    allocs = g_allocations - allocs_before;
+    if (!paused || peer.delivered.size() != kRxSize || memcmp(peer.delivered.data(), source.data(), kRxSize) != 0) {
+        fprintf(stderr, "l2cap: device received %zu of %zu bytes (%s)\n", peer.delivered.size(), kRxSize,
+                paused ? "content mismatch" : "never stalled");
+        exit(1);
+    }
+    kib = static_cast<double>(kRxSize) / 1024.0;
+    print_row("l2cap/64KiB rx per KiB", 1, Result {elapsed / kib, static_cast<double>(allocs) / kib});
+
+    HostSim::disconnect(conn);
+    HostSim::set_l2cap_listener(nullptr, nullptr);
+    if (peer.disconnect_events != 1 || endpoint.channel_count() != 0) {
+        fprintf(stderr, "l2cap: channel not closed with the link\n");
+        exit(1);
+    }
+}
+
+// True if data is a well-formed sequence of AD elements (length, type, payload).
+bool is_well_formed_ad(const uint8_t* data, size_t len) {
+    size_t offset = 0;
+    while (offset < len) {
+        if (data[offset] == 0 || offset + 1 + data[offset] > len) {
+            return false;
+        }
+        offset += 1 + data[offset];
+    }
+    return offset == len;
+}
+
+void bench_advertising(size_t min_ops) {
+    HostSim::reset();
+    ServiceManager manager;
+    ble_uuid128_t first_uuid = make_uuid(0xFFFFFF, 0xE0);
+    ble_uuid128_t second_uuid = make_uuid(0xFFFFFF, 0xE1);
+    manager.emplace_service("Primary", first_uuid);
+    manager.emplace_service("Secondary", second_uuid);
+    static const ble_uuid16_t battery_uuid = BLE_UUID16_INIT(0x180F);
+
+    // The 16-bit UUID goes first; the second service spills into the scan response.
+    AdvertisingBuilder builder;
+    builder.set_name("Sensor-42");
+    builder.set_tx_power(0);
+    check(builder.add_service_uuid(&battery_uuid.u), "add_service_uuid");
+    check(manager.add_service_uuids(builder), "add_service_uuids");
+    builder.build(AdvertisingBuilder::Mode::Legacy);
+    uint8_t expected_adv[28] = {0x02, 0x01, 0x06, 0x03, 0x03, 0x0F, 0x18, 0x11, 0x06};
+    memcpy(expected_adv + 9, first_uuid.value, 16);
+    memcpy(expected_adv + 25, "\x02\x0A\x00", 3);
+    uint8_t expected_rsp[29] = {0x11, 0x06};
+    memcpy(expected_rsp + 2, second_uuid.value, 16);
+    memcpy(expected_rsp + 18, "\x0A\x09Sensor-42", 11);
+    if (builder.get_adv_length() != sizeof(expected_adv) || memcmp(builder.get_adv_data(), expected_adv, sizeof(expected_adv)) != 0 ||
+        builder.get_scan_response_length() != sizeof(expected_rsp) ||
+        memcmp(builder.get_scan_response(), expected_rsp, sizeof(expected_rsp)) != 0 ||
+        builder.get_adv_uuid_count() != 2 || builder.get_dropped_count() != 0) {
+        fprintf(stderr, "advertising: unexpected legacy layout (%zu + %zu bytes)\n",
+                builder.get_adv_length(), builder.get_scan_response_length());
+        exit(1);
+    }
+    check(builder.apply(), "apply");
+    size_t applied_len = 0;
+    const uint8_t* applied = HostSim::advertising_data(&applied_len);
+    size_t applied_rsp_len = 0;
+    const uint8_t* applied_rsp = HostSim::scan_response_data(&applied_rsp_len);
+    if (applied_len != sizeof(expected_adv) || memcmp(applied, expected_adv, applied_len) != 0 ||
+        applied_rsp_len != sizeof(expected_rsp) || memcmp(applied_rsp, expected_rsp, applied_rsp_len) != 0) {
+        fprintf(stderr, "advertising: apply() did not hand the payloads to the stack\n");
+        exit(1);
+    }
+    print_row("adv/build legacy", 3, measure(1, min_ops, [&](size_t) {
+        builder.build(AdvertisingBuilder::Mode::Legacy);
+    }));
+
+    // Extended: everything in one packet, both 128-bit UUIDs in one complete list.
+    builder.build(AdvertisingBuilder::Mode::Extended);
+    uint8_t expected_ext[55] = {0x02, 0x01, 0x06, 0x03, 0x03, 0x0F, 0x18, 0x21, 0x07};
+    memcpy(expected_ext + 9, first_uuid.value, 16);
+    memcpy(expected_ext + 25, second_uuid.value, 16);
+    memcpy(expected_ext + 41, "\x02\x0A\x00\x0A\x09Sensor-42", 14);
+    if (builder.get_adv_length() != sizeof(expected_ext) || memcmp(builder.get_adv_data(), expected_ext, sizeof(expected_ext)) != 0 ||
+        builder.get_scan_response_length() != 0) {
+        fprintf(stderr, "advertising: unexpected extended layout (%zu bytes)\n", builder.get_adv_length());
+        exit(1);
+    }
+#ifndef CONFIG_BT_NIMBLE_EXT_ADV
+    if (builder.apply() != BLE_HS_ENOTSUP) {
+        fprintf(stderr, "advertising: extended payload applied without extended advertising\n");
+        exit(1);
+    }
+#endif
+    print_row("adv/build extended", 3, measure(1, min_ops, [&](size_t) {
+        builder.build(AdvertisingBuilder::Mode::Extended);
+    }));
+
+    // More services than fit: an incomplete list, the name shortened, nothing invalid.
+    for (uint32_t i = 0; i < 18; ++i) {
+        manager.emplace_service("Extra", make_uuid(i, 0xE2));
+    }
+    esp_ble_conn_config_t config = {};
+    memcpy(config.device_name, "Gateway sensor", 14);
+    {
+        ExpectedLogs quiet("CustomBLE/AdvertisingBuilder");
+        manager.populate_adv_data(config);
+    }
+    const uint8_t* ext = reinterpret_cast<const uint8_t*>(config.extended_adv_data);
+    if (config.extended_adv_len > AdvertisingBuilder::extended_max_size || !is_well_formed_ad(ext, config.extended_adv_len) ||
+        ext[4] != BLE_HS_ADV_TYPE_INCOMP_UUIDS128 || memcmp(ext + 5, first_uuid.value, 16) != 0 ||
+        memcmp(ext + config.extended_adv_len - 6, "\x05\x08Gate", 6) != 0) {
+        fprintf(stderr, "advertising: populate_adv_data() built a wrong payload (%u bytes)\n",
+                static_cast<unsigned>(config.extended_adv_len));
+        exit(1);
+    }
+    // Periodic data: a separate pass without flags, which leaves room for more of the name.
+    const uint8_t* periodic = reinterpret_cast<const uint8_t*>(config.periodic_adv_data);
+    if (!periodic || config.periodic_adv_len > AdvertisingBuilder::extended_max_size ||
+        !is_well_formed_ad(periodic, config.periodic_adv_len) || periodic[1] != BLE_HS_ADV_TYPE_INCOMP_UUIDS128 ||
+        memcmp(periodic + 2, first_uuid.value, 16) != 0 ||
+        memcmp(periodic + config.periodic_adv_len - 9, "\x08\x08Gateway", 9) != 0) {
+        fprintf(stderr, "advertising: populate_adv_data() built a wrong periodic payload (%u bytes)\n",
+                static_cast<unsigned>(config.periodic_adv_len));
+        exit(1);
+    }
+
+    // Nothing to advertise: no periodic data.
+    ServiceManager empty;
+    esp_ble_conn_config_t empty_config = {};
+    empty_config.periodic_adv_data = reinterpret_cast<const char*>(ext);
+    empty_config.periodic_adv_len = 1;
+    empty.populate_adv_data(empty_config);
+    if (empty_config.periodic_adv_data != nullptr || empty_config.periodic_adv_len != 0) {
+        fprintf(stderr, "advertising: periodic data without services\n");
+        exit(1);
+    }
+}
+
+void bench_long_read(size_t min_ops) {
+    HostSim::reset();
+    ServiceManager manager;
+    static uint8_t value[396];
+    static size_t callbacks = 0;
+    for (size_t i = 0; i < sizeof(value); ++i) {
+        value[i] = static_cast<uint8_t>(i);
+    }
+    ble_uuid128_t uuid = make_uuid(0, 0x02);
+    auto service = manager.emplace_service("Bench", make_uuid(0xFFFFFF, 0xEE));
+    auto characteristic = service->emplace_characteristic("Long value", uuid, [](ValueWriter& out) {
+        ++callbacks;
+        return out.append(value, sizeof(value));
+    });
+    check(manager.add_services_to_nimble("bench"), "add_services_to_nimble");
+    check(HostSim::start(), "HostSim::start");
+    HostSim::set_gap_listener(&ServiceManager::gap_event_callback, &manager);
+    uint16_t handle = HostSim::find_value_handle(&uuid.u);
+
+    for (uint16_t mtu : {uint16_t(23), uint16_t(247)}) {
+        uint16_t conn = HostSim::connect(mtu);
+        uint8_t out[BLE_ATT_MTU_MAX];
+        size_t reads = 0;
+        callbacks = 0;
+        Result result = measure(1, min_ops / 20, [&](size_t) {
+            // Read followed by Read Blob requests until a short fragment arrives.
+            size_t offset = 0;
+            size_t out_len = 0;
+            do {
+                check(HostSim::read(conn, handle, out, sizeof(out), &out_len, static_cast<uint16_t>(offset)), "read");
+                offset += out_len;
+            } while (out_len == static_cast<size_t>(mtu - 1));
+            if (offset != sizeof(value)) {
+                fprintf(stderr, "long read returned %zu bytes\n", offset);
+                exit(1);
+            }
+            ++reads;
+        });
+        if (callbacks != reads) {
+            fprintf(stderr, "long read ran the read callback %zu times for %zu reads\n", callbacks, reads);
+            exit(1);
+        }
+        char name[40];
+        snprintf(name, sizeof(name), "read-long/396B mtu%u", mtu);
+        print_row(name, 1, result);
+        HostSim::disconnect(conn);
+    }
+
+    // An abandoned long read must not answer the next Read after the value changed.
+    uint16_t conn = HostSim::connect(23);
+    uint8_t out[BLE_ATT_MTU_MAX];
+    size_t out_len = 0;
+    check(HostSim::read(conn, handle, out, sizeof(out), &out_len), "read");
+    value[0] = 0xA5;
+    characteristic->notify();
+    check(HostSim::read(conn, handle, out, sizeof(out), &out_len), "read");
+    value[0] = 0;
+    if (out_len == 0 || out[0] != 0xA5) {
+        fprintf(stderr, "long read: abandoned snapshot served after the value changed\n");
+        exit(1);
+    }
+    HostSim::disconnect(conn);
+}
+
+#ifdef CONFIG_CUSTOMBLE_ACCESS_STATS
+uint32_t get_le32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+void bench_diagnostics(size_t min_ops) {
+    HostSim::reset();
+    ServiceManager manager;
+    static uint32_t value = 0;
+    ble_uuid128_t uuid = make_uuid(0, 0x03);
+    ble_uuid128_t diagnostic_uuid = make_uuid(0xFFFFFE, 0xEE);
+    manager.emplace_service("Bench", make_uuid(0xFFFFFF, 0xEE))->add_characteristic(
+        Characteristic::from_pointer_read_write(uuid, &value, "Value"));
+    check(manager.emplace_diagnostic_service(diagnostic_uuid) ? 0 : -1, "emplace_diagnostic_service");
+    check(manager.add_services_to_nimble("bench"), "add_services_to_nimble");
+    check(HostSim::start(), "HostSim::start");
+    uint16_t handle = HostSim::find_value_handle(&uuid.u);
+    ble_uuid128_t select_uuid = diagnostic_uuid;
+    ble_uuid128_t stats_uuid = diagnostic_uuid;
+    select_uuid.value[12] += 1;
+    stats_uuid.value[12] += 2;
+    uint16_t select_handle = HostSim::find_value_handle(&select_uuid.u);
+    uint16_t stats_handle = HostSim::find_value_handle(&stats_uuid.u);
+
+    uint16_t conn = HostSim::connect(247);
+    uint8_t out[BLE_ATT_MTU_MAX];
+    size_t out_len = 0;
+    constexpr size_t kReads = 10;
+    for (size_t i = 0; i < kReads; ++i) {
+        check(HostSim::read(conn, handle, out, sizeof(out), &out_len), "read");
+    }
+    uint8_t selection[2] = {static_cast<uint8_t>(handle), static_cast<uint8_t>(handle >> 8)};
+    check(HostSim::write(conn, select_handle, selection, sizeof(selection)), "write");
+    check(HostSim::read(conn, stats_handle, out, sizeof(out), &out_len), "read");
+    uint32_t reads = get_le32(out + 2);
+    uint32_t bytes_out = get_le32(out + 14);
+    if (out_len != 2 + 20 + 4 * LatencyHistogram::bucket_count || reads != kReads || bytes_out != kReads * sizeof(value)) {
+        fprintf(stderr, "diagnostic service reported %u reads, %u bytes (%zu byte value)\n",
+                static_cast<unsigned>(reads), static_cast<unsigned>(bytes_out), out_len);
+        exit(1);
+    }
+    print_row("read/diagnostic stats", 1, measure(1, min_ops / 10, [&](size_t) {
+        check(HostSim::read(conn, stats_handle, out, sizeof(out), &out_len), "read");
+    }));
+    HostSim::disconnect(conn);
+}
+#endif
+
+void bench_long_write(size_t min_ops) {
+    HostSim::reset();
+    ServiceManager manager;
+    static std::string config_blob;
+    static uint8_t config_array[396];
+    static size_t writes = 0;
+    uint8_t payload[396];
+    for (size_t i = 0; i < sizeof(payload); ++i) {
+        payload[i] = static_cast<uint8_t>(i * 7);
+    }
+    ble_uuid128_t string_uuid = make_uuid(0, 0x03);
+    ble_uuid128_t view_uuid = make_uuid(1, 0x03);
+    auto service = manager.emplace_service("Bench", make_uuid(0xFFFFFF, 0xEE));
+    service->emplace_characteristic("Config blob", string_uuid, nullptr, [](const std::string& data) {
+        config_blob = data;
+        ++writes;
+    });
+    service->emplace_characteristic("Config array", view_uuid, nullptr, [](ValueReader& in) {
+        ++writes;
+        return in.copy_to(config_array, in.size() < sizeof(config_array) ? in.size() : sizeof(config_array));
+    });
+    for (const auto& entry : service->get_characteristics_manager().get_entries()) {
+        entry.characteristic->set_max_length(sizeof(payload));
+    }
+    check(manager.add_services_to_nimble("bench"), "add_services_to_nimble");
+    check(HostSim::start(), "HostSim::start");
+    HostSim::set_gap_listener(&ServiceManager::gap_event_callback, &manager);
+
+    struct Case {
+        const char* name;
+        const ble_uuid128_t* uuid;
+    };
+    for (const Case& c : {Case{"write-long/string 396B", &string_uuid}, Case{"write-long/view 396B", &view_uuid}}) {
+        uint16_t handle = HostSim::find_value_handle(&c.uuid->u);
+        uint16_t conn = HostSim::connect(BLE_ATT_MTU_DFLT);
+        const size_t fragment = BLE_ATT_MTU_DFLT - 5;
+        writes = 0;
+        size_t executes = 0;
+        Result result = measure(1, min_ops / 20, [&](size_t) {
+            for (size_t offset = 0; offset < sizeof(payload); offset += fragment) {
+                size_t len = sizeof(payload) - offset < fragment ? sizeof(payload) - offset : fragment;
+                check(HostSim::prepare_write(conn, handle, static_cast<uint16_t>(offset), payload + offset, len), "prepare_write");
+            }
+            check(HostSim::execute_write(conn), "execute_write");
+            ++executes;
+        });
+        if (writes != executes) {
+            fprintf(stderr, "long write ran the write callback %zu times for %zu writes\n", writes, executes);
+            exit(1);
+        }
+        print_row(c.name, 1, result);
+        HostSim::disconnect(conn);
+    }
+    if (config_blob.size() != sizeof(payload) || memcmp(config_blob.data(), payload, sizeof(payload)) != 0 ||
+        memcmp(config_array, payload, sizeof(payload)) != 0) {
+        fprintf(stderr, "long write corrupted the value\n");
+        exit(1);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t min_ops = 200000;
+    if (argc > 1) {
+        min_ops = strtoul(argv[1], nullptr, 10);
+    }
+    esp_log_level_set("*", ESP_LOG_WARN);
+
+    printf("%-28s %6s %12s %12s\n", "case", "N", "ns/op", "allocs/op");
+    for (size_t count : kSizes) {
+        bench_build(count);
+        switch (count) {
+            case 1: bench_static_table<1>(min_ops); break;
+            case 10: bench_static_table<10>(min_ops); break;
+            case 100: bench_static_table<100>(min_ops); break;
+            case 1000: bench_static_table<1000>(min_ops); break;
+        }
+        bench_dispatch(count, min_ops);
+    }
+    check_late_flags();
+    check_change_detector_copy();
+    check_read_cache();
+    check_conn_mgr_names();
+    bench_typed(min_ops);
+    bench_dashboard(min_ops);
+    bench_published(min_ops);
+    bench_deferred(min_ops);
+    bench_ingest();
+    bench_stream();
+    bench_compression();
+    bench_l2cap();
+    bench_advertising(min_ops);
+    bench_long_read(min_ops);
+    bench_long_write(min_ops);
+#ifdef CONFIG_CUSTOMBLE_ACCESS_STATS
+    bench_diagnostics(min_ops);
+#endif
+    if (HostSim::mbufs_in_use() != 0) {
+        fprintf(stderr, "mbuf leak: %zu mbufs still in use\n", HostSim::mbufs_in_use());
+        return 1;
+    }
+    return 0;
+}
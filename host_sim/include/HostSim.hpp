@@ -0,0 +1,247 @@
+#pragma once
+/*
+ * Driver API for the host-side NimBLE stand-in.
+ *
+ * HostSim plays the role of the NimBLE host task and a connected central:
+ * it assigns attribute handles when the GATT server starts and turns ATT
+ * requests into access callbacks exactly like ble_gatts does, so the
+ * CustomBLE hot paths can be exercised and measured on Linux.
+ *
+ * Nothing in here allocates from the heap after reset(); benchmarks can
+ * attribute every allocation they observe to the library under test.
+ */
+#include <cstddef>
+#include <cstdint>
+#include "host/ble_hs.h"
+#include "nimble/nimble_port.h"
+#include "esp_ble_conn_mgr.h"
+
+namespace HostSim {
+
+/**
+ * @brief Drop all registered services, connections and conn-mgr tables.
+ */
+void reset();
+
+/**
+ * @brief Register every service queued by ble_gatts_add_svcs() and assign handles.
+ * @return 0 on success, BLE_HS_* error code otherwise
+ */
+int start();
+
+/**
+ * @brief Number of attributes (including declarations and descriptors) in the GATT table.
+ */
+size_t attribute_count();
+
+/**
+ * @brief Find the value handle of the first characteristic with the given UUID.
+ * @return the value handle, or 0 if not found
+ */
+uint16_t find_value_handle(const ble_uuid_t* chr_uuid);
+
+/**
+ * @brief Find the handle of a descriptor belonging to the characteristic at value_handle.
+ * @return the descriptor handle, or 0 if not found
+ */
+uint16_t find_descriptor_handle(uint16_t value_handle, const ble_uuid_t* dsc_uuid);
+
+/**
+ * @brief Simulate a central connecting with the given negotiated ATT MTU.
+ *
+ * Emits BLE_GAP_EVENT_CONNECT (and BLE_GAP_EVENT_MTU if mtu differs from the default).
+ * @return the connection handle
+ */
+uint16_t connect(uint16_t mtu = BLE_ATT_MTU_DFLT);
+
+/**
+ * @brief Drop the connection, forget its CCCDs and emit BLE_GAP_EVENT_DISCONNECT.
+ */
+void disconnect(uint16_t conn_handle);
+
+/**
+ * @brief Perform an ATT Read (offset 0) or Read Blob (offset > 0) request.
+ *
+ * Like NimBLE, the access callback produces the full value and the stack
+ * returns at most ATT_MTU-1 bytes starting at offset.
+ *
+ * @return 0 on success, BLE_ATT_ERR_* otherwise
+ */
+int read(uint16_t conn_handle, uint16_t attr_handle,
+         uint8_t* out, size_t out_capacity, size_t* out_len, uint16_t offset = 0);
+
+/**
+ * @brief Perform an ATT Read Multiple (variable = false) or Read Multiple Variable request.
+ *
+ * Like NimBLE's ATT server, every attribute's access callback produces its
+ * whole value; Read Multiple concatenates the values, Read Multiple Variable
+ * precedes each with its length (u16 LE). The response is cut off at ATT_MTU-1
+ * bytes. The first failing attribute fails the whole request.
+ *
+ * @return 0 on success, BLE_ATT_ERR_* otherwise
+ */
+int read_multiple(uint16_t conn_handle, const uint16_t* attr_handles, size_t count, bool variable,
+                  uint8_t* out, size_t out_capacity, size_t* out_len);
+
+/**
+ * @brief Perform an ATT Write Request (value must fit ATT_MTU-3).
+ * @return 0 on success, BLE_ATT_ERR_* otherwise
+ */
+int write(uint16_t conn_handle, uint16_t attr_handle, const void* data, size_t len);
+
+/**
+ * @brief Perform an ATT Write Command (Write Without Response; value must fit ATT_MTU-3).
+ *
+ * NimBLE dispatches it like a Write Request but sends no response; the
+ * access callback's result is returned here for checks only.
+ * @return 0 on success, BLE_ATT_ERR_* otherwise
+ */
+int write_no_response(uint16_t conn_handle, uint16_t attr_handle, const void* data, size_t len);
+
+/**
+ * @brief Queue a Prepare Write fragment (at most mtu - 5 bytes) like NimBLE's ATT server.
+ * @return 0 on success, BLE_ATT_ERR_* otherwise
+ */
+int prepare_write(uint16_t conn_handle, uint16_t attr_handle, uint16_t offset, const void* data, size_t len);
+
+/**
+ * @brief Execute (commit) or cancel the queued Prepare Writes of a connection.
+ *
+ * On commit, each attribute's fragments are validated and handed to its access
+ * callback as one multi-segment os_mbuf chain, as NimBLE does.
+ * @return 0 on success, BLE_ATT_ERR_* otherwise
+ */
+int execute_write(uint16_t conn_handle, bool commit = true);
+
+/**
+ * @brief Receive GAP events (connect, disconnect, subscribe, MTU) like a ble_gap_event_fn.
+ */
+void set_gap_listener(ble_gap_event_fn* fn, void* arg);
+
+/**
+ * @brief Write the CCCD of the characteristic at value_handle and emit BLE_GAP_EVENT_SUBSCRIBE.
+ * @return 0 on success, BLE_ATT_ERR_* otherwise
+ */
+int subscribe(uint16_t conn_handle, uint16_t value_handle, bool notify, bool indicate = false);
+
+/**
+ * Called for every notification/indication the GATT server sends.
+ */
+using NotificationListener = void (*)(uint16_t conn_handle, uint16_t attr_handle,
+                                      const uint8_t* data, size_t len, bool indication, void* arg);
+void set_notification_listener(NotificationListener fn, void* arg);
+
+/**
+ * @brief Total notifications + indications sent since reset().
+ */
+size_t notifications_sent();
+
+/**
+ * @brief Fail the next count notifications/indications with BLE_HS_ENOMEM (the mbuf is consumed).
+ */
+void fail_notifications(size_t count);
+
+/**
+ * @brief Run all events queued on the default NimBLE event queue (one host task wakeup).
+ *
+ * Callouts that expired by now (see advance_time()) queue their events first.
+ * @return number of events processed
+ */
+size_t run_host_events();
+
+/**
+ * @brief Number of armed ble_npl_callouts.
+ */
+size_t active_callouts();
+
+/**
+ * @brief Number of events waiting on the default NimBLE event queue.
+ */
+size_t pending_host_events();
+
+/**
+ * @brief Move esp_timer_get_time() forward by us microseconds (e.g. to expire caches).
+ */
+void advance_time(int64_t us);
+
+/**
+ * @brief Number of services registered through esp_ble_conn_add_svc().
+ */
+size_t conn_mgr_service_count();
+
+/**
+ * @brief Invoke the conn-mgr read path of characteristic chr_index of service svc_index.
+ * @return ESP_OK on success; att_status receives the ATT status reported by the callback
+ */
+esp_err_t conn_mgr_read(size_t svc_index, size_t chr_index,
+                        uint8_t* out, size_t out_capacity, size_t* out_len,
+                        uint8_t* att_status = nullptr);
+
+/**
+ * @brief Invoke the conn-mgr write path of characteristic chr_index of service svc_index.
+ */
+esp_err_t conn_mgr_write(size_t svc_index, size_t chr_index,
+                         const void* data, size_t len, uint8_t* att_status = nullptr);
+
+/**
+ * @brief Pass callbacks a copy of the characteristic name as priv_data instead of the registered pointer.
+ */
+void conn_mgr_copy_names(bool copy);
+
+/**
+ * @brief Peer opens an L2CAP connection-oriented channel to the server registered for psm.
+ *
+ * The server callback sees BLE_L2CAP_EVENT_COC_ACCEPT (it must post a receive
+ * buffer with ble_l2cap_recv_ready()) and then BLE_L2CAP_EVENT_COC_CONNECTED.
+ * @param peer_mtu Largest SDU the peer accepts
+ * @param peer_mps Largest K-frame payload the peer accepts
+ * @param credits K-frames the peer grants initially
+ * @return the channel index for the other l2cap_* calls, or a negative BLE_HS_* code
+ */
+int l2cap_connect(uint16_t conn_handle, uint16_t psm, uint16_t peer_mtu, uint16_t peer_mps, uint16_t credits);
+
+/**
+ * @brief Peer sends one SDU on the channel (delivered as BLE_L2CAP_EVENT_COC_DATA_RECEIVED).
+ * @return 0, BLE_HS_ESTALLED if the device has no receive buffer posted (no
+ *         credits for the peer, nothing is sent), BLE_HS_EBADDATA if len exceeds
+ *         the device's MTU, BLE_HS_ENOTCONN for a closed channel
+ */
+int l2cap_send(int channel, const void* data, size_t len);
+
+/**
+ * @brief Peer grants K-frame credits; a stalled SDU continues and TX_UNSTALLED is emitted once it is out.
+ */
+int l2cap_give_credits(int channel, uint16_t credits);
+
+/**
+ * @brief Peer closes the channel (emits BLE_L2CAP_EVENT_COC_DISCONNECTED).
+ */
+int l2cap_disconnect(int channel);
+
+/**
+ * @brief K-frame credits the peer has left for the device.
+ */
+uint16_t l2cap_peer_credits(int channel);
+
+/**
+ * Called with every complete SDU the device sends to the peer.
+ */
+using L2capListener = void (*)(int channel, const uint8_t* data, size_t len, void* arg);
+void set_l2cap_listener(L2capListener fn, void* arg);
+
+/**
+ * @brief Advertising data last set with ble_gap_adv_set_data() or ble_gap_ext_adv_set_data().
+ */
+const uint8_t* advertising_data(size_t* len);
+
+/**
+ * @brief Scan response data last set with ble_gap_adv_rsp_set_data() or ble_gap_ext_adv_rsp_set_data().
+ */
+const uint8_t* scan_response_data(size_t* len);
+
+/**
+ * @brief Number of mbufs currently taken from the stand-in pool (leak check).
+ */
+size_t mbufs_in_use();
+
+} // namespace HostSim
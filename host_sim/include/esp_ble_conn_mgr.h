@@ -0,0 +1,96 @@
+#pragma once
+/*
+ * Host stand-in for esp-iot-solution's esp_ble_conn_mgr.h.
+ *
+ * Registered services are kept by the stand-in so HostSim can drive the
+ * uuid_fn callbacks the same way the connection manager does on target:
+ * priv_data is the characteristic's name pointer and the caller free()s outbuf.
+ */
+#include <stdint.h>
+#include "esp_err.h"
+#include "host/ble_uuid.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BLE_CONN_UUID_TYPE_16               16
+#define BLE_CONN_UUID_TYPE_32               32
+#define BLE_CONN_UUID_TYPE_128              128
+
+#define BLE_CONN_GATT_CHR_BROADCAST         0x0001
+#define BLE_CONN_GATT_CHR_READ              0x0002
+#define BLE_CONN_GATT_CHR_WRITE_NO_RSP      0x0004
+#define BLE_CONN_GATT_CHR_WRITE             0x0008
+#define BLE_CONN_GATT_CHR_NOTIFY            0x0010
+#define BLE_CONN_GATT_CHR_INDICATE          0x0020
+
+#define MAX_BLE_DEVNAME_LEN                 29
+#define BROADCAST_PARAM_LEN                 15
+
+typedef enum {
+    ESP_IOT_ATT_SUCCESS             = 0x00,
+    ESP_IOT_ATT_INVALID_HANDLE      = 0x01,
+    ESP_IOT_ATT_READ_NOT_PERMIT     = 0x02,
+    ESP_IOT_ATT_WRITE_NOT_PERMIT    = 0x03,
+    ESP_IOT_ATT_INVALID_PDU         = 0x04,
+    ESP_IOT_ATT_INSUF_AUTHENTICATION = 0x05,
+    ESP_IOT_ATT_REQ_NOT_SUPPORTED   = 0x06,
+    ESP_IOT_ATT_INVALID_OFFSET      = 0x07,
+    ESP_IOT_ATT_INSUF_AUTHORIZATION = 0x08,
+    ESP_IOT_ATT_PREPARE_Q_FULL      = 0x09,
+    ESP_IOT_ATT_NOT_FOUND           = 0x0a,
+    ESP_IOT_ATT_NOT_LONG            = 0x0b,
+    ESP_IOT_ATT_INSUF_KEY_SIZE      = 0x0c,
+    ESP_IOT_ATT_INVALID_ATTR_LEN    = 0x0d,
+    ESP_IOT_ATT_ERR_UNLIKELY        = 0x0e,
+    ESP_IOT_ATT_INSUF_ENCRYPTION    = 0x0f,
+    ESP_IOT_ATT_UNSUPPORT_GRP_TYPE  = 0x10,
+    ESP_IOT_ATT_INSUF_RESOURCE      = 0x11,
+} esp_ble_conn_att_status_t;
+
+typedef esp_err_t (*esp_ble_conn_cb_t)(const uint8_t *inbuf,
+                                       uint16_t inlen,
+                                       uint8_t **outbuf,
+                                       uint16_t *outlen,
+                                       void *priv_data,
+                                       uint8_t *att_status);
+
+typedef union {
+    uint16_t uuid16;
+    uint32_t uuid32;
+    uint8_t uuid128[BLE_UUID128_VAL_LEN];
+} esp_ble_conn_uuid_t;
+
+typedef struct {
+    const char *name;
+    uint8_t type;
+    uint16_t flag;
+    esp_ble_conn_uuid_t uuid;
+    esp_ble_conn_cb_t uuid_fn;
+} esp_ble_conn_character_t;
+
+typedef struct {
+    uint8_t type;
+    uint16_t nu_lookup_count;
+    esp_ble_conn_uuid_t uuid;
+    esp_ble_conn_character_t *nu_lookup;
+} esp_ble_conn_svc_t;
+
+typedef struct {
+    uint8_t device_name[MAX_BLE_DEVNAME_LEN];
+    uint8_t broadcast_data[BROADCAST_PARAM_LEN];
+    uint16_t extended_adv_len;
+    uint16_t periodic_adv_len;
+    const char *extended_adv_data;
+    const char *periodic_adv_data;
+    uint16_t include_service_uuid;
+    uint16_t adv_uuid16;
+} esp_ble_conn_config_t;
+
+esp_err_t esp_ble_conn_add_svc(const esp_ble_conn_svc_t *svc);
+esp_err_t esp_ble_conn_remove_svc(const esp_ble_conn_svc_t *svc);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,18 @@
+#pragma once
+/*
+ * Host stand-in for ESP-IDF's esp_timer.h (only what CustomBLE uses).
+ */
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Microseconds since start-up (steady clock plus HostSim::advance_time()).
+ */
+int64_t esp_timer_get_time(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,22 @@
+#pragma once
+/*
+ * Host stand-in for NimBLE's host/ble_hs_adv.h (AD types, flags and limits).
+ */
+
+#define BLE_HS_ADV_MAX_SZ                   31
+
+#define BLE_HS_ADV_TYPE_FLAGS               0x01
+#define BLE_HS_ADV_TYPE_INCOMP_UUIDS16      0x02
+#define BLE_HS_ADV_TYPE_COMP_UUIDS16        0x03
+#define BLE_HS_ADV_TYPE_INCOMP_UUIDS32      0x04
+#define BLE_HS_ADV_TYPE_COMP_UUIDS32        0x05
+#define BLE_HS_ADV_TYPE_INCOMP_UUIDS128     0x06
+#define BLE_HS_ADV_TYPE_COMP_UUIDS128       0x07
+#define BLE_HS_ADV_TYPE_INCOMP_NAME         0x08
+#define BLE_HS_ADV_TYPE_COMP_NAME           0x09
+#define BLE_HS_ADV_TYPE_TX_PWR_LVL          0x0a
+#define BLE_HS_ADV_TYPE_MFG_DATA            0xff
+
+#define BLE_HS_ADV_F_DISC_LTD               0x01
+#define BLE_HS_ADV_F_DISC_GEN               0x02
+#define BLE_HS_ADV_F_BREDR_UNSUP            0x04
@@ -0,0 +1,71 @@
+#pragma once
+/*
+ * Host stand-in for NimBLE's host/ble_uuid.h.
+ */
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    BLE_UUID_TYPE_16 = 16,
+    BLE_UUID_TYPE_32 = 32,
+    BLE_UUID_TYPE_128 = 128,
+};
+
+#define BLE_UUID128_VAL_LEN 16
+#define BLE_UUID_STR_LEN (37)
+
+typedef struct {
+    uint8_t type;
+} ble_uuid_t;
+
+typedef struct {
+    ble_uuid_t u;
+    uint16_t value;
+} ble_uuid16_t;
+
+typedef struct {
+    ble_uuid_t u;
+    uint32_t value;
+} ble_uuid32_t;
+
+typedef struct {
+    ble_uuid_t u;
+    uint8_t value[16];
+} ble_uuid128_t;
+
+typedef union {
+    ble_uuid_t u;
+    ble_uuid16_t u16;
+    ble_uuid32_t u32;
+    ble_uuid128_t u128;
+} ble_uuid_any_t;
+
+#define BLE_UUID16_INIT(uuid16)         \
+    {                                   \
+        { BLE_UUID_TYPE_16 },           \
+        (uuid16),                       \
+    }
+
+#define BLE_UUID32_INIT(uuid32)         \
+    {                                   \
+        { BLE_UUID_TYPE_32 },           \
+        (uuid32),                       \
+    }
+
+#define BLE_UUID128_INIT(uuid128...)    \
+    {                                   \
+        { BLE_UUID_TYPE_128 },          \
+        { uuid128 },                    \
+    }
+
+int ble_uuid_cmp(const ble_uuid_t *uuid1, const ble_uuid_t *uuid2);
+uint8_t ble_uuid_length(const ble_uuid_t *uuid);
+char *ble_uuid_to_str(const ble_uuid_t *uuid, char *dst);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,55 @@
+#pragma once
+/*
+ * Host stand-in for NimBLE's nimble/nimble_npl.h (events and callouts).
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct ble_npl_event;
+typedef void ble_npl_event_fn(struct ble_npl_event *ev);
+
+struct ble_npl_event {
+    bool queued;
+    ble_npl_event_fn *fn;
+    void *arg;
+    struct ble_npl_event *next;
+};
+
+struct ble_npl_eventq {
+    struct ble_npl_event *head;
+    struct ble_npl_event *tail;
+};
+
+typedef uint32_t ble_npl_time_t;
+
+/* A timer that puts its event on evq when it expires (esp_timer_get_time(), see HostSim::advance_time()). */
+struct ble_npl_callout {
+    struct ble_npl_event ev;
+    struct ble_npl_eventq *evq;
+    int64_t expires_us;
+    bool active;
+    struct ble_npl_callout *next;
+};
+
+void ble_npl_event_init(struct ble_npl_event *ev, ble_npl_event_fn *fn, void *arg);
+void *ble_npl_event_get_arg(struct ble_npl_event *ev);
+bool ble_npl_event_is_queued(struct ble_npl_event *ev);
+void ble_npl_eventq_put(struct ble_npl_eventq *evq, struct ble_npl_event *ev);
+void ble_npl_eventq_remove(struct ble_npl_eventq *evq, struct ble_npl_event *ev);
+
+/* One tick is one millisecond. */
+ble_npl_time_t ble_npl_time_ms_to_ticks32(uint32_t ms);
+void ble_npl_callout_init(struct ble_npl_callout *co, struct ble_npl_eventq *evq, ble_npl_event_fn *ev_cb, void *ev_arg);
+int ble_npl_callout_reset(struct ble_npl_callout *co, ble_npl_time_t ticks);
+void ble_npl_callout_stop(struct ble_npl_callout *co);
+bool ble_npl_callout_is_active(struct ble_npl_callout *co);
+void ble_npl_callout_deinit(struct ble_npl_callout *co);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,18 @@
+#pragma once
+/*
+ * Host stand-in for NimBLE's nimble/nimble_port.h.
+ *
+ * Events put on the default queue run when HostSim::run_host_events() is called,
+ * which plays the role of one NimBLE host task wakeup.
+ */
+#include "nimble/nimble_npl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct ble_npl_eventq *nimble_port_get_dflt_eventq(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,12 @@
+#pragma once
+/*
+ * Host stand-in for NimBLE's nimble/nimble_port_freertos.h.
+ *
+ * Only the NPL hooks ServiceManager uses to make sure the OS layer is ready.
+ */
+
+struct npl_funcs_t;
+
+struct npl_funcs_t *npl_freertos_funcs_get(void);
+void npl_freertos_funcs_init(void);
+int npl_freertos_mempool_init(void);
@@ -0,0 +1,68 @@
+#pragma once
+/*
+ * Host stand-in for NimBLE's os/os_mbuf.h.
+ *
+ * Mirrors the public mbuf API CustomBLE relies on. Buffers come from a fixed
+ * static pool (like NimBLE's msys pools), so the stand-in itself never touches
+ * the heap while dispatching GATT accesses. The block size is deliberately
+ * small so that long values produce multi-segment chains, as on the target.
+ */
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef OS_MBUF_SIM_BLOCK_SIZE
+#define OS_MBUF_SIM_BLOCK_SIZE 128
+#endif
+
+#ifndef OS_MBUF_SIM_POOL_COUNT
+#define OS_MBUF_SIM_POOL_COUNT 256
+#endif
+
+#define OS_ENOMEM 1
+#define OS_EINVAL 2
+
+#define SLIST_ENTRY(type) struct { struct type *sle_next; }
+#define SLIST_NEXT(elm, field) ((elm)->field.sle_next)
+
+struct os_mbuf_pkthdr {
+    uint16_t omp_len;
+    uint16_t omp_flags;
+};
+
+struct os_mbuf {
+    uint8_t *om_data;
+    uint8_t om_flags;
+    uint8_t om_pkthdr_len;
+    uint16_t om_len;
+    void *om_omp;
+    SLIST_ENTRY(os_mbuf) om_next;
+    /* Stand-in only: the packet header lives inline instead of in om_databuf. */
+    struct os_mbuf_pkthdr om_pkthdr;
+    uint8_t om_databuf[OS_MBUF_SIM_BLOCK_SIZE];
+};
+
+#define OS_MBUF_PKTHDR(__om) (&(__om)->om_pkthdr)
+#define OS_MBUF_PKTLEN(__om) (OS_MBUF_PKTHDR(__om)->omp_len)
+#define OS_MBUF_DATA(__om, __type) ((__type)((__om)->om_data))
+#define OS_MBUF_TRAILINGSPACE(__om) \
+    ((uint16_t)(&(__om)->om_databuf[OS_MBUF_SIM_BLOCK_SIZE] - ((__om)->om_data + (__om)->om_len)))
+
+struct os_mbuf *os_msys_get_pkthdr(uint16_t dsize, uint16_t user_hdr_len);
+struct os_mbuf *os_msys_get(uint16_t dsize, uint16_t leadingspace);
+int os_mbuf_append(struct os_mbuf *om, const void *data, uint16_t len);
+int os_mbuf_appendfrom(struct os_mbuf *dst, const struct os_mbuf *src, uint16_t src_off, uint16_t len);
+int os_mbuf_copydata(const struct os_mbuf *m, int off, int len, void *dst);
+int os_mbuf_copyinto(struct os_mbuf *om, int off, const void *src, int len);
+void *os_mbuf_extend(struct os_mbuf *om, uint16_t len);
+void os_mbuf_adj(struct os_mbuf *mp, int req_len);
+struct os_mbuf *os_mbuf_concat(struct os_mbuf *first, struct os_mbuf *second);
+int os_mbuf_free(struct os_mbuf *mb);
+int os_mbuf_free_chain(struct os_mbuf *om);
+
+#ifdef __cplusplus
+}
+#endif
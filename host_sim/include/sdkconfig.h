@@ -0,0 +1,9 @@
+#pragma once
+/*
+ * Host stand-in for the generated sdkconfig.h.
+ *
+ * Only NimBLE options CustomBLE reads are defined; CustomBLE's own
+ * CONFIG_CUSTOMBLE_* options fall back to their in-code defaults unless
+ * they are passed as compiler defines.
+ */
+#define CONFIG_BT_NIMBLE_MAX_CONNECTIONS 4
@@ -0,0 +1,136 @@
+#include "HostSim.hpp"
+#include "esp_ble_conn_mgr.h"
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+#ifndef HOST_SIM_MAX_CONN_MGR_SERVICES
+#define HOST_SIM_MAX_CONN_MGR_SERVICES 64
+#endif
+
+esp_ble_conn_svc_t g_services[HOST_SIM_MAX_CONN_MGR_SERVICES];
+size_t g_service_count = 0;
+
+// With copy_names, callbacks get a heap copy of the name instead of the registered pointer.
+bool g_copy_names = false;
+
+// priv_data for one callback; a copy is released with release_priv_data() afterwards.
+void* priv_data(const esp_ble_conn_character_t* chr) {
+    if (!g_copy_names || !chr->name) {
+        return (void*)chr->name;
+    }
+    return strdup(chr->name);
+}
+
+void release_priv_data(const esp_ble_conn_character_t* chr, void* data) {
+    if (data != chr->name) {
+        free(data);
+    }
+}
+
+const esp_ble_conn_character_t* character(size_t svc_index, size_t chr_index) {
+    if (svc_index >= g_service_count) {
+        return nullptr;
+    }
+    const esp_ble_conn_svc_t& svc = g_services[svc_index];
+    if (chr_index >= svc.nu_lookup_count) {
+        return nullptr;
+    }
+    return &svc.nu_lookup[chr_index];
+}
+
+} // namespace
+
+extern "C" {
+
+esp_err_t esp_ble_conn_add_svc(const esp_ble_conn_svc_t* svc) {
+    if (!svc) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (g_service_count >= HOST_SIM_MAX_CONN_MGR_SERVICES) {
+        return ESP_ERR_NO_MEM;
+    }
+    g_services[g_service_count++] = *svc;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_conn_remove_svc(const esp_ble_conn_svc_t* svc) {
+    for (size_t i = 0; i < g_service_count; ++i) {
+        if (std::memcmp(&g_services[i].uuid, &svc->uuid, sizeof(svc->uuid)) == 0) {
+            for (size_t j = i + 1; j < g_service_count; ++j) {
+                g_services[j - 1] = g_services[j];
+            }
+            --g_service_count;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+} // extern "C"
+
+namespace HostSim {
+
+void reset_conn_mgr() {
+    g_service_count = 0;
+    g_copy_names = false;
+}
+
+void conn_mgr_copy_names(bool copy) {
+    g_copy_names = copy;
+}
+
+size_t conn_mgr_service_count() {
+    return g_service_count;
+}
+
+esp_err_t conn_mgr_read(size_t svc_index, size_t chr_index,
+                        uint8_t* out, size_t out_capacity, size_t* out_len,
+                        uint8_t* att_status) {
+    if (out_len) {
+        *out_len = 0;
+    }
+    const esp_ble_conn_character_t* chr = character(svc_index, chr_index);
+    if (!chr || !chr->uuid_fn) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    uint8_t* outbuf = nullptr;
+    uint16_t outlen = 0;
+    uint8_t status = ESP_IOT_ATT_SUCCESS;
+    void* data = priv_data(chr);
+    esp_err_t err = chr->uuid_fn(nullptr, 0, &outbuf, &outlen, data, &status);
+    release_priv_data(chr, data);
+    if (err == ESP_OK && outbuf) {
+        size_t chunk = outlen < out_capacity ? outlen : out_capacity;
+        std::memcpy(out, outbuf, chunk);
+        if (out_len) {
+            *out_len = chunk;
+        }
+    }
+    // The connection manager owns outbuf once the callback returns.
+    free(outbuf);
+    if (att_status) {
+        *att_status = status;
+    }
+    return err;
+}
+
+esp_err_t conn_mgr_write(size_t svc_index, size_t chr_index,
+                         const void* data, size_t len, uint8_t* att_status) {
+    const esp_ble_conn_character_t* chr = character(svc_index, chr_index);
+    if (!chr || !chr->uuid_fn) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    uint8_t status = ESP_IOT_ATT_SUCCESS;
+    void* name = priv_data(chr);
+    esp_err_t err = chr->uuid_fn(static_cast<const uint8_t*>(data), static_cast<uint16_t>(len),
+                                 nullptr, nullptr, name, &status);
+    release_priv_data(chr, name);
+    if (att_status) {
+        *att_status = status;
+    }
+    return err;
+}
+
+} // namespace HostSim
@@ -0,0 +1,186 @@
+#include "HostSim.hpp"
+#include "esp_timer.h"
+#include "nimble/nimble_port.h"
+
+namespace {
+
+ble_npl_eventq g_default_queue = {nullptr, nullptr};
+ble_npl_callout* g_callouts = nullptr;  // active callouts, unordered
+
+void unlink_callout(ble_npl_callout* co) {
+    for (ble_npl_callout** it = &g_callouts; *it; it = &(*it)->next) {
+        if (*it == co) {
+            *it = co->next;
+            break;
+        }
+    }
+    co->next = nullptr;
+    co->active = false;
+}
+
+// Puts the events of expired callouts on their queues.
+void fire_callouts() {
+    int64_t now = esp_timer_get_time();
+    ble_npl_callout** it = &g_callouts;
+    while (*it) {
+        ble_npl_callout* co = *it;
+        if (co->expires_us > now) {
+            it = &co->next;
+            continue;
+        }
+        *it = co->next;
+        co->next = nullptr;
+        co->active = false;
+        ble_npl_eventq_put(co->evq, &co->ev);
+    }
+}
+
+} // namespace
+
+extern "C" {
+
+void ble_npl_event_init(ble_npl_event* ev, ble_npl_event_fn* fn, void* arg) {
+    ev->queued = false;
+    ev->fn = fn;
+    ev->arg = arg;
+    ev->next = nullptr;
+}
+
+void* ble_npl_event_get_arg(ble_npl_event* ev) {
+    return ev->arg;
+}
+
+bool ble_npl_event_is_queued(ble_npl_event* ev) {
+    return ev->queued;
+}
+
+void ble_npl_eventq_put(ble_npl_eventq* evq, ble_npl_event* ev) {
+    if (ev->queued) {
+        return;
+    }
+    ev->queued = true;
+    ev->next = nullptr;
+    if (evq->tail) {
+        evq->tail->next = ev;
+    } else {
+        evq->head = ev;
+    }
+    evq->tail = ev;
+}
+
+void ble_npl_eventq_remove(ble_npl_eventq* evq, ble_npl_event* ev) {
+    if (!ev->queued) {
+        return;
+    }
+    ble_npl_event* prev = nullptr;
+    for (ble_npl_event* it = evq->head; it; prev = it, it = it->next) {
+        if (it != ev) {
+            continue;
+        }
+        if (prev) {
+            prev->next = it->next;
+        } else {
+            evq->head = it->next;
+        }
+        if (evq->tail == it) {
+            evq->tail = prev;
+        }
+        break;
+    }
+    ev->queued = false;
+    ev->next = nullptr;
+}
+
+ble_npl_time_t ble_npl_time_ms_to_ticks32(uint32_t ms) {
+    return ms;
+}
+
+void ble_npl_callout_init(ble_npl_callout* co, ble_npl_eventq* evq, ble_npl_event_fn* ev_cb, void* ev_arg) {
+    ble_npl_event_init(&co->ev, ev_cb, ev_arg);
+    co->evq = evq;
+    co->expires_us = 0;
+    co->active = false;
+    co->next = nullptr;
+}
+
+int ble_npl_callout_reset(ble_npl_callout* co, ble_npl_time_t ticks) {
+    if (!co->active) {
+        co->next = g_callouts;
+        g_callouts = co;
+        co->active = true;
+    }
+    co->expires_us = esp_timer_get_time() + static_cast<int64_t>(ticks) * 1000;
+    return 0;
+}
+
+void ble_npl_callout_stop(ble_npl_callout* co) {
+    if (co->active) {
+        unlink_callout(co);
+    }
+    ble_npl_eventq_remove(co->evq, &co->ev);
+}
+
+bool ble_npl_callout_is_active(ble_npl_callout* co) {
+    return co->active;
+}
+
+void ble_npl_callout_deinit(ble_npl_callout* co) {
+    ble_npl_callout_stop(co);
+}
+
+ble_npl_eventq* nimble_port_get_dflt_eventq(void) {
+    return &g_default_queue;
+}
+
+} // extern "C"
+
+namespace HostSim {
+
+size_t run_host_events() {
+    fire_callouts();
+    // Only run what is queued now; events queued by handlers wait for the next wakeup.
+    ble_npl_event* batch = g_default_queue.head;
+    g_default_queue.head = nullptr;
+    g_default_queue.tail = nullptr;
+    size_t count = 0;
+    while (batch) {
+        ble_npl_event* next = batch->next;
+        batch->queued = false;
+        batch->next = nullptr;
+        batch->fn(batch);
+        batch = next;
+        ++count;
+    }
+    return count;
+}
+
+size_t pending_host_events() {
+    size_t count = 0;
+    for (ble_npl_event* it = g_default_queue.head; it; it = it->next) {
+        ++count;
+    }
+    return count;
+}
+
+size_t active_callouts() {
+    size_t count = 0;
+    for (ble_npl_callout* it = g_callouts; it; it = it->next) {
+        ++count;
+    }
+    return count;
+}
+
+void reset_event_queue() {
+    while (g_callouts) {
+        unlink_callout(g_callouts);
+    }
+    while (g_default_queue.head) {
+        ble_npl_event* ev = g_default_queue.head;
+        g_default_queue.head = ev->next;
+        ev->queued = false;
+        ev->next = nullptr;
+    }
+    g_default_queue.tail = nullptr;
+}
+
+} // namespace HostSim
@@ -0,0 +1,85 @@
+#include "HostSim.hpp"
+#include "host/ble_hs.h"
+#include <cstring>
+
+#ifndef HOST_SIM_MAX_EXT_ADV_DATA
+#define HOST_SIM_MAX_EXT_ADV_DATA 251
+#endif
+
+namespace {
+
+struct AdvPayload {
+    uint8_t data[HOST_SIM_MAX_EXT_ADV_DATA];
+    size_t length;
+};
+
+// Legacy and extended setters share one payload per kind, like a single advertising instance.
+AdvPayload g_adv;
+AdvPayload g_scan_response;
+
+int store(AdvPayload& payload, const uint8_t* data, int data_len, size_t limit) {
+    if (data_len < 0 || static_cast<size_t>(data_len) > limit || (!data && data_len > 0)) {
+        return BLE_HS_EINVAL;
+    }
+    if (data_len > 0) {
+        memcpy(payload.data, data, static_cast<size_t>(data_len));
+    }
+    payload.length = static_cast<size_t>(data_len);
+    return 0;
+}
+
+int store_ext(AdvPayload& payload, os_mbuf* data) {
+    if (!data) {
+        return BLE_HS_EINVAL;
+    }
+    uint16_t length = OS_MBUF_PKTLEN(data);
+    int rc = BLE_HS_EINVAL;
+    if (length <= HOST_SIM_MAX_EXT_ADV_DATA) {
+        uint16_t copied = 0;
+        rc = ble_hs_mbuf_to_flat(data, payload.data, length, &copied);
+        payload.length = rc == 0 ? copied : 0;
+    }
+    os_mbuf_free_chain(data);
+    return rc;
+}
+
+} // namespace
+
+extern "C" {
+
+int ble_gap_adv_set_data(const uint8_t* data, int data_len) {
+    return store(g_adv, data, data_len, BLE_HS_ADV_MAX_SZ);
+}
+
+int ble_gap_adv_rsp_set_data(const uint8_t* data, int data_len) {
+    return store(g_scan_response, data, data_len, BLE_HS_ADV_MAX_SZ);
+}
+
+int ble_gap_ext_adv_set_data(uint8_t, os_mbuf* data) {
+    return store_ext(g_adv, data);
+}
+
+int ble_gap_ext_adv_rsp_set_data(uint8_t, os_mbuf* data) {
+    return store_ext(g_scan_response, data);
+}
+
+} // extern "C"
+
+namespace HostSim {
+
+void reset_gap() {
+    g_adv.length = 0;
+    g_scan_response.length = 0;
+}
+
+const uint8_t* advertising_data(size_t* len) {
+    *len = g_adv.length;
+    return g_adv.data;
+}
+
+const uint8_t* scan_response_data(size_t* len) {
+    *len = g_scan_response.length;
+    return g_scan_response.data;
+}
+
+} // namespace HostSim
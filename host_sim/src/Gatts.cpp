@@ -0,0 +1,713 @@
+#include "HostSim.hpp"
+#include "host/ble_hs.h"
+#include <cstring>
+
+namespace {
+
+#ifndef HOST_SIM_MAX_ATTRIBUTES
+#define HOST_SIM_MAX_ATTRIBUTES 8192
+#endif
+#ifndef HOST_SIM_MAX_SVC_ARRAYS
+#define HOST_SIM_MAX_SVC_ARRAYS 64
+#endif
+#ifndef HOST_SIM_MAX_CONNECTIONS
+#define HOST_SIM_MAX_CONNECTIONS 8
+#endif
+
+enum class AttrKind : uint8_t {
+    Service,
+    ChrDecl,
+    ChrValue,
+    Cccd,
+    Descriptor,
+};
+
+struct Attribute {
+    AttrKind kind;
+    const ble_gatt_svc_def* svc;
+    const ble_gatt_chr_def* chr;
+    const ble_gatt_dsc_def* dsc;
+};
+
+#ifndef HOST_SIM_MAX_PREP_ENTRIES
+#define HOST_SIM_MAX_PREP_ENTRIES 64
+#endif
+
+// One queued Prepare Write fragment (NimBLE keeps these as mbufs from the msys pool).
+struct PrepEntry {
+    uint16_t attr_handle;
+    uint16_t offset;
+    os_mbuf* om;
+};
+
+struct Connection {
+    bool in_use;
+    uint16_t mtu;
+    PrepEntry prep[HOST_SIM_MAX_PREP_ENTRIES];
+    size_t prep_count;
+};
+
+const ble_uuid16_t cccd_uuid = BLE_UUID16_INIT(0x2902);
+
+const ble_gatt_svc_def* g_pending[HOST_SIM_MAX_SVC_ARRAYS];
+size_t g_pending_count = 0;
+
+// Attribute handles start at 1; g_attrs[handle - 1] describes that handle.
+Attribute g_attrs[HOST_SIM_MAX_ATTRIBUTES];
+size_t g_attr_count = 0;
+
+Connection g_conns[HOST_SIM_MAX_CONNECTIONS];
+
+#ifndef HOST_SIM_MAX_CCCDS
+#define HOST_SIM_MAX_CCCDS 1024
+#endif
+
+struct CccdState {
+    uint16_t conn_handle;
+    uint16_t value_handle;
+    bool notify;
+    bool indicate;
+};
+
+CccdState g_cccds[HOST_SIM_MAX_CCCDS];
+size_t g_cccd_count = 0;
+
+ble_gap_event_fn* g_gap_listener = nullptr;
+void* g_gap_listener_arg = nullptr;
+HostSim::NotificationListener g_notification_listener = nullptr;
+void* g_notification_listener_arg = nullptr;
+size_t g_notifications_sent = 0;
+size_t g_notifications_to_fail = 0;
+
+void emit_gap_event(ble_gap_event& event) {
+    if (g_gap_listener) {
+        g_gap_listener(&event, g_gap_listener_arg);
+    }
+}
+
+CccdState* find_cccd(uint16_t conn_handle, uint16_t value_handle) {
+    for (size_t i = 0; i < g_cccd_count; ++i) {
+        if (g_cccds[i].conn_handle == conn_handle && g_cccds[i].value_handle == value_handle) {
+            return &g_cccds[i];
+        }
+    }
+    return nullptr;
+}
+
+const Attribute* attribute(uint16_t handle) {
+    if (handle == 0 || handle > g_attr_count) {
+        return nullptr;
+    }
+    return &g_attrs[handle - 1];
+}
+
+int push_attribute(AttrKind kind, const ble_gatt_svc_def* svc,
+                   const ble_gatt_chr_def* chr, const ble_gatt_dsc_def* dsc) {
+    if (g_attr_count >= HOST_SIM_MAX_ATTRIBUTES) {
+        return BLE_HS_ENOMEM;
+    }
+    g_attrs[g_attr_count++] = {kind, svc, chr, dsc};
+    return 0;
+}
+
+uint16_t conn_mtu(uint16_t conn_handle) {
+    if (conn_handle >= HOST_SIM_MAX_CONNECTIONS || !g_conns[conn_handle].in_use) {
+        return 0;
+    }
+    return g_conns[conn_handle].mtu;
+}
+
+void clear_prep_queue(Connection& conn) {
+    for (size_t i = 0; i < conn.prep_count; ++i) {
+        os_mbuf_free_chain(conn.prep[i].om);
+    }
+    conn.prep_count = 0;
+}
+
+} // namespace
+
+extern "C" {
+
+int ble_gatts_count_cfg(const ble_gatt_svc_def* defs) {
+    if (!defs) {
+        return BLE_HS_EINVAL;
+    }
+    for (const ble_gatt_svc_def* svc = defs; svc->type != BLE_GATT_SVC_TYPE_END; ++svc) {
+        if (!svc->uuid) {
+            return BLE_HS_EINVAL;
+        }
+        if (!svc->characteristics) {
+            continue;
+        }
+        for (const ble_gatt_chr_def* chr = svc->characteristics; chr->uuid; ++chr) {
+            if (!chr->access_cb) {
+                return BLE_HS_EINVAL;
+            }
+            if (chr->descriptors) {
+                for (const ble_gatt_dsc_def* dsc = chr->descriptors; dsc->uuid; ++dsc) {
+                    if (!dsc->access_cb) {
+                        return BLE_HS_EINVAL;
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+int ble_gatts_add_svcs(const ble_gatt_svc_def* svcs) {
+    if (g_pending_count >= HOST_SIM_MAX_SVC_ARRAYS) {
+        return BLE_HS_ENOMEM;
+    }
+    g_pending[g_pending_count++] = svcs;
+    return 0;
+}
+
+int ble_gatts_start(void) {
+    g_attr_count = 0;
+    for (size_t i = 0; i < g_pending_count; ++i) {
+        for (const ble_gatt_svc_def* svc = g_pending[i]; svc->type != BLE_GATT_SVC_TYPE_END; ++svc) {
+            int rc = push_attribute(AttrKind::Service, svc, nullptr, nullptr);
+            if (rc != 0) {
+                return rc;
+            }
+            if (!svc->characteristics) {
+                continue;
+            }
+            for (const ble_gatt_chr_def* chr = svc->characteristics; chr->uuid; ++chr) {
+                rc = push_attribute(AttrKind::ChrDecl, svc, chr, nullptr);
+                if (rc == 0) {
+                    rc = push_attribute(AttrKind::ChrValue, svc, chr, nullptr);
+                }
+                if (rc != 0) {
+                    return rc;
+                }
+                if (chr->val_handle) {
+                    *chr->val_handle = static_cast<uint16_t>(g_attr_count);
+                }
+                if (chr->flags & (BLE_GATT_CHR_F_NOTIFY | BLE_GATT_CHR_F_INDICATE)) {
+                    rc = push_attribute(AttrKind::Cccd, svc, chr, nullptr);
+                    if (rc != 0) {
+                        return rc;
+                    }
+                }
+                if (!chr->descriptors) {
+                    continue;
+                }
+                for (const ble_gatt_dsc_def* dsc = chr->descriptors; dsc->uuid; ++dsc) {
+                    rc = push_attribute(AttrKind::Descriptor, svc, chr, dsc);
+                    if (rc != 0) {
+                        return rc;
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+void ble_gatts_reset(void) {
+    g_pending_count = 0;
+    g_attr_count = 0;
+}
+
+int ble_gatts_find_chr(const ble_uuid_t* svc_uuid, const ble_uuid_t* chr_uuid,
+                       uint16_t* out_def_handle, uint16_t* out_val_handle) {
+    for (size_t i = 0; i < g_attr_count; ++i) {
+        const Attribute& attr = g_attrs[i];
+        if (attr.kind != AttrKind::ChrDecl) {
+            continue;
+        }
+        if (ble_uuid_cmp(attr.svc->uuid, svc_uuid) != 0 || ble_uuid_cmp(attr.chr->uuid, chr_uuid) != 0) {
+            continue;
+        }
+        if (out_def_handle) {
+            *out_def_handle = static_cast<uint16_t>(i + 1);
+        }
+        if (out_val_handle) {
+            *out_val_handle = static_cast<uint16_t>(i + 2);
+        }
+        return 0;
+    }
+    return BLE_HS_ENOENT;
+}
+
+static int send_value(uint16_t conn_handle, uint16_t attr_handle, os_mbuf* om, bool indication) {
+    const Attribute* attr = attribute(attr_handle);
+    uint16_t mtu = conn_mtu(conn_handle);
+    int rc = 0;
+    if (mtu == 0) {
+        rc = BLE_HS_ENOTCONN;
+    } else if (g_notifications_to_fail > 0) {
+        --g_notifications_to_fail;
+        rc = BLE_HS_ENOMEM;
+    } else if (!attr || attr->kind != AttrKind::ChrValue) {
+        rc = BLE_HS_ENOENT;
+    } else if (OS_MBUF_PKTLEN(om) > mtu - 3) {
+        // NimBLE truncates to ATT_MTU-3; mirror that so callers see what a central would.
+        os_mbuf_adj(om, -(OS_MBUF_PKTLEN(om) - (mtu - 3)));
+    }
+    if (rc == 0) {
+        ++g_notifications_sent;
+        if (g_notification_listener) {
+            uint8_t payload[BLE_ATT_MTU_MAX];
+            uint16_t len = OS_MBUF_PKTLEN(om);
+            os_mbuf_copydata(om, 0, len, payload);
+            g_notification_listener(conn_handle, attr_handle, payload, len, indication,
+                                    g_notification_listener_arg);
+        }
+    }
+    // The stack consumes the mbuf whether or not the send succeeds.
+    os_mbuf_free_chain(om);
+    return rc;
+}
+
+int ble_gatts_notify_custom(uint16_t conn_handle, uint16_t att_handle, os_mbuf* om) {
+    return send_value(conn_handle, att_handle, om, false);
+}
+
+int ble_gatts_indicate_custom(uint16_t conn_handle, uint16_t chr_val_handle, os_mbuf* txom) {
+    return send_value(conn_handle, chr_val_handle, txom, true);
+}
+
+uint16_t ble_att_mtu(uint16_t conn_handle) {
+    return conn_mtu(conn_handle);
+}
+
+} // extern "C"
+
+namespace HostSim {
+
+void reset_conn_mgr();
+void reset_event_queue();
+void reset_l2cap();
+void reset_gap();
+void disconnect_l2cap(uint16_t conn_handle);
+
+void reset() {
+    ble_gatts_reset();
+    for (auto& conn : g_conns) {
+        clear_prep_queue(conn);
+        conn = {};
+    }
+    g_cccd_count = 0;
+    g_gap_listener = nullptr;
+    g_gap_listener_arg = nullptr;
+    g_notification_listener = nullptr;
+    g_notification_listener_arg = nullptr;
+    g_notifications_sent = 0;
+    g_notifications_to_fail = 0;
+    reset_conn_mgr();
+    reset_event_queue();
+    reset_l2cap();
+    reset_gap();
+}
+
+int start() {
+    return ble_gatts_start();
+}
+
+size_t attribute_count() {
+    return g_attr_count;
+}
+
+uint16_t find_value_handle(const ble_uuid_t* chr_uuid) {
+    for (size_t i = 0; i < g_attr_count; ++i) {
+        if (g_attrs[i].kind == AttrKind::ChrValue && ble_uuid_cmp(g_attrs[i].chr->uuid, chr_uuid) == 0) {
+            return static_cast<uint16_t>(i + 1);
+        }
+    }
+    return 0;
+}
+
+uint16_t find_descriptor_handle(uint16_t value_handle, const ble_uuid_t* dsc_uuid) {
+    const Attribute* value = attribute(value_handle);
+    if (!value || value->kind != AttrKind::ChrValue) {
+        return 0;
+    }
+    for (size_t i = value_handle; i < g_attr_count; ++i) {
+        const Attribute& attr = g_attrs[i];
+        if (attr.chr != value->chr || attr.kind == AttrKind::ChrDecl) {
+            break;
+        }
+        if (attr.kind == AttrKind::Cccd && ble_uuid_cmp(&cccd_uuid.u, dsc_uuid) == 0) {
+            return static_cast<uint16_t>(i + 1);
+        }
+        if (attr.kind == AttrKind::Descriptor && ble_uuid_cmp(attr.dsc->uuid, dsc_uuid) == 0) {
+            return static_cast<uint16_t>(i + 1);
+        }
+    }
+    return 0;
+}
+
+uint16_t connect(uint16_t mtu) {
+    for (uint16_t i = 0; i < HOST_SIM_MAX_CONNECTIONS; ++i) {
+        if (g_conns[i].in_use) {
+            continue;
+        }
+        g_conns[i].in_use = true;
+        g_conns[i].mtu = mtu;
+        ble_gap_event event = {};
+        event.type = BLE_GAP_EVENT_CONNECT;
+        event.connect.status = 0;
+        event.connect.conn_handle = i;
+        emit_gap_event(event);
+        if (mtu != BLE_ATT_MTU_DFLT) {
+            event = {};
+            event.type = BLE_GAP_EVENT_MTU;
+            event.mtu.conn_handle = i;
+            event.mtu.value = mtu;
+            emit_gap_event(event);
+        }
+        return i;
+    }
+    return BLE_HS_CONN_HANDLE_NONE;
+}
+
+void disconnect(uint16_t conn_handle) {
+    if (conn_mtu(conn_handle) == 0) {
+        return;
+    }
+    // L2CAP channels go down with the link, before the GAP event.
+    disconnect_l2cap(conn_handle);
+    clear_prep_queue(g_conns[conn_handle]);
+    g_conns[conn_handle] = {};
+    size_t kept = 0;
+    for (size_t i = 0; i < g_cccd_count; ++i) {
+        if (g_cccds[i].conn_handle != conn_handle) {
+            g_cccds[kept++] = g_cccds[i];
+        }
+    }
+    g_cccd_count = kept;
+    ble_gap_event event = {};
+    event.type = BLE_GAP_EVENT_DISCONNECT;
+    event.disconnect.reason = 0x13; // remote user terminated connection
+    event.disconnect.conn.conn_handle = conn_handle;
+    emit_gap_event(event);
+}
+
+void set_gap_listener(ble_gap_event_fn* fn, void* arg) {
+    g_gap_listener = fn;
+    g_gap_listener_arg = arg;
+}
+
+int subscribe(uint16_t conn_handle, uint16_t value_handle, bool notify, bool indicate) {
+    if (conn_mtu(conn_handle) == 0) {
+        return BLE_HS_ENOTCONN;
+    }
+    const Attribute* attr = attribute(value_handle);
+    if (!attr || attr->kind != AttrKind::ChrValue) {
+        return BLE_ATT_ERR_INVALID_HANDLE;
+    }
+    if ((notify && !(attr->chr->flags & BLE_GATT_CHR_F_NOTIFY)) ||
+        (indicate && !(attr->chr->flags & BLE_GATT_CHR_F_INDICATE))) {
+        return BLE_ATT_ERR_REQ_NOT_SUPPORTED;
+    }
+    CccdState* state = find_cccd(conn_handle, value_handle);
+    if (!state) {
+        if (g_cccd_count >= HOST_SIM_MAX_CCCDS) {
+            return BLE_ATT_ERR_INSUFFICIENT_RES;
+        }
+        state = &g_cccds[g_cccd_count++];
+        *state = {conn_handle, value_handle, false, false};
+    }
+    ble_gap_event event = {};
+    event.type = BLE_GAP_EVENT_SUBSCRIBE;
+    event.subscribe.conn_handle = conn_handle;
+    event.subscribe.attr_handle = value_handle;
+    event.subscribe.reason = BLE_GAP_SUBSCRIBE_REASON_WRITE;
+    event.subscribe.prev_notify = state->notify;
+    event.subscribe.prev_indicate = state->indicate;
+    event.subscribe.cur_notify = notify;
+    event.subscribe.cur_indicate = indicate;
+    state->notify = notify;
+    state->indicate = indicate;
+    emit_gap_event(event);
+    return 0;
+}
+
+void set_notification_listener(NotificationListener fn, void* arg) {
+    g_notification_listener = fn;
+    g_notification_listener_arg = arg;
+}
+
+size_t notifications_sent() {
+    return g_notifications_sent;
+}
+
+void fail_notifications(size_t count) {
+    g_notifications_to_fail = count;
+}
+
+// Produce the whole value of a readable attribute into a fresh mbuf, like
+// ble_gatts_val_access() does before the ATT server slices or packs it.
+static int read_attribute(uint16_t conn_handle, uint16_t attr_handle, os_mbuf** value) {
+    *value = nullptr;
+    const Attribute* attr = attribute(attr_handle);
+    if (!attr) {
+        return BLE_ATT_ERR_INVALID_HANDLE;
+    }
+    os_mbuf* om = os_msys_get_pkthdr(0, 0);
+    if (!om) {
+        return BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+
+    if (attr->kind == AttrKind::Cccd) {
+        // The CCCD lives in the stack; report this connection's subscription bits.
+        const CccdState* state = find_cccd(conn_handle, attr_handle - 1);
+        uint8_t bits[2] = {0, 0};
+        if (state) {
+            bits[0] = (state->notify ? 0x01 : 0) | (state->indicate ? 0x02 : 0);
+        }
+        os_mbuf_append(om, bits, sizeof(bits));
+        *value = om;
+        return 0;
+    }
+
+    ble_gatt_access_ctxt ctxt = {};
+    ble_gatt_access_fn* access_cb = nullptr;
+    void* arg = nullptr;
+    int rc = 0;
+    switch (attr->kind) {
+        case AttrKind::ChrValue:
+            if (!(attr->chr->flags & BLE_GATT_CHR_F_READ)) {
+                rc = BLE_ATT_ERR_READ_NOT_PERMITTED;
+                break;
+            }
+            ctxt.op = BLE_GATT_ACCESS_OP_READ_CHR;
+            ctxt.chr = attr->chr;
+            access_cb = attr->chr->access_cb;
+            arg = attr->chr->arg;
+            break;
+        case AttrKind::Descriptor:
+            if (!(attr->dsc->att_flags & BLE_ATT_F_READ)) {
+                rc = BLE_ATT_ERR_READ_NOT_PERMITTED;
+                break;
+            }
+            ctxt.op = BLE_GATT_ACCESS_OP_READ_DSC;
+            ctxt.dsc = attr->dsc;
+            access_cb = attr->dsc->access_cb;
+            arg = attr->dsc->arg;
+            break;
+        default:
+            rc = BLE_ATT_ERR_READ_NOT_PERMITTED;
+            break;
+    }
+    if (rc == 0) {
+        ctxt.om = om;
+        rc = access_cb(conn_handle, attr_handle, &ctxt, arg);
+    }
+    if (rc != 0) {
+        os_mbuf_free_chain(om);
+        return rc;
+    }
+    *value = om;
+    return 0;
+}
+
+int read(uint16_t conn_handle, uint16_t attr_handle,
+         uint8_t* out, size_t out_capacity, size_t* out_len, uint16_t offset) {
+    if (out_len) {
+        *out_len = 0;
+    }
+    uint16_t mtu = conn_mtu(conn_handle);
+    if (mtu == 0) {
+        return BLE_HS_ENOTCONN;
+    }
+    os_mbuf* value = nullptr;
+    int rc = read_attribute(conn_handle, attr_handle, &value);
+    if (rc != 0) {
+        return rc;
+    }
+    uint16_t len = OS_MBUF_PKTLEN(value);
+    if (offset > len) {
+        rc = BLE_ATT_ERR_INVALID_OFFSET;
+    } else {
+        size_t chunk = len - offset;
+        if (chunk > static_cast<size_t>(mtu - 1)) {
+            chunk = mtu - 1;
+        }
+        if (chunk > out_capacity) {
+            chunk = out_capacity;
+        }
+        os_mbuf_copydata(value, offset, static_cast<int>(chunk), out);
+        if (out_len) {
+            *out_len = chunk;
+        }
+    }
+    os_mbuf_free_chain(value);
+    return rc;
+}
+
+int read_multiple(uint16_t conn_handle, const uint16_t* attr_handles, size_t count, bool variable,
+                  uint8_t* out, size_t out_capacity, size_t* out_len) {
+    if (out_len) {
+        *out_len = 0;
+    }
+    uint16_t mtu = conn_mtu(conn_handle);
+    if (mtu == 0) {
+        return BLE_HS_ENOTCONN;
+    }
+    if (count < 2) {
+        return BLE_ATT_ERR_INVALID_PDU;
+    }
+    // The response carries at most ATT_MTU - 1 bytes; whatever does not fit is cut off.
+    size_t limit = static_cast<size_t>(mtu - 1) < out_capacity ? static_cast<size_t>(mtu - 1) : out_capacity;
+    size_t used = 0;
+    for (size_t i = 0; i < count; ++i) {
+        os_mbuf* value = nullptr;
+        int rc = read_attribute(conn_handle, attr_handles[i], &value);
+        if (rc != 0) {
+            return rc;
+        }
+        size_t len = OS_MBUF_PKTLEN(value);
+        if (variable) {
+            // Read Multiple Variable: each value is preceded by its full length.
+            uint8_t prefix[2] = {static_cast<uint8_t>(len), static_cast<uint8_t>(len >> 8)};
+            for (size_t b = 0; b < sizeof(prefix) && used < limit; ++b) {
+                out[used++] = prefix[b];
+            }
+        }
+        size_t chunk = len < limit - used ? len : limit - used;
+        os_mbuf_copydata(value, 0, static_cast<int>(chunk), out + used);
+        used += chunk;
+        os_mbuf_free_chain(value);
+    }
+    if (out_len) {
+        *out_len = used;
+    }
+    return 0;
+}
+
+static int write_value(uint16_t conn_handle, uint16_t attr_handle, const void* data, size_t len, uint16_t required_flag) {
+    uint16_t mtu = conn_mtu(conn_handle);
+    if (mtu == 0) {
+        return BLE_HS_ENOTCONN;
+    }
+    const Attribute* attr = attribute(attr_handle);
+    if (!attr) {
+        return BLE_ATT_ERR_INVALID_HANDLE;
+    }
+    if (attr->kind != AttrKind::ChrValue || !(attr->chr->flags & required_flag)) {
+        return BLE_ATT_ERR_WRITE_NOT_PERMITTED;
+    }
+    if (len > static_cast<size_t>(mtu - 3)) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+
+    ble_gatt_access_ctxt ctxt = {};
+    ctxt.op = BLE_GATT_ACCESS_OP_WRITE_CHR;
+    ctxt.chr = attr->chr;
+    ctxt.om = ble_hs_mbuf_from_flat(data, static_cast<uint16_t>(len));
+    if (!ctxt.om) {
+        return BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+    int rc = attr->chr->access_cb(conn_handle, attr_handle, &ctxt, attr->chr->arg);
+    // As in NimBLE, the callback may take ownership by clearing ctxt.om.
+    os_mbuf_free_chain(ctxt.om);
+    return rc;
+}
+
+int write(uint16_t conn_handle, uint16_t attr_handle, const void* data, size_t len) {
+    return write_value(conn_handle, attr_handle, data, len, BLE_GATT_CHR_F_WRITE);
+}
+
+int write_no_response(uint16_t conn_handle, uint16_t attr_handle, const void* data, size_t len) {
+    return write_value(conn_handle, attr_handle, data, len, BLE_GATT_CHR_F_WRITE_NO_RSP);
+}
+
+int prepare_write(uint16_t conn_handle, uint16_t attr_handle, uint16_t offset, const void* data, size_t len) {
+    uint16_t mtu = conn_mtu(conn_handle);
+    if (mtu == 0) {
+        return BLE_HS_ENOTCONN;
+    }
+    const Attribute* attr = attribute(attr_handle);
+    if (!attr) {
+        return BLE_ATT_ERR_INVALID_HANDLE;
+    }
+    if (attr->kind != AttrKind::ChrValue || !(attr->chr->flags & BLE_GATT_CHR_F_WRITE)) {
+        return BLE_ATT_ERR_WRITE_NOT_PERMITTED;
+    }
+    if (len > static_cast<size_t>(mtu - 5)) {
+        return BLE_ATT_ERR_INVALID_PDU;
+    }
+    Connection& conn = g_conns[conn_handle];
+    if (conn.prep_count >= HOST_SIM_MAX_PREP_ENTRIES) {
+        return BLE_ATT_ERR_PREPARE_QUEUE_FULL;
+    }
+    os_mbuf* om = ble_hs_mbuf_from_flat(data, static_cast<uint16_t>(len));
+    if (!om) {
+        return BLE_ATT_ERR_PREPARE_QUEUE_FULL;
+    }
+    conn.prep[conn.prep_count++] = {attr_handle, offset, om};
+    return 0;
+}
+
+int execute_write(uint16_t conn_handle, bool commit) {
+    if (conn_mtu(conn_handle) == 0) {
+        return BLE_HS_ENOTCONN;
+    }
+    Connection& conn = g_conns[conn_handle];
+    if (!commit) {
+        clear_prep_queue(conn);
+        return 0;
+    }
+
+    // Validate like ble_att_svr_prep_validate(): per attribute, fragments must be
+    // contiguous from offset 0 and the value must fit BLE_ATT_ATTR_MAX_LEN.
+    for (size_t i = 0; i < conn.prep_count; ++i) {
+        bool first = true;
+        for (size_t k = 0; k < i && first; ++k) {
+            first = conn.prep[k].attr_handle != conn.prep[i].attr_handle;
+        }
+        if (!first) {
+            continue;
+        }
+        uint16_t expected = 0;
+        for (size_t j = i; j < conn.prep_count; ++j) {
+            if (conn.prep[j].attr_handle != conn.prep[i].attr_handle) {
+                continue;
+            }
+            if (conn.prep[j].offset != expected) {
+                clear_prep_queue(conn);
+                return BLE_ATT_ERR_INVALID_OFFSET;
+            }
+            expected += OS_MBUF_PKTLEN(conn.prep[j].om);
+            if (expected > BLE_ATT_ATTR_MAX_LEN) {
+                clear_prep_queue(conn);
+                return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+            }
+        }
+    }
+
+    // Hand each attribute its fragments as one mbuf chain, one access callback per attribute.
+    int result = 0;
+    for (size_t i = 0; i < conn.prep_count; ++i) {
+        if (!conn.prep[i].om) {
+            continue;
+        }
+        uint16_t attr_handle = conn.prep[i].attr_handle;
+        os_mbuf* chain = conn.prep[i].om;
+        conn.prep[i].om = nullptr;
+        for (size_t j = i + 1; j < conn.prep_count; ++j) {
+            if (conn.prep[j].om && conn.prep[j].attr_handle == attr_handle) {
+                os_mbuf_concat(chain, conn.prep[j].om);
+                conn.prep[j].om = nullptr;
+            }
+        }
+        const Attribute* attr = attribute(attr_handle);
+        ble_gatt_access_ctxt ctxt = {};
+        ctxt.op = BLE_GATT_ACCESS_OP_WRITE_CHR;
+        ctxt.chr = attr->chr;
+        ctxt.om = chain;
+        int rc = attr->chr->access_cb(conn_handle, attr_handle, &ctxt, attr->chr->arg);
+        os_mbuf_free_chain(ctxt.om);
+        if (rc != 0 && result == 0) {
+            result = rc;
+        }
+    }
+    conn.prep_count = 0;
+    return result;
+}
+
+} // namespace HostSim
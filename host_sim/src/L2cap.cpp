@@ -0,0 +1,284 @@
+#include "HostSim.hpp"
+#include "host/ble_hs.h"
+
+#ifndef HOST_SIM_MAX_L2CAP_SERVERS
+#define HOST_SIM_MAX_L2CAP_SERVERS 4
+#endif
+#ifndef HOST_SIM_MAX_L2CAP_CHANNELS
+#define HOST_SIM_MAX_L2CAP_CHANNELS 8
+#endif
+
+// Opaque in NimBLE; the stand-in keeps one per channel in a fixed table.
+struct ble_l2cap_chan {
+    bool in_use;
+    uint16_t conn_handle;
+    uint16_t psm;
+    uint16_t our_mtu;
+    uint16_t peer_mtu;
+    uint16_t peer_mps;
+    uint16_t peer_credits;  // K-frames the device may still send
+    os_mbuf* rx_sdu;        // receive buffer posted with ble_l2cap_recv_ready()
+    os_mbuf* tx_sdu;        // SDU waiting for credits
+    size_t tx_frames_left;
+    ble_l2cap_event_fn* cb;
+    void* cb_arg;
+};
+
+namespace {
+
+struct Server {
+    uint16_t psm;
+    uint16_t mtu;
+    ble_l2cap_event_fn* cb;
+    void* cb_arg;
+};
+
+Server g_servers[HOST_SIM_MAX_L2CAP_SERVERS];
+size_t g_server_count = 0;
+ble_l2cap_chan g_chans[HOST_SIM_MAX_L2CAP_CHANNELS];
+HostSim::L2capListener g_l2cap_listener = nullptr;
+void* g_l2cap_listener_arg = nullptr;
+
+ble_l2cap_chan* channel(int index) {
+    if (index < 0 || index >= HOST_SIM_MAX_L2CAP_CHANNELS || !g_chans[index].in_use) {
+        return nullptr;
+    }
+    return &g_chans[index];
+}
+
+int emit(ble_l2cap_chan* chan, ble_l2cap_event& event) {
+    return chan->cb(&event, chan->cb_arg);
+}
+
+void close_channel(ble_l2cap_chan* chan) {
+    ble_l2cap_event event = {};
+    event.type = BLE_L2CAP_EVENT_COC_DISCONNECTED;
+    event.disconnect.conn_handle = chan->conn_handle;
+    event.disconnect.chan = chan;
+    emit(chan, event);
+    os_mbuf_free_chain(chan->rx_sdu);
+    os_mbuf_free_chain(chan->tx_sdu);
+    *chan = {};
+}
+
+// Spend credits on the pending SDU; the peer sees it once its last K-frame is out.
+bool continue_tx(ble_l2cap_chan* chan) {
+    size_t frames = chan->tx_frames_left < chan->peer_credits ? chan->tx_frames_left : chan->peer_credits;
+    chan->tx_frames_left -= frames;
+    chan->peer_credits = static_cast<uint16_t>(chan->peer_credits - frames);
+    if (chan->tx_frames_left > 0) {
+        return false;
+    }
+    if (g_l2cap_listener) {
+        static uint8_t sdu[UINT16_MAX];
+        uint16_t len = OS_MBUF_PKTLEN(chan->tx_sdu);
+        os_mbuf_copydata(chan->tx_sdu, 0, len, sdu);
+        g_l2cap_listener(static_cast<int>(chan - g_chans), sdu, len, g_l2cap_listener_arg);
+    }
+    os_mbuf_free_chain(chan->tx_sdu);
+    chan->tx_sdu = nullptr;
+    return true;
+}
+
+} // namespace
+
+extern "C" {
+
+int ble_l2cap_create_server(uint16_t psm, uint16_t mtu, ble_l2cap_event_fn* cb, void* cb_arg) {
+    if (!cb || psm == 0) {
+        return BLE_HS_EINVAL;
+    }
+    for (size_t i = 0; i < g_server_count; ++i) {
+        if (g_servers[i].psm == psm) {
+            return BLE_HS_EALREADY;
+        }
+    }
+    if (g_server_count >= HOST_SIM_MAX_L2CAP_SERVERS) {
+        return BLE_HS_ENOMEM;
+    }
+    g_servers[g_server_count++] = {psm, mtu, cb, cb_arg};
+    return 0;
+}
+
+int ble_l2cap_disconnect(ble_l2cap_chan* chan) {
+    if (!chan || !chan->in_use) {
+        return BLE_HS_ENOTCONN;
+    }
+    close_channel(chan);
+    return 0;
+}
+
+int ble_l2cap_send(ble_l2cap_chan* chan, os_mbuf* sdu_tx) {
+    if (!chan || !chan->in_use) {
+        return BLE_HS_ENOTCONN;
+    }
+    if (chan->tx_sdu) {
+        return BLE_HS_EBUSY;
+    }
+    uint16_t len = OS_MBUF_PKTLEN(sdu_tx);
+    if (len > chan->peer_mtu) {
+        return BLE_HS_EBADDATA;
+    }
+    // The first K-frame carries the 2-byte SDU length.
+    chan->tx_sdu = sdu_tx;
+    chan->tx_frames_left = (len + 2u + chan->peer_mps - 1) / chan->peer_mps;
+    return continue_tx(chan) ? 0 : BLE_HS_ESTALLED;
+}
+
+int ble_l2cap_recv_ready(ble_l2cap_chan* chan, os_mbuf* sdu_rx) {
+    if (!chan || !chan->in_use) {
+        return BLE_HS_ENOTCONN;
+    }
+    if (!sdu_rx) {
+        return BLE_HS_EINVAL;
+    }
+    if (chan->rx_sdu) {
+        return BLE_HS_EALREADY;
+    }
+    chan->rx_sdu = sdu_rx;
+    return 0;
+}
+
+int ble_l2cap_get_chan_info(ble_l2cap_chan* chan, ble_l2cap_chan_info* chan_info) {
+    if (!chan || !chan->in_use || !chan_info) {
+        return BLE_HS_EINVAL;
+    }
+    uint16_t cid = static_cast<uint16_t>(0x40 + (chan - g_chans));
+    *chan_info = {cid, cid, chan->our_mtu, chan->peer_mps, chan->psm, chan->our_mtu, chan->peer_mtu};
+    return 0;
+}
+
+} // extern "C"
+
+namespace HostSim {
+
+void reset_l2cap() {
+    for (auto& chan : g_chans) {
+        os_mbuf_free_chain(chan.rx_sdu);
+        os_mbuf_free_chain(chan.tx_sdu);
+        chan = {};
+    }
+    g_server_count = 0;
+    g_l2cap_listener = nullptr;
+    g_l2cap_listener_arg = nullptr;
+}
+
+void disconnect_l2cap(uint16_t conn_handle) {
+    for (auto& chan : g_chans) {
+        if (chan.in_use && chan.conn_handle == conn_handle) {
+            close_channel(&chan);
+        }
+    }
+}
+
+int l2cap_connect(uint16_t conn_handle, uint16_t psm, uint16_t peer_mtu, uint16_t peer_mps, uint16_t credits) {
+    if (ble_att_mtu(conn_handle) == 0) {
+        return -BLE_HS_ENOTCONN;
+    }
+    if (peer_mps == 0) {
+        return -BLE_HS_EINVAL;
+    }
+    const Server* server = nullptr;
+    for (size_t i = 0; i < g_server_count && !server; ++i) {
+        if (g_servers[i].psm == psm) {
+            server = &g_servers[i];
+        }
+    }
+    if (!server) {
+        return -BLE_HS_ENOENT;
+    }
+    int index = 0;
+    while (index < HOST_SIM_MAX_L2CAP_CHANNELS && g_chans[index].in_use) {
+        ++index;
+    }
+    if (index == HOST_SIM_MAX_L2CAP_CHANNELS) {
+        return -BLE_HS_ENOMEM;
+    }
+    ble_l2cap_chan* chan = &g_chans[index];
+    *chan = {true, conn_handle, psm, server->mtu, peer_mtu, peer_mps, credits,
+             nullptr, nullptr, 0, server->cb, server->cb_arg};
+
+    ble_l2cap_event event = {};
+    event.type = BLE_L2CAP_EVENT_COC_ACCEPT;
+    event.accept.conn_handle = conn_handle;
+    event.accept.peer_sdu_size = peer_mtu;
+    event.accept.chan = chan;
+    if (emit(chan, event) != 0 || !chan->rx_sdu) {
+        // Like NimBLE: refused, or no receive buffer to grant the peer credits with.
+        os_mbuf_free_chain(chan->rx_sdu);
+        *chan = {};
+        return -BLE_HS_EREJECT;
+    }
+    event = {};
+    event.type = BLE_L2CAP_EVENT_COC_CONNECTED;
+    event.connect.status = 0;
+    event.connect.conn_handle = conn_handle;
+    event.connect.chan = chan;
+    emit(chan, event);
+    return index;
+}
+
+int l2cap_send(int index, const void* data, size_t len) {
+    ble_l2cap_chan* chan = channel(index);
+    if (!chan) {
+        return BLE_HS_ENOTCONN;
+    }
+    if (len > chan->our_mtu) {
+        return BLE_HS_EBADDATA;
+    }
+    if (!chan->rx_sdu) {
+        return BLE_HS_ESTALLED;
+    }
+    if (os_mbuf_append(chan->rx_sdu, data, static_cast<uint16_t>(len)) != 0) {
+        os_mbuf_adj(chan->rx_sdu, -static_cast<int>(OS_MBUF_PKTLEN(chan->rx_sdu)));
+        return BLE_HS_ENOMEM;
+    }
+    // The SDU now belongs to the application, which posts the next receive buffer.
+    ble_l2cap_event event = {};
+    event.type = BLE_L2CAP_EVENT_COC_DATA_RECEIVED;
+    event.receive.conn_handle = chan->conn_handle;
+    event.receive.chan = chan;
+    event.receive.sdu_rx = chan->rx_sdu;
+    chan->rx_sdu = nullptr;
+    emit(chan, event);
+    return 0;
+}
+
+int l2cap_give_credits(int index, uint16_t credits) {
+    ble_l2cap_chan* chan = channel(index);
+    if (!chan) {
+        return BLE_HS_ENOTCONN;
+    }
+    uint32_t total = static_cast<uint32_t>(chan->peer_credits) + credits;
+    chan->peer_credits = static_cast<uint16_t>(total > UINT16_MAX ? UINT16_MAX : total);
+    if (chan->tx_sdu && continue_tx(chan)) {
+        ble_l2cap_event event = {};
+        event.type = BLE_L2CAP_EVENT_COC_TX_UNSTALLED;
+        event.tx_unstalled.conn_handle = chan->conn_handle;
+        event.tx_unstalled.chan = chan;
+        event.tx_unstalled.status = 0;
+        emit(chan, event);
+    }
+    return 0;
+}
+
+int l2cap_disconnect(int index) {
+    ble_l2cap_chan* chan = channel(index);
+    if (!chan) {
+        return BLE_HS_ENOTCONN;
+    }
+    close_channel(chan);
+    return 0;
+}
+
+uint16_t l2cap_peer_credits(int index) {
+    ble_l2cap_chan* chan = channel(index);
+    return chan ? chan->peer_credits : 0;
+}
+
+void set_l2cap_listener(L2capListener fn, void* arg) {
+    g_l2cap_listener = fn;
+    g_l2cap_listener_arg = arg;
+}
+
+} // namespace HostSim
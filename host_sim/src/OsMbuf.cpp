@@ -0,0 +1,281 @@
+#include "os/os_mbuf.h"
+#include "host/ble_hs.h"
+#include "HostSim.hpp"
+#include <cstring>
+
+namespace {
+
+os_mbuf g_pool[OS_MBUF_SIM_POOL_COUNT];
+os_mbuf* g_free_list = nullptr;
+size_t g_in_use = 0;
+bool g_initialized = false;
+
+void pool_init() {
+    if (g_initialized) {
+        return;
+    }
+    for (size_t i = 0; i < OS_MBUF_SIM_POOL_COUNT; ++i) {
+        SLIST_NEXT(&g_pool[i], om_next) = g_free_list;
+        g_free_list = &g_pool[i];
+    }
+    g_initialized = true;
+}
+
+os_mbuf* pool_get() {
+    pool_init();
+    os_mbuf* om = g_free_list;
+    if (!om) {
+        return nullptr;
+    }
+    g_free_list = SLIST_NEXT(om, om_next);
+    ++g_in_use;
+    om->om_data = om->om_databuf;
+    om->om_flags = 0;
+    om->om_pkthdr_len = 0;
+    om->om_len = 0;
+    om->om_omp = g_pool;
+    SLIST_NEXT(om, om_next) = nullptr;
+    om->om_pkthdr.omp_len = 0;
+    om->om_pkthdr.omp_flags = 0;
+    return om;
+}
+
+os_mbuf* last_segment(os_mbuf* om) {
+    while (SLIST_NEXT(om, om_next)) {
+        om = SLIST_NEXT(om, om_next);
+    }
+    return om;
+}
+
+} // namespace
+
+extern "C" {
+
+os_mbuf* os_msys_get_pkthdr(uint16_t /*dsize*/, uint16_t /*user_hdr_len*/) {
+    os_mbuf* om = pool_get();
+    if (om) {
+        om->om_pkthdr_len = sizeof(os_mbuf_pkthdr);
+    }
+    return om;
+}
+
+os_mbuf* os_msys_get(uint16_t /*dsize*/, uint16_t leadingspace) {
+    os_mbuf* om = pool_get();
+    if (om && leadingspace < OS_MBUF_SIM_BLOCK_SIZE) {
+        om->om_data += leadingspace;
+    }
+    return om;
+}
+
+int os_mbuf_append(os_mbuf* om, const void* data, uint16_t len) {
+    if (!om) {
+        return OS_EINVAL;
+    }
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    os_mbuf* last = last_segment(om);
+    uint16_t remaining = len;
+    while (remaining > 0) {
+        uint16_t space = OS_MBUF_TRAILINGSPACE(last);
+        if (space == 0) {
+            os_mbuf* next = pool_get();
+            if (!next) {
+                return OS_ENOMEM;
+            }
+            SLIST_NEXT(last, om_next) = next;
+            last = next;
+            continue;
+        }
+        uint16_t chunk = remaining < space ? remaining : space;
+        std::memcpy(last->om_data + last->om_len, src, chunk);
+        last->om_len += chunk;
+        om->om_pkthdr.omp_len += chunk;
+        src += chunk;
+        remaining -= chunk;
+    }
+    return 0;
+}
+
+int os_mbuf_copydata(const os_mbuf* m, int off, int len, void* dst) {
+    uint8_t* out = static_cast<uint8_t*>(dst);
+    while (m && off >= m->om_len) {
+        off -= m->om_len;
+        m = SLIST_NEXT(m, om_next);
+    }
+    while (len > 0 && m) {
+        int chunk = m->om_len - off;
+        if (chunk > len) {
+            chunk = len;
+        }
+        std::memcpy(out, m->om_data + off, chunk);
+        out += chunk;
+        len -= chunk;
+        off = 0;
+        m = SLIST_NEXT(m, om_next);
+    }
+    return len > 0 ? -1 : 0;
+}
+
+int os_mbuf_appendfrom(os_mbuf* dst, const os_mbuf* src, uint16_t src_off, uint16_t len) {
+    while (src && src_off >= src->om_len) {
+        src_off -= src->om_len;
+        src = SLIST_NEXT(src, om_next);
+    }
+    while (len > 0 && src) {
+        uint16_t chunk = src->om_len - src_off;
+        if (chunk > len) {
+            chunk = len;
+        }
+        int rc = os_mbuf_append(dst, src->om_data + src_off, chunk);
+        if (rc != 0) {
+            return rc;
+        }
+        len -= chunk;
+        src_off = 0;
+        src = SLIST_NEXT(src, om_next);
+    }
+    return len > 0 ? OS_EINVAL : 0;
+}
+
+int os_mbuf_copyinto(os_mbuf* om, int off, const void* src, int len) {
+    const uint8_t* in = static_cast<const uint8_t*>(src);
+    os_mbuf* head = om;
+    int pkt_len = head->om_pkthdr.omp_len;
+    os_mbuf* m = om;
+    int seg_off = off;
+    while (m && seg_off >= m->om_len && SLIST_NEXT(m, om_next)) {
+        seg_off -= m->om_len;
+        m = SLIST_NEXT(m, om_next);
+    }
+    while (len > 0 && m && seg_off < m->om_len) {
+        int chunk = m->om_len - seg_off;
+        if (chunk > len) {
+            chunk = len;
+        }
+        std::memcpy(m->om_data + seg_off, in, chunk);
+        in += chunk;
+        len -= chunk;
+        off += chunk;
+        seg_off = 0;
+        m = SLIST_NEXT(m, om_next);
+    }
+    if (len > 0) {
+        if (off != pkt_len) {
+            return OS_EINVAL;
+        }
+        return os_mbuf_append(head, in, static_cast<uint16_t>(len));
+    }
+    return 0;
+}
+
+void* os_mbuf_extend(os_mbuf* om, uint16_t len) {
+    os_mbuf* last = last_segment(om);
+    if (OS_MBUF_TRAILINGSPACE(last) < len) {
+        os_mbuf* next = pool_get();
+        if (!next || len > OS_MBUF_SIM_BLOCK_SIZE) {
+            if (next) {
+                os_mbuf_free(next);
+            }
+            return nullptr;
+        }
+        SLIST_NEXT(last, om_next) = next;
+        last = next;
+    }
+    void* data = last->om_data + last->om_len;
+    last->om_len += len;
+    om->om_pkthdr.omp_len += len;
+    return data;
+}
+
+void os_mbuf_adj(os_mbuf* mp, int req_len) {
+    if (!mp || req_len == 0) {
+        return;
+    }
+    os_mbuf* head = mp;
+    if (req_len > 0) {
+        int len = req_len;
+        for (os_mbuf* m = mp; m && len > 0; m = SLIST_NEXT(m, om_next)) {
+            int chunk = m->om_len < len ? m->om_len : len;
+            m->om_len -= chunk;
+            m->om_data += chunk;
+            len -= chunk;
+        }
+        head->om_pkthdr.omp_len -= (req_len - len);
+    } else {
+        int len = -req_len;
+        int keep = head->om_pkthdr.omp_len - len;
+        if (keep < 0) {
+            keep = 0;
+        }
+        head->om_pkthdr.omp_len = keep;
+        for (os_mbuf* m = mp; m; m = SLIST_NEXT(m, om_next)) {
+            if (m->om_len >= keep) {
+                m->om_len = keep;
+                keep = 0;
+            } else {
+                keep -= m->om_len;
+            }
+        }
+    }
+}
+
+os_mbuf* os_mbuf_concat(os_mbuf* first, os_mbuf* second) {
+    os_mbuf* last = last_segment(first);
+    SLIST_NEXT(last, om_next) = second;
+    uint16_t added = 0;
+    for (os_mbuf* m = second; m; m = SLIST_NEXT(m, om_next)) {
+        added += m->om_len;
+    }
+    first->om_pkthdr.omp_len += added;
+    return first;
+}
+
+int os_mbuf_free(os_mbuf* mb) {
+    if (!mb) {
+        return OS_EINVAL;
+    }
+    SLIST_NEXT(mb, om_next) = g_free_list;
+    g_free_list = mb;
+    --g_in_use;
+    return 0;
+}
+
+int os_mbuf_free_chain(os_mbuf* om) {
+    while (om) {
+        os_mbuf* next = SLIST_NEXT(om, om_next);
+        os_mbuf_free(om);
+        om = next;
+    }
+    return 0;
+}
+
+int ble_hs_mbuf_to_flat(const os_mbuf* om, void* flat, uint16_t max_len, uint16_t* out_copy_len) {
+    uint16_t len = OS_MBUF_PKTLEN(om);
+    uint16_t copy_len = len < max_len ? len : max_len;
+    os_mbuf_copydata(om, 0, copy_len, flat);
+    if (out_copy_len) {
+        *out_copy_len = copy_len;
+    }
+    return copy_len < len ? BLE_HS_EMSGSIZE : 0;
+}
+
+os_mbuf* ble_hs_mbuf_from_flat(const void* buf, uint16_t len) {
+    os_mbuf* om = os_msys_get_pkthdr(len, 0);
+    if (!om) {
+        return nullptr;
+    }
+    if (os_mbuf_append(om, buf, len) != 0) {
+        os_mbuf_free_chain(om);
+        return nullptr;
+    }
+    return om;
+}
+
+} // extern "C"
+
+namespace HostSim {
+
+size_t mbufs_in_use() {
+    return g_in_use;
+}
+
+} // namespace HostSim
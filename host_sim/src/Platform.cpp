@@ -0,0 +1,133 @@
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "HostSim.hpp"
+#include "host/ble_uuid.h"
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+extern "C" {
+#include "nimble/nimble_port_freertos.h"
+}
+
+namespace {
+
+esp_log_level_t g_log_level = ESP_LOG_INFO;
+
+struct npl_funcs_stub {
+    int unused;
+};
+npl_funcs_stub g_npl_funcs;
+bool g_npl_ready = false;
+
+const auto g_time_origin = std::chrono::steady_clock::now();
+int64_t g_time_offset_us = 0;
+
+} // namespace
+
+extern "C" {
+
+void esp_log_level_set(const char* /*tag*/, esp_log_level_t level) {
+    g_log_level = level;
+}
+
+esp_log_level_t esp_log_level_get_sim(void) {
+    return g_log_level;
+}
+
+void esp_log_write(esp_log_level_t /*level*/, const char* /*tag*/, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+int64_t esp_timer_get_time(void) {
+    auto elapsed = std::chrono::steady_clock::now() - g_time_origin;
+    return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() + g_time_offset_us;
+}
+
+const char* esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+        default: return "UNKNOWN ERROR";
+    }
+}
+
+npl_funcs_t* npl_freertos_funcs_get(void) {
+    return g_npl_ready ? reinterpret_cast<npl_funcs_t*>(&g_npl_funcs) : nullptr;
+}
+
+void npl_freertos_funcs_init(void) {
+    g_npl_ready = true;
+}
+
+int npl_freertos_mempool_init(void) {
+    return 0;
+}
+
+int ble_uuid_cmp(const ble_uuid_t* uuid1, const ble_uuid_t* uuid2) {
+    if (uuid1->type != uuid2->type) {
+        return uuid1->type - uuid2->type;
+    }
+    switch (uuid1->type) {
+        case BLE_UUID_TYPE_16:
+            return (int)reinterpret_cast<const ble_uuid16_t*>(uuid1)->value -
+                   (int)reinterpret_cast<const ble_uuid16_t*>(uuid2)->value;
+        case BLE_UUID_TYPE_32:
+            return (int)(reinterpret_cast<const ble_uuid32_t*>(uuid1)->value -
+                         reinterpret_cast<const ble_uuid32_t*>(uuid2)->value);
+        case BLE_UUID_TYPE_128:
+            return std::memcmp(reinterpret_cast<const ble_uuid128_t*>(uuid1)->value,
+                               reinterpret_cast<const ble_uuid128_t*>(uuid2)->value, 16);
+        default:
+            return -1;
+    }
+}
+
+uint8_t ble_uuid_length(const ble_uuid_t* uuid) {
+    return uuid->type >> 3;
+}
+
+char* ble_uuid_to_str(const ble_uuid_t* uuid, char* dst) {
+    switch (uuid->type) {
+        case BLE_UUID_TYPE_16:
+            snprintf(dst, BLE_UUID_STR_LEN, "0x%04x", reinterpret_cast<const ble_uuid16_t*>(uuid)->value);
+            break;
+        case BLE_UUID_TYPE_32:
+            snprintf(dst, BLE_UUID_STR_LEN, "0x%08x", (unsigned)reinterpret_cast<const ble_uuid32_t*>(uuid)->value);
+            break;
+        case BLE_UUID_TYPE_128: {
+            const uint8_t* u8p = reinterpret_cast<const ble_uuid128_t*>(uuid)->value;
+            snprintf(dst, BLE_UUID_STR_LEN,
+                     "%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+                     u8p[15], u8p[14], u8p[13], u8p[12], u8p[11], u8p[10], u8p[9], u8p[8],
+                     u8p[7], u8p[6], u8p[5], u8p[4], u8p[3], u8p[2], u8p[1], u8p[0]);
+            break;
+        }
+        default:
+            dst[0] = '\0';
+            break;
+    }
+    return dst;
+}
+
+} // extern "C"
+
+namespace HostSim {
+
+void advance_time(int64_t us) {
+    g_time_offset_us += us;
+}
+
+} // namespace HostSim
@@ -0,0 +1,108 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <sdkconfig.h>
+#ifdef ESP_PLATFORM
+#include <esp_cpu.h>
+#else
+#include <chrono>
+#endif
+
+namespace CustomBLE {
+
+/**
+ * @brief Log-bucketed histogram of callback execution times.
+ *
+ * Bucket 0 counts durations below 256 ticks, bucket i (i > 0) durations in
+ * [2^(i+7), 2^(i+8)) ticks and the last bucket everything longer. A tick is
+ * one CPU cycle on the ESP32 and one nanosecond on the host.
+ */
+class LatencyHistogram {
+public:
+    static constexpr size_t bucket_count = 16;
+
+    void record(uint32_t ticks) {
+        ++buckets[bucket_for(ticks)];
+    }
+
+    static size_t bucket_for(uint32_t ticks) {
+        if (ticks < 256) {
+            return 0;
+        }
+        size_t bucket = 32 - __builtin_clz(ticks) - 8;
+        return bucket < bucket_count ? bucket : bucket_count - 1;
+    }
+
+    /**
+     * @brief Exclusive upper bound of a bucket in ticks (0 for the open-ended last bucket).
+     */
+    static uint32_t upper_bound(size_t bucket) {
+        return bucket + 1 < bucket_count ? (256u << bucket) : 0;
+    }
+
+    uint32_t count(size_t bucket) const { return buckets[bucket]; }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < bucket_count; ++i) {
+            buckets[i] += other.buckets[i];
+        }
+    }
+
+private:
+    uint32_t buckets[bucket_count] {};
+};
+
+/**
+ * @brief Access counters and latency histogram of one characteristic.
+ *
+ * Only compiled in with CONFIG_CUSTOMBLE_ACCESS_STATS. Updated from the
+ * NimBLE host task without locking; readers on other tasks may see a
+ * snapshot that is a few accesses apart between fields.
+ */
+struct AccessStats {
+    uint32_t reads {0};
+    uint32_t writes {0};
+    uint32_t bytes_in {0};  // bytes written by centrals
+    uint32_t bytes_out {0}; // bytes returned to centrals
+    uint32_t errors {0};    // accesses answered with an ATT error
+    LatencyHistogram latency;
+
+    void record(bool write, size_t bytes, int rc, uint32_t ticks) {
+        if (write) {
+            ++writes;
+            bytes_in += static_cast<uint32_t>(bytes);
+        } else {
+            ++reads;
+            bytes_out += static_cast<uint32_t>(bytes);
+        }
+        if (rc != 0) {
+            ++errors;
+        }
+        latency.record(ticks);
+    }
+
+    void merge(const AccessStats& other) {
+        reads += other.reads;
+        writes += other.writes;
+        bytes_in += other.bytes_in;
+        bytes_out += other.bytes_out;
+        errors += other.errors;
+        latency.merge(other.latency);
+    }
+
+    void reset() { *this = AccessStats(); }
+
+    /**
+     * @brief Current time in ticks (wraps); durations are differences of two calls.
+     */
+    static uint32_t now() {
+#ifdef ESP_PLATFORM
+        return static_cast<uint32_t>(esp_cpu_get_cycle_count());
+#else
+        return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+};
+
+} // namespace CustomBLE
@@ -0,0 +1,146 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <host/ble_hs.h>
+#include <host/ble_uuid.h>
+#include <sdkconfig.h>
+
+namespace CustomBLE {
+
+/**
+ * @brief Packs flags, service UUIDs, manufacturer data, TX power and name into advertising payloads.
+ *
+ * Elements are placed in a fixed priority order, each into the first packet
+ * with room for it (the advertising data, then the scan response):
+ *   1. flags (advertising data only)
+ *   2. service UUIDs, one at a time in the order they were added, so the
+ *      most important UUIDs are seen by passive scanners in the first packet
+ *   3. manufacturer data
+ *   4. TX power level
+ *   5. the complete name, or else the shortened name in the packet with the most room
+ * Anything that fits nowhere is dropped (see get_dropped_count()). A UUID
+ * list is marked complete only if it holds every added UUID of its size;
+ * otherwise the Incomplete List type tells centrals to discover the rest over GATT.
+ *
+ * Legacy advertising has 31 bytes of advertising data and 31 of scan
+ * response. Extended advertising has one larger payload (up to
+ * extended_max_size, limited by CONFIG_BT_NIMBLE_EXT_ADV_MAX_SIZE) and no scan
+ * response, since extended advertising cannot be connectable and scannable
+ * at once. The same input always gives the same bytes.
+ *
+ * UUIDs, the name and the manufacturer data are not copied; they must stay
+ * valid until build(). The payloads (about 300 bytes) live in the object.
+ */
+class AdvertisingBuilder {
+public:
+    enum class Mode : uint8_t {
+        Legacy,
+        Extended,
+    };
+
+#ifdef CONFIG_BT_NIMBLE_EXT_ADV
+    static constexpr Mode default_mode = Mode::Extended;
+#else
+    static constexpr Mode default_mode = Mode::Legacy;
+#endif
+    static constexpr size_t legacy_max_size = BLE_HS_ADV_MAX_SZ;
+    // One HCI LE Set Extended Advertising Data command, no fragmentation.
+#if defined(CONFIG_BT_NIMBLE_EXT_ADV_MAX_SIZE) && CONFIG_BT_NIMBLE_EXT_ADV_MAX_SIZE < 251
+    static constexpr size_t extended_max_size = CONFIG_BT_NIMBLE_EXT_ADV_MAX_SIZE;
+#else
+    static constexpr size_t extended_max_size = 251;
+#endif
+    static constexpr size_t max_uuids = 24;
+    static constexpr size_t min_short_name = 4;
+    static constexpr uint8_t default_flags = BLE_HS_ADV_F_DISC_GEN | BLE_HS_ADV_F_BREDR_UNSUP;
+
+    AdvertisingBuilder() = default;
+    AdvertisingBuilder(const AdvertisingBuilder&) = delete;
+    AdvertisingBuilder& operator=(const AdvertisingBuilder&) = delete;
+
+    /**
+     * @brief Flags element value (BLE_HS_ADV_F_*); 0 leaves the element out.
+     */
+    void set_flags(uint8_t value) { flags = value; }
+
+    /**
+     * @brief Device name (NUL-terminated, or the first length bytes).
+     * Shortened to no less than min_short_name characters when the complete name fits nowhere.
+     */
+    void set_name(const char* value);
+    void set_name(const char* value, size_t length) { name = value; name_length = value ? length : 0; }
+
+    void set_tx_power(int8_t dbm) { tx_power = dbm; has_tx_power = true; }
+
+    /**
+     * @brief Manufacturer specific data: company_id (little endian) followed by len bytes of data.
+     */
+    void set_manufacturer_data(uint16_t company_id, const uint8_t* data, size_t len);
+
+    /**
+     * @brief Add a 16-, 32- or 128-bit service UUID with lower priority than those added before.
+     * @return 0 (also for a UUID already added), BLE_HS_EINVAL for nullptr, BLE_HS_ENOMEM after max_uuids
+     */
+    int add_service_uuid(const ble_uuid_t* uuid);
+
+    /**
+     * @brief Forget all elements (the flags return to default_flags).
+     */
+    void clear();
+
+    /**
+     * @brief Lay out the payloads for mode.
+     */
+    void build(Mode mode = default_mode);
+
+    /**
+     * @brief Hand the payloads of the last build() to NimBLE.
+     *
+     * Without CONFIG_BT_NIMBLE_EXT_ADV: ble_gap_adv_set_data() and
+     * ble_gap_adv_rsp_set_data() (Mode::Extended is BLE_HS_ENOTSUP). With it:
+     * ble_gap_ext_adv_set_data() for instance, and ble_gap_ext_adv_rsp_set_data()
+     * if there is a scan response (configure the instance with legacy PDUs for Mode::Legacy).
+     * Call before starting to advertise.
+     * @return 0 on success, BLE_HS_* error code otherwise
+     */
+    int apply(uint8_t instance = 0) const;
+
+    const uint8_t* get_adv_data() const { return adv; }
+    size_t get_adv_length() const { return adv_length; }
+    const uint8_t* get_scan_response() const { return scan_response; }
+    size_t get_scan_response_length() const { return scan_response_length; }
+
+    /**
+     * @brief UUIDs (in priority order) that made it into the advertising data.
+     */
+    size_t get_adv_uuid_count() const { return adv_uuid_count; }
+    /**
+     * @brief Elements (UUIDs, manufacturer data, TX power, name) that fit in no packet.
+     */
+    size_t get_dropped_count() const { return dropped_count; }
+    bool is_name_shortened() const { return name_shortened; }
+
+private:
+    const ble_uuid_t* uuids[max_uuids] {};
+    size_t uuid_count {0};
+    uint8_t flags {default_flags};
+    const char* name {nullptr};
+    size_t name_length {0};
+    bool has_tx_power {false};
+    int8_t tx_power {0};
+    uint16_t company_id {0};
+    const uint8_t* manufacturer_data {nullptr};
+    size_t manufacturer_length {0};
+    bool has_manufacturer_data {false};
+
+    Mode mode {default_mode};
+    uint8_t adv[extended_max_size] {};
+    size_t adv_length {0};
+    uint8_t scan_response[legacy_max_size] {};
+    size_t scan_response_length {0};
+    size_t adv_uuid_count {0};
+    size_t dropped_count {0};
+    bool name_shortened {false};
+};
+
+} // namespace CustomBLE
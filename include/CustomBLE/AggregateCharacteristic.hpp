@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+#include "CustomBLE/Characteristic.hpp"
+
+namespace CustomBLE {
+
+/**
+ * @brief Read-only characteristic whose value is the values of other characteristics, packed.
+ *
+ * A dashboard that refreshes 25 small sensor values with 25 Read requests
+ * pays 25 ATT round trips; reading one aggregate costs one (plus Read Blobs
+ * for values longer than ATT_MTU - 1). Every member's value is appended as
+ * [length u16 LE][value], the layout of a Read Multiple Variable response, so
+ * a central can parse both the same way. Member values come from their read
+ * callbacks (through their read caches and compression, as for a GATT read)
+ * and are written straight into the response: no per-member copies.
+ *
+ * Members keep their own handles and stay readable on their own; they do not
+ * have to be in the same service. Keep the packed size within 512 bytes (the
+ * ATT attribute limit). notify() samples the members on the calling task:
+ * use schedule_notify() from other tasks. Create with create() and add the
+ * shared_ptr to a Service.
+ */
+class AggregateCharacteristic : public Characteristic {
+private:
+    struct Token {};
+
+public:
+    static constexpr size_t length_size = 2;
+
+    static std::shared_ptr<AggregateCharacteristic> create(const char* name, const ble_uuid128_t& uuid,
+                                                           std::initializer_list<std::shared_ptr<Characteristic>> members);
+
+    AggregateCharacteristic(Token, const char* name, const ble_uuid128_t& uuid,
+                            std::initializer_list<std::shared_ptr<Characteristic>> members);
+    AggregateCharacteristic(const AggregateCharacteristic&) = delete;
+    AggregateCharacteristic& operator=(const AggregateCharacteristic&) = delete;
+
+    size_t member_count() const { return members.size(); }
+    const Characteristic& member(size_t index) const { return *members[index]; }
+
+private:
+    int write_members(ValueWriter& out) const;
+
+    std::vector<std::shared_ptr<Characteristic>> members;
+};
+
+} // namespace CustomBLE
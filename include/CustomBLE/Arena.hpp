@@ -0,0 +1,99 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace CustomBLE {
+
+/**
+ * @brief Monotonic (bump) allocator over one contiguous block.
+ *
+ * Used by ServiceManager to place all GATT metadata (Service and
+ * Characteristic objects, descriptor arrays, chr_defs, svc_defs and the
+ * connection manager tables) in a single block with stable addresses, so
+ * building the table does not fragment the heap. Memory is only returned
+ * when the arena is destroyed; deallocate() is a no-op for arena memory.
+ *
+ * A default-constructed arena has no block and only measures: requests are
+ * served from the heap and required() reports the block size that would have
+ * held them. Size the real arena from such a dry run of the same build code.
+ * Requests that do not fit the block fall back to the heap as well (and are
+ * counted in overflow_bytes()), so an undersized arena never breaks the
+ * build. Not thread safe; build the GATT table from one task.
+ */
+class Arena {
+public:
+    /** @brief Measuring arena (dry run). */
+    Arena() = default;
+    /** @brief Arena over a caller-owned block that must outlive it. */
+    Arena(void* buffer, size_t capacity);
+    /** @brief Arena owning one heap block of capacity bytes. */
+    explicit Arena(size_t capacity);
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t alignment);
+    void deallocate(void* ptr);
+    bool contains(const void* ptr) const;
+
+    size_t capacity() const { return block_capacity; }
+    /** @brief Bytes handed out from the block (including alignment padding). */
+    size_t used() const { return block_used; }
+    /** @brief Block size needed to serve every request so far without falling back to the heap. */
+    size_t required() const { return required_bytes; }
+    /** @brief Bytes that did not fit the block and came from the heap instead. */
+    size_t overflow_bytes() const { return overflow; }
+
+private:
+    uint8_t* block {nullptr};
+    size_t block_capacity {0};
+    size_t block_used {0};
+    size_t required_bytes {0};
+    size_t overflow {0};
+    bool owns_block {false};
+};
+
+/**
+ * @brief Standard allocator drawing from an Arena, or from the heap when the arena is nullptr.
+ */
+template<typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    ArenaAllocator(Arena* arena = nullptr) noexcept : arena(arena) {}
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena(other.get_arena()) {}
+
+    T* allocate(size_t n) {
+        if (!arena) {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* ptr, size_t) noexcept {
+        if (!arena) {
+            ::operator delete(ptr);
+            return;
+        }
+        arena->deallocate(ptr);
+    }
+
+    Arena* get_arena() const noexcept { return arena; }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const noexcept { return arena == other.get_arena(); }
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const noexcept { return arena != other.get_arena(); }
+
+private:
+    Arena* arena;
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+} // namespace CustomBLE
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "CustomBLE/ValueReader.hpp"
+
+namespace CustomBLE {
+
+/**
+ * @brief Decides whether a value about to be notified differs from the last one sent.
+ *
+ * Two opt-in modes:
+ *  - Hash: remembers a 64-bit FNV-1a hash and the length of the last sent
+ *    value and suppresses byte-identical values.
+ *  - Deadband: the value is a single number of type T (e.g. from
+ *    make_pointer_read_callback<T>); values within +/- deadband of the last
+ *    sent one are suppressed. Values of any other length are always sent.
+ *
+ * The first value after enable() / reset() is always sent. Copies keep the
+ * mode and deadband, not the last sent value or the suppressed count.
+ */
+class ChangeDetector {
+public:
+    enum class Mode : uint8_t {
+        Off,
+        Hash,
+        Deadband,
+    };
+
+    ChangeDetector() = default;
+    ChangeDetector(const ChangeDetector& other) { *this = other; }
+    ChangeDetector& operator=(const ChangeDetector& other);
+
+    void disable() { mode = Mode::Off; }
+    void enable_hash();
+
+    template<typename T>
+    void enable_deadband(T deadband) {
+        static_assert(std::is_arithmetic_v<T>, "Deadband requires an arithmetic value type");
+        static_assert(sizeof(T) <= sizeof(last_value), "Deadband value type too large");
+        mode = Mode::Deadband;
+        value_size = sizeof(T);
+        std::memcpy(band, &deadband, sizeof(T));
+        within_band = &within_deadband<T>;
+        reset();
+    }
+
+    /**
+     * @brief Forget the last sent value so the next one goes out (e.g. on a new subscription).
+     */
+    void reset() { has_last = false; }
+
+    Mode get_mode() const { return mode; }
+
+    /**
+     * @brief Check value against the last sent one and remember it if it should be sent.
+     * @return true if the value should be sent, false if it is suppressed
+     */
+    bool should_send(const ValueReader& value);
+
+    size_t suppressed_count() const { return suppressed; }
+
+private:
+    template<typename T>
+    static bool within_deadband(const uint8_t* last, const uint8_t* current, const uint8_t* band) {
+        T a, b, d;
+        std::memcpy(&a, last, sizeof(T));
+        std::memcpy(&b, current, sizeof(T));
+        std::memcpy(&d, band, sizeof(T));
+        T diff = a > b ? static_cast<T>(a - b) : static_cast<T>(b - a);
+        return diff <= d;
+    }
+
+    Mode mode {Mode::Off};
+    bool has_last {false};
+    uint8_t value_size {0};
+    uint8_t last_value[8] {};
+    uint8_t band[8] {};
+    bool (*within_band)(const uint8_t*, const uint8_t*, const uint8_t*) {nullptr};
+    uint64_t last_hash {0};
+    size_t last_length {0};
+    size_t suppressed {0};
+};
+
+} // namespace CustomBLE
@@ -1,19 +1,58 @@
 #pragma once
+#include <atomic>
 #include <string>
-#include <functional>
 #include <cstring>
+#include <type_traits>
+#include <variant>
 #include <esp_log.h>
 #include <esp_err.h>
 #include <host/ble_gatt.h>
 #include <host/ble_uuid.h>
 #include <host/ble_hs.h>
+#include "CustomBLE/AccessStats.hpp"
+#include "CustomBLE/ChangeDetector.hpp"
+#include "CustomBLE/DeferredWriteQueue.hpp"
+#include "CustomBLE/InlineFunction.hpp"
+#include "CustomBLE/NotificationEngine.hpp"
+#include "CustomBLE/PublishedValue.hpp"
+#include "CustomBLE/ReadCache.hpp"
+#include "CustomBLE/ReadSnapshots.hpp"
+#include "CustomBLE/SubscriptionTable.hpp"
+#include "CustomBLE/ValueReader.hpp"
+#include "CustomBLE/ValueWriter.hpp"
+#include "CustomBLE/WriteBuffers.hpp"
 
 namespace CustomBLE {
 
 class Characteristic {
 public:
-    using ReadCallback = std::function<std::string()>;
-    using WriteCallback = std::function<void(const std::string&)>;
+    // All callbacks live in fixed inline storage (see InlineFunction.hpp); lambdas
+    // capturing more than callback_storage_size bytes do not compile.
+    using ReadCallback = InlineFunction<std::string()>;
+    using WriteCallback = InlineFunction<void(const std::string&)>;
+    /**
+     * Sink-style read callback: appends the value to the writer (bound to the
+     * outgoing os_mbuf during GATT reads) and returns 0 or a BLE_ATT_ERR_* code.
+     */
+    using ReadSinkCallback = InlineFunction<int(ValueWriter&)>;
+    /**
+     * View-style write callback: reads the received value through a non-owning
+     * ValueReader and returns 0 or a BLE_ATT_ERR_* code.
+     */
+    using WriteViewCallback = InlineFunction<int(ValueReader&)>;
+
+    template<typename F>
+    static constexpr bool is_read_sink_v = std::is_invocable_r_v<int, F, ValueWriter&>;
+    template<typename F>
+    static constexpr bool is_write_view_v = std::is_invocable_r_v<int, F, ValueReader&>;
+    /**
+     * True if (R, W) is a valid read/write callback pair using at least one sink/view callback.
+     */
+    template<typename R, typename W>
+    static constexpr bool has_io_callbacks_v =
+        (is_read_sink_v<R> || std::is_constructible_v<ReadCallback, R>) &&
+        (is_write_view_v<W> || std::is_constructible_v<WriteCallback, W>) &&
+        (is_read_sink_v<R> || is_write_view_v<W>);
 
     /**
      * @brief Construct a Characteristic
@@ -27,7 +66,39 @@ public:
                    ReadCallback read_cb = nullptr,
                    WriteCallback write_cb = nullptr);
 
+    /**
+     * @brief Construct a Characteristic using sink-style read and/or view-style write callbacks
+     * @param name Optional constant string identifying the characteristic (pointer NOT owned)
+     * @param characteristic_uuid 128-bit UUID
+     * @param read_cb ReadSinkCallback, ReadCallback or nullptr
+     * @param write_cb WriteViewCallback, WriteCallback or nullptr
+     */
+    template<typename R, typename W = std::nullptr_t,
+             typename = std::enable_if_t<has_io_callbacks_v<R, W>>>
+    Characteristic(const char* name,
+                   const ble_uuid128_t& characteristic_uuid,
+                   R&& read_cb,
+                   W&& write_cb = nullptr)
+        : Characteristic(name, characteristic_uuid, ReadCallback(), WriteCallback()) {
+        if constexpr (is_read_sink_v<R>) {
+            set_read_sink_callback(ReadSinkCallback(std::forward<R>(read_cb)));
+        } else {
+            set_read_callback(ReadCallback(std::forward<R>(read_cb)));
+        }
+        if constexpr (is_write_view_v<W>) {
+            set_write_view_callback(WriteViewCallback(std::forward<W>(write_cb)));
+        } else {
+            set_write_callback(WriteCallback(std::forward<W>(write_cb)));
+        }
+    }
+
     int handle_access(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt);
+    /**
+     * @brief Connection whose GATT access is being dispatched.
+     * Valid inside read/write callbacks; BLE_HS_CONN_HANDLE_NONE outside of
+     * handle_access (connection manager and local reads/writes).
+     */
+    static uint16_t access_conn_handle();
     static int gatt_access_callback(uint16_t conn_handle, uint16_t attr_handle,
                                    struct ble_gatt_access_ctxt *ctxt, void *arg);
 
@@ -36,9 +107,223 @@ public:
     void set_handle(uint16_t char_handle);
     uint16_t get_handle() const;
     void set_read_callback(ReadCallback callback);
+    /**
+     * @brief Set a sink-style read callback (replaces any std::string read callback).
+     */
+    void set_read_sink_callback(ReadSinkCallback callback);
     void set_write_callback(WriteCallback callback);
+    /**
+     * @brief Set a view-style write callback (replaces any std::string write callback).
+     */
+    void set_write_view_callback(WriteViewCallback callback);
     std::string read_value() const;
+    /**
+     * @brief Produce the current value into writer (through the read cache, if enabled).
+     * @return 0 on success, BLE_ATT_ERR_* otherwise
+     */
+    int read_into(ValueWriter& writer) const;
     void write_value(const std::string& value) const;
+    /**
+     * @brief Dispatch a write of len bytes to the write callback (no intermediate copy for view callbacks).
+     * @return 0 on success, BLE_ATT_ERR_* otherwise (e.g. value longer than get_max_length())
+     */
+    int write_bytes(const void* data, size_t len) const;
+
+    /**
+     * @brief Serve reads from a cached copy of the read callback's result for ttl_ms.
+     *
+     * Applies to GATT reads (handle_access) and connection manager reads, so an
+     * expensive callback (I2C, ADC, ...) runs at most once per ttl_ms no matter
+     * how many centrals poll. Values up to get_max_length() bytes are cached; the
+     * buffer is allocated at the first read, sized to that value. Pass 0 to
+     * disable. notify() always samples a fresh value.
+     */
+    void set_read_cache_ttl(uint32_t ttl_ms) {
+        if (ttl_ms == 0) {
+            if (Extension* ext = extension.get()) {
+                ext->read_cache.disable();
+            }
+        } else {
+            extension.ensure().read_cache.enable(ttl_ms, max_length);
+        }
+    }
+
+    /**
+     * @brief Drop the cached value (and any long read snapshot) so the next read runs the callback. Safe from any task.
+     */
+    void invalidate_read_cache() {
+        ReadSnapshots::invalidate(this);
+        if (Extension* ext = extension.get()) {
+            ext->read_cache.invalidate();
+        }
+    }
+    const ReadCache& get_read_cache() const;
+
+#ifdef CONFIG_CUSTOMBLE_ACCESS_STATS
+    /**
+     * @brief Counters and latency histogram of GATT and connection manager accesses.
+     * Only available with CONFIG_CUSTOMBLE_ACCESS_STATS.
+     */
+    const AccessStats& get_access_stats() const { return access_stats; }
+    void reset_access_stats() { access_stats.reset(); }
+#endif
+
+    /**
+     * @brief Send the current value (as produced by the read callback) to every subscribed connection.
+     *
+     * The value is built directly in an os_mbuf; connections that enabled
+     * notifications get a notification, indicate-only connections an indication.
+     * @return 0 on success (or no subscribers), last NimBLE error code otherwise
+     */
+    int notify();
+
+    /**
+     * @brief Send the given value to every subscribed connection.
+     */
+    int notify(const void* data, size_t len);
+    int notify(const std::string& value) { return notify(value.data(), value.size()); }
+
+    /**
+     * @brief Queue a notification of the current value; pending notifications are
+     * sent together in one NimBLE host task wakeup. Safe to call from any task.
+     * Falls back to notify() if the characteristic is not registered with a ServiceManager.
+     */
+    void schedule_notify();
+
+    /**
+     * @brief Only notify when the value actually changed.
+     *
+     * notify()/schedule_notify() keep producing the value through the read
+     * callback, but a value byte-identical to the last one sent (compared by
+     * hash) is dropped before it reaches NimBLE. A new subscription always
+     * receives the next value.
+     */
+    void set_notify_on_change(bool enabled) {
+        if (enabled) {
+            extension.ensure().change_detector.enable_hash();
+        } else if (Extension* ext = extension.get()) {
+            ext->change_detector.disable();
+        }
+    }
+
+    /**
+     * @brief Only notify when a numeric value of type T moved by more than deadband.
+     *
+     * The read callback must produce exactly sizeof(T) bytes (as the pointer
+     * factories do); values of another length are always sent.
+     */
+    template<typename T>
+    void set_notify_deadband(T deadband) { extension.ensure().change_detector.enable_deadband(deadband); }
+
+    /**
+     * @brief Number of notifications dropped because the value did not change.
+     */
+    size_t get_suppressed_notifications() const {
+        const Extension* ext = extension.get();
+        return ext ? ext->change_detector.suppressed_count() : 0;
+    }
+
+    /**
+     * @brief Advertise indication support (BLE_GATT_CHR_F_INDICATE).
+     * Takes effect until the GATT table is frozen (add_services_to_nimble(), register_with_conn_mgr()).
+     */
+    void set_indicate_enabled(bool enabled);
+
+    /**
+     * @brief Accept Write Without Response (BLE_GATT_CHR_F_WRITE_NO_RSP) as well.
+     * Takes effect until the GATT table is frozen (add_services_to_nimble(), register_with_conn_mgr()).
+     *
+     * Write commands reach the write callback like Write Requests, but the
+     * central does not wait for a response, so it can send several per
+     * connection event. The callback's result is not reported back.
+     */
+    void set_write_without_response_enabled(bool enabled);
+
+    /**
+     * @brief Record a CCCD change of a connection (called by ServiceManager for GAP subscribe events).
+     */
+    void on_subscribe(uint16_t conn_handle, bool notify, bool indicate);
+
+    /**
+     * @brief Drop all subscriptions of a connection.
+     */
+    void on_disconnect(uint16_t conn_handle);
+
+    bool has_subscribers() const {
+        const Extension* ext = extension.get();
+        return ext && !ext->subscriptions.empty();
+    }
+    const SubscriptionTable& get_subscriptions() const;
+
+    /**
+     * @brief Storage NimBLE writes the value handle into (ble_gatt_chr_def::val_handle).
+     */
+    uint16_t* get_handle_storage() { return &handle; }
+
+    void set_notification_engine(NotificationEngine* engine) { notification_engine = engine; }
+
+    /**
+     * @brief Run the write callback from queue instead of the NimBLE host task (nullptr: direct).
+     *
+     * GATT and connection manager writes are copied into the queue and
+     * acknowledged; the callback runs when the application drains it (see
+     * DeferredWriteQueue). Values are still checked against get_max_length()
+     * first. Local writes (write_value()/write_bytes()) stay synchronous.
+     * Meant for slow callbacks: pointer-based characteristics are cheaper direct.
+     */
+    void set_write_queue(DeferredWriteQueue* queue) {
+        if (queue || extension.get()) {
+            extension.ensure().write_queue = queue;
+        }
+    }
+    DeferredWriteQueue* get_write_queue() const {
+        const Extension* ext = extension.get();
+        return ext ? ext->write_queue : nullptr;
+    }
+
+    enum Compression : uint8_t {
+        CompressNone = 0x00,
+        CompressReads = 0x01,   // reads and notifications carry the value as an LZ4 block
+        CompressWrites = 0x02,  // GATT and connection manager writes carry an LZ4 block
+        CompressStream = 0x04,  // stream packets are linked LZ4 blocks (StreamCharacteristic)
+    };
+
+    /**
+     * @brief Exchange the value LZ4-compressed with centrals (Compression flags). Set before registration.
+     *
+     * The callbacks keep seeing the plain value: reads and notifications are
+     * compressed into the outgoing mbuf (each value one LZ4 block, see
+     * LzCodec), writes are decompressed before the write callback, the write
+     * queue or the get_max_length() check. Local read_value()/write_bytes()
+     * are not compressed. A Compression descriptor (LzCodec::descriptor_uuid)
+     * is added so centrals can tell; values of incompressible data grow by
+     * a few bytes, so keep get_max_length() at or below 494 for reads.
+     * The working buffers are static and shared; a task that finds them in
+     * use (another task, or a compressed aggregate member) allocates its own.
+     */
+    void set_compression(uint8_t modes) { compression = modes; }
+    uint8_t get_compression() const { return compression; }
+
+    /**
+     * @brief Set the maximum accepted value length. Longer writes are rejected with
+     * BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN before any data is copied.
+     */
+    void set_max_length(uint16_t length) {
+        max_length = length;
+        Extension* ext = extension.get();
+        if (ext && ext->read_cache.enabled()) {
+            ext->read_cache.enable(ext->read_cache.get_ttl_ms(), length);
+        }
+    }
+    uint16_t get_max_length() const { return max_length; }
+
+    /**
+     * @brief Bytes of every Characteristic taken by the inline read and write callback storage.
+     */
+    static constexpr size_t callback_storage_size() {
+        return sizeof(std::variant<std::monostate, ReadCallback, ReadSinkCallback>) +
+               sizeof(std::variant<std::monostate, WriteCallback, WriteViewCallback>);
+    }
 
     /**
      * @brief Generate a string overview of the characteristic.
@@ -53,18 +338,31 @@ public:
 
     // Static factory methods for pointer-based characteristics
     template<typename T>
-    static ReadCallback make_pointer_read_callback(T* value_ptr) {
-        return [value_ptr]() {
-            return std::string(reinterpret_cast<const char*>(value_ptr), sizeof(T));
+    static ReadSinkCallback make_pointer_read_callback(T* value_ptr) {
+        return [value_ptr](ValueWriter& out) {
+            return out.append(value_ptr, sizeof(T));
+        };
+    }
+
+    /**
+     * @brief Read callback serving a consistent snapshot of a value published by another task.
+     */
+    template<typename T>
+    static ReadSinkCallback make_pointer_read_callback(PublishedValue<T>* value) {
+        return [value](ValueWriter& out) {
+            T snapshot = value->load();
+            return out.append(&snapshot, sizeof(T));
         };
     }
 
     template<typename T>
-    static WriteCallback make_pointer_write_callback(T* value_ptr) {
-        return [value_ptr](const std::string& data) {
-            if (data.size() == sizeof(T)) {
-                std::memcpy(value_ptr, data.data(), sizeof(T));
+    static WriteViewCallback make_pointer_write_callback(T* value_ptr) {
+        static_assert(!is_published_value<T>::value, "A PublishedValue has a single producer: it cannot be written over BLE");
+        return [value_ptr](ValueReader& in) {
+            if (in.size() != sizeof(T)) {
+                return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
             }
+            return in.copy_to(value_ptr, sizeof(T));
         };
     }
 
@@ -72,35 +370,109 @@ public:
     template<typename T>
     static Characteristic from_pointer_read_only(const ble_uuid128_t& uuid, T* value_ptr, const char* name = nullptr) {
         auto read_cb = make_pointer_read_callback(value_ptr);
-        return Characteristic(name, uuid, read_cb, nullptr);
+        Characteristic characteristic(name, uuid, std::move(read_cb), nullptr);
+        characteristic.set_max_length(sizeof(T));
+        return characteristic;
+    }
+
+    template<typename T>
+    static Characteristic from_pointer_read_only(const ble_uuid128_t& uuid, PublishedValue<T>* value, const char* name = nullptr) {
+        Characteristic characteristic(name, uuid, make_pointer_read_callback(value), nullptr);
+        characteristic.set_max_length(sizeof(T));
+        return characteristic;
     }
 
     template<typename T>
     static Characteristic from_pointer_read_write(const ble_uuid128_t& uuid, T* value_ptr, const char* name = nullptr) {
         auto read_cb = make_pointer_read_callback(value_ptr);
         auto write_cb = make_pointer_write_callback(value_ptr);
-        return Characteristic(name, uuid, read_cb, write_cb);
+        Characteristic characteristic(name, uuid, std::move(read_cb), std::move(write_cb));
+        characteristic.set_max_length(sizeof(T));
+        return characteristic;
     }
 
     template<typename T>
     static Characteristic from_pointer_write_only(const ble_uuid128_t& uuid, T* value_ptr, const char* name = nullptr) {
         auto write_cb = make_pointer_write_callback(value_ptr);
-        return Characteristic(name, uuid, nullptr, write_cb);
+        Characteristic characteristic(name, uuid, nullptr, std::move(write_cb));
+        characteristic.set_max_length(sizeof(T));
+        return characteristic;
     }
     
     // Static factory method for fixed value (read-only) characteristics
     static Characteristic from_fixed_value(const ble_uuid128_t& uuid, const std::string& value, const char* name = nullptr) {
-        ReadCallback read_cb = [value]() { return value; };
-        return Characteristic(name, uuid, read_cb, nullptr);
+        ReadSinkCallback read_cb = [value](ValueWriter& out) { return out.append(value); };
+        return Characteristic(name, uuid, std::move(read_cb), nullptr);
     }
 
 private:
+    friend class AggregateCharacteristic;
+    friend class DeferredWriteQueue;
+    friend class NotificationEngine;
+    friend class ServiceManager;
+
+    int dispatch_access(uint16_t conn_handle, struct ble_gatt_access_ctxt *ctxt);
+
+    int read_uncached(ValueWriter& writer) const;
+    int read_wire(ValueWriter& writer, bool cached = true) const;
+    int read_fragment(uint16_t conn_handle, os_mbuf* om) const;
+    int dispatch_write(ValueReader& reader, const std::string* flat_copy = nullptr) const;
+    int receive_bytes(const void* data, size_t len) const;
+    int send_to_subscribers(os_mbuf* om);
+
+    /**
+     * Opt-in state, allocated by the first feature that needs it (a subscription,
+     * read cache, change detection or write queue), so plain characteristics do
+     * not carry it. Copies keep the configuration, not subscriptions or cached values.
+     */
+    struct Extension {
+        SubscriptionTable subscriptions;
+        NotificationLink notification_link;
+        ChangeDetector change_detector;
+        // Filled on the NimBLE host task from const read paths.
+        mutable ReadCache read_cache;
+        DeferredWriteQueue* write_queue {nullptr};
+    };
+
+    /**
+     * Owning pointer to the Extension. Once published it lives as long as the
+     * characteristic, so any task may read through get().
+     */
+    class ExtensionPtr {
+    public:
+        ExtensionPtr() = default;
+        ExtensionPtr(const ExtensionPtr& other) : ptr(other.get() ? new Extension(*other.get()) : nullptr) {}
+        ExtensionPtr(ExtensionPtr&& other) noexcept : ptr(other.ptr.exchange(nullptr, std::memory_order_acq_rel)) {}
+        ExtensionPtr& operator=(ExtensionPtr other) noexcept {
+            delete ptr.exchange(other.ptr.exchange(nullptr, std::memory_order_acq_rel), std::memory_order_acq_rel);
+            return *this;
+        }
+        ~ExtensionPtr() { delete ptr.load(std::memory_order_acquire); }
+
+        Extension* get() const { return ptr.load(std::memory_order_acquire); }
+        /**
+         * The Extension, allocated on first use.
+         */
+        Extension& ensure();
+
+    private:
+        std::atomic<Extension*> ptr {nullptr};
+    };
+
     ble_uuid128_t uuid;
     uint16_t handle;
-    ReadCallback read_callback;
-    WriteCallback write_callback;
+    // Only one read and one write callback form is active at a time.
+    std::variant<std::monostate, ReadCallback, ReadSinkCallback> read_handler;
+    std::variant<std::monostate, WriteCallback, WriteViewCallback> write_handler;
     uint16_t flags;
     const char* name {nullptr};
+    uint16_t max_length {BLE_ATT_ATTR_MAX_LEN};
+    uint8_t compression {CompressNone};
+    NotificationEngine* notification_engine {nullptr};
+    ExtensionPtr extension;
+#ifdef CONFIG_CUSTOMBLE_ACCESS_STATS
+    mutable AccessStats access_stats;
+#endif
 };
 
 } // namespace CustomBLE
@@ -1,4 +1,5 @@
 #pragma once
+#include "CustomBLE/Arena.hpp"
 #include "CustomBLE/Characteristic.hpp"
 #include <vector>
 #include <memory>
@@ -11,29 +12,54 @@ public:
         std::shared_ptr<Characteristic> characteristic;
         ble_gatt_chr_def chr_def;
         // Optional descriptor storage (e.g. user description). If non-empty, chr_def.descriptors points here.
-        std::vector<ble_gatt_dsc_def> descriptors;
+        ArenaVector<ble_gatt_dsc_def> descriptors;
     };
 
 private:
-    std::vector<CharacteristicEntry> entries;
-    std::vector<ble_gatt_chr_def> chr_defs;
+    Arena* arena;
+    ArenaVector<CharacteristicEntry> entries;
+    ArenaVector<ble_gatt_chr_def> chr_defs;
+    bool frozen {false};
+
+    void add_compression_descriptor(CharacteristicEntry& entry);
 public:
     // Add public accessor for entries
-    const std::vector<CharacteristicEntry>& get_entries() const { return entries; }
+    const ArenaVector<CharacteristicEntry>& get_entries() const { return entries; }
+    const ArenaVector<ble_gatt_chr_def>& get_chr_def_table() const { return chr_defs; }
 
 public:
+    /**
+     * @param arena Optional arena for characteristics, descriptors and the chr_def table (must outlive the manager)
+     */
+    explicit CharacteristicsManager(Arena* arena = nullptr);
+
+    /**
+     * @brief Reserve room for count characteristics (avoids regrowing the entry table).
+     */
+    void reserve(size_t count) { entries.reserve(count); }
+
+    /**
+     * @brief Construct a Characteristic in this manager's arena (or on the heap without one).
+     * The result still has to be added with add_characteristic().
+     */
+    template<typename... Args>
+    std::shared_ptr<Characteristic> make_characteristic(Args&&... args) {
+        return std::allocate_shared<Characteristic>(ArenaAllocator<Characteristic>(arena), std::forward<Args>(args)...);
+    }
+
     /**
      * @brief Add a new characteristic to the manager.
      * @param characteristic Unique pointer to a Characteristic
+     * @return ESP_OK, or ESP_ERR_INVALID_STATE if the table is already frozen (nothing is added)
      */
-    void add_characteristic(std::shared_ptr<Characteristic> characteristic);
+    esp_err_t add_characteristic(std::shared_ptr<Characteristic> characteristic);
 
     /**
      * @brief Emplace a new characteristic inline (constructs and adds).
      * @param characteristic_uuid UUID of the characteristic
      * @param read_cb Optional read callback
      * @param write_cb Optional write callback
-     * @return Shared pointer to the newly added Characteristic
+     * @return Shared pointer to the newly added Characteristic (nullptr if the table is frozen)
      */
     std::shared_ptr<Characteristic> emplace_characteristic(const ble_uuid128_t& characteristic_uuid,
                                            Characteristic::ReadCallback read_cb = nullptr,
@@ -43,9 +69,33 @@ public:
                                            Characteristic::ReadCallback read_cb = nullptr,
                                            Characteristic::WriteCallback write_cb = nullptr);
 
+    /**
+     * @brief Emplace a characteristic using sink-style read and/or view-style write callbacks.
+     */
+    template<typename R, typename W = std::nullptr_t,
+             typename = std::enable_if_t<Characteristic::has_io_callbacks_v<R, W>>>
+    std::shared_ptr<Characteristic> emplace_characteristic(const char* name,
+                                           const ble_uuid128_t& characteristic_uuid,
+                                           R&& read_cb,
+                                           W&& write_cb = nullptr) {
+        auto characteristic = make_characteristic(name, characteristic_uuid, std::forward<R>(read_cb), std::forward<W>(write_cb));
+        if (add_characteristic(characteristic) != ESP_OK) {
+            return nullptr;
+        }
+        return characteristic;
+    }
+
+    /**
+     * @brief Lay out the ble_gatt_chr_def array once (exact size) and reject further adds.
+     *
+     * Called by get_chr_defs() if needed; calling it again is a no-op.
+     */
+    void freeze();
+    bool is_frozen() const { return frozen; }
+
     /**
      * @brief Get pointer to the array of ble_gatt_chr_def for service definition.
-     * The last element is always the end marker.
+     * The last element is always the end marker. Freezes the manager.
      */
     ble_gatt_chr_def* get_chr_defs();
 
@@ -64,11 +114,6 @@ public:
      */
     void print() const;
 
-private:
-    /**
-     * @brief Update the internal chr_defs vector, ensuring the last element is the end marker.
-     */
-    void update_chr_defs();
 };
 
 } // namespace CustomBLE
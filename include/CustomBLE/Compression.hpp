@@ -0,0 +1,174 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <host/ble_hs.h>
+#include <sdkconfig.h>
+#include "CustomBLE/ValueWriter.hpp"
+
+namespace CustomBLE {
+
+/**
+ * Bytes a compressed stream block may refer back to (LZ4 match distance).
+ */
+#ifdef CONFIG_CUSTOMBLE_COMPRESSION_WINDOW
+inline constexpr size_t compression_window = CONFIG_CUSTOMBLE_COMPRESSION_WINDOW;
+#else
+inline constexpr size_t compression_window = 1024;
+#endif
+static_assert(compression_window >= 64 && compression_window <= 16384, "compression window must be 64..16384 bytes");
+
+/**
+ * @brief LZ4 block codec for characteristic values.
+ *
+ * Compressed values are plain LZ4 blocks (no frame header), so a central can
+ * decode them with any LZ4 library (LZ4_decompress_safe() and friends). The
+ * encoder is a greedy single-probe matcher over a 512-byte hash table
+ * (Table), passed in by the caller or kept on the stack; nothing is allocated.
+ */
+struct LzCodec {
+    /**
+     * @brief Hash table of compress(); its contents need not be initialized.
+     */
+    struct Table {
+        uint16_t slots[256];
+    };
+
+    /**
+     * @brief Format id announced in the compression descriptor.
+     */
+    static constexpr uint8_t format_lz4_block = 0x01;
+
+    /**
+     * @brief UUID of the read-only Compression descriptor of compressed characteristics.
+     *
+     * Value (little endian): format u8 (format_lz4_block), modes u8
+     * (Characteristic::Compression flags), largest decompressed value or
+     * stream block u16, window u16 (how far stream blocks refer back).
+     */
+    static const ble_uuid128_t descriptor_uuid;
+    static constexpr size_t descriptor_size = 6;
+
+    /**
+     * @brief Largest compressed size of len input bytes (incompressible data grows slightly).
+     */
+    static constexpr size_t bound(size_t len) { return len + len / 255 + 16; }
+
+    /**
+     * @brief Append data, compressed as one independent block, to out.
+     *
+     * The overload without table keeps it on the calling task's stack.
+     * @return 0 on success, BLE_ATT_ERR_INSUFFICIENT_RES if out is full
+     */
+    static int compress(const uint8_t* data, size_t len, ValueWriter& out, Table& table);
+    static int compress(const uint8_t* data, size_t len, ValueWriter& out);
+
+    /**
+     * @brief Decode one block into out.
+     *
+     * Matches may refer to up to history bytes before out (the output of
+     * earlier linked blocks); pass 0 for independent blocks. Malformed input
+     * is detected, never read or written out of bounds.
+     * @return decoded length, or -1 if the block is malformed or does not fit capacity
+     */
+    static int decompress(const uint8_t* data, size_t len, uint8_t* out, size_t capacity, size_t history = 0);
+};
+
+/**
+ * @brief Streaming LZ4 encoder for bulk transfers (linked blocks).
+ *
+ * Every call compresses one chunk into a self-delimited LZ4 block, but
+ * matches may reach back into the previous compression_window bytes of the
+ * stream, so a stream cut into small packets (notifications, L2CAP SDUs)
+ * still compresses like one large buffer. Decode the blocks in order with
+ * LzStreamDecoder, or LZ4_decompress_safe_continue() on the central.
+ *
+ * compress() only stages a block: call commit() once it was handed to the
+ * stack. A block that was not committed (did not fit, or could not be sent)
+ * is forgotten, and the same data or a part of it may be passed again.
+ *
+ * The state (2.5 KB plus the window) lives in the object; keep it
+ * static or in a long-lived object, not on a task stack. One stream per
+ * encoder, used from one task at a time.
+ */
+class LzStreamEncoder {
+public:
+    static constexpr size_t window = compression_window;
+    static constexpr size_t max_chunk = BLE_ATT_ATTR_MAX_LEN;
+
+    LzStreamEncoder() { reset(); }
+    LzStreamEncoder(const LzStreamEncoder&) = delete;
+    LzStreamEncoder& operator=(const LzStreamEncoder&) = delete;
+
+    /**
+     * @brief Start a new stream: the next block does not refer to earlier data.
+     */
+    void reset();
+
+    /**
+     * @brief Compress up to max_chunk bytes as the next block into out.
+     * @return compressed length, or -1 if len > max_chunk or the block does not fit capacity
+     */
+    int compress(const uint8_t* data, size_t len, uint8_t* out, size_t capacity);
+
+    /**
+     * @brief Where the next chunk goes (max_chunk bytes): produce the data in
+     * place and pass its length to compress_staged() instead of copying it in.
+     */
+    uint8_t* stage();
+
+    /**
+     * @brief Compress the first len bytes written at stage() as the next block, appended to out.
+     *
+     * The staged data is left as it is, so a block that did not fit may be
+     * retried with a shorter len.
+     * @return 0, or -1 if len > max_chunk or out is full
+     */
+    int compress_staged(size_t len, ValueWriter& out);
+
+    /**
+     * @brief Make the last compressed block part of the stream history.
+     */
+    void commit();
+
+    /**
+     * @brief Raw bytes committed since reset().
+     */
+    uint32_t get_position() const { return base + static_cast<uint32_t>(history); }
+
+private:
+    static constexpr unsigned hash_bits = 10;
+
+    uint8_t buffer[window + max_chunk];
+    uint16_t table[1u << hash_bits];
+    size_t history {0};  // committed bytes at the start of buffer
+    size_t staged {0};   // bytes of the last compress() after them
+    uint32_t base {0};   // stream position of buffer[0]
+};
+
+/**
+ * @brief Decoder for the blocks of an LzStreamEncoder (device side of compressed uploads, tests).
+ */
+class LzStreamDecoder {
+public:
+    static constexpr size_t window = compression_window;
+    static constexpr size_t max_chunk = LzStreamEncoder::max_chunk;
+
+    LzStreamDecoder() = default;
+    LzStreamDecoder(const LzStreamDecoder&) = delete;
+    LzStreamDecoder& operator=(const LzStreamDecoder&) = delete;
+
+    void reset() { history = 0; last = 0; }
+
+    /**
+     * @brief Decode the next block. The output stays valid until the next call.
+     * @return decoded length (at most max_chunk), or -1 if the block is malformed
+     */
+    int decompress(const uint8_t* data, size_t len, const uint8_t** out);
+
+private:
+    uint8_t buffer[window + max_chunk];
+    size_t history {0};  // decoded bytes kept for matches
+    size_t last {0};     // bytes decoded by the previous call, after them
+};
+
+} // namespace CustomBLE
@@ -0,0 +1,114 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "CustomBLE/InlineFunction.hpp"
+#include "CustomBLE/ValueReader.hpp"
+
+namespace CustomBLE {
+
+class Characteristic;
+
+/**
+ * @brief Moves write callbacks off the NimBLE host task.
+ *
+ * A characteristic with a write queue (Characteristic::set_write_queue())
+ * does not run its write callback inside the GATT access: the host task
+ * copies the value into this preallocated ring and acknowledges the write
+ * at once. The application drains the ring on a task of its choice, where
+ * the write callbacks run in arrival order. A slow callback, e.g. one
+ * writing flash, then no longer delays other connections or notifications.
+ *
+ * The ring is single producer (the NimBLE host task, which also serves the
+ * connection manager) and single consumer (the task calling drain()); no
+ * locks are taken. When a value does not fit, the overflow policy decides:
+ * Reject fails the write with BLE_ATT_ERR_INSUFFICIENT_RES so the central can
+ * retry, Drop acknowledges it and counts it in dropped_count().
+ *
+ * Deferred callbacks cannot change the ATT result anymore, and
+ * Characteristic::access_conn_handle() is BLE_HS_CONN_HANDLE_NONE inside
+ * them. Characteristics must outlive the queue's pending writes.
+ */
+class DeferredWriteQueue {
+public:
+    enum class OverflowPolicy : uint8_t {
+        Reject,
+        Drop,
+    };
+
+    /**
+     * @brief Called on the host task after a write was queued, e.g. to notify the draining task.
+     */
+    using Wakeup = InlineFunction<void()>;
+
+    /**
+     * @param capacity Ring size in bytes (allocated here); each write takes its
+     *        length plus a small header, rounded up to pointer alignment
+     */
+    explicit DeferredWriteQueue(size_t capacity, OverflowPolicy policy = OverflowPolicy::Reject);
+    DeferredWriteQueue(const DeferredWriteQueue&) = delete;
+    DeferredWriteQueue& operator=(const DeferredWriteQueue&) = delete;
+
+    void set_wakeup(Wakeup callback) { wakeup = std::move(callback); }
+
+    /**
+     * @brief Queue a copy of value for characteristic (producer side).
+     * @return 0 if queued or dropped by policy, BLE_ATT_ERR_INSUFFICIENT_RES if rejected
+     */
+    int push(const Characteristic& characteristic, const ValueReader& value);
+
+    /**
+     * @brief Run the write callbacks of up to max_writes queued writes on the calling task.
+     * @return number of writes dispatched
+     */
+    size_t drain(size_t max_writes = SIZE_MAX);
+
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+    /**
+     * @brief Bytes between tail and head, including any space skipped at the end of the ring.
+     */
+    size_t pending_bytes() const {
+        size_t t = tail.load(std::memory_order_acquire);
+        return (head.load(std::memory_order_acquire) + capacity - t) % capacity;
+    }
+    size_t get_capacity() const { return capacity; }
+    OverflowPolicy get_policy() const { return policy; }
+
+    size_t queued_count() const { return queued.load(std::memory_order_relaxed); }
+    size_t dispatched_count() const { return dispatched.load(std::memory_order_relaxed); }
+    size_t rejected_count() const { return rejected.load(std::memory_order_relaxed); }
+    size_t dropped_count() const { return dropped.load(std::memory_order_relaxed); }
+    /**
+     * @brief Largest number of bytes that were pending at once.
+     */
+    size_t high_water() const { return high_water_bytes.load(std::memory_order_relaxed); }
+
+private:
+    struct Record {
+        const Characteristic* characteristic; // nullptr: skip to the start of the ring
+        uint32_t length;
+    };
+
+    static constexpr size_t align(size_t size) {
+        return (size + alignof(Record) - 1) & ~(alignof(Record) - 1);
+    }
+    uint8_t* at(size_t position) const { return reinterpret_cast<uint8_t*>(storage.get()) + position % capacity; }
+
+    std::unique_ptr<Record[]> storage;
+    size_t capacity;
+    OverflowPolicy policy;
+    Wakeup wakeup;
+    // Byte offsets into the ring (always below capacity); written by the producer and the consumer respectively.
+    std::atomic<size_t> head {0};
+    std::atomic<size_t> tail {0};
+    std::atomic<size_t> queued {0};
+    std::atomic<size_t> dispatched {0};
+    std::atomic<size_t> rejected {0};
+    std::atomic<size_t> dropped {0};
+    std::atomic<size_t> high_water_bytes {0};
+};
+
+} // namespace CustomBLE
@@ -1,34 +1,32 @@
 #pragma once
 #include <string>
-#include <functional>
-#include <string>
+#include <string_view>
 #include <functional>
 #include <cstring>
+#include "CustomBLE/Characteristic.hpp"
 
+// Read callback for a pointer to any type (appends the raw bytes without a temporary string)
 template<typename T>
-std::function<std::string()> make_pointer_read_callback(T* value_ptr) {
-    return [value_ptr]() {
-        return std::string(reinterpret_cast<const char*>(value_ptr), sizeof(T));
-    };
+CustomBLE::Characteristic::ReadSinkCallback make_pointer_read_callback(T* value_ptr) {
+    return CustomBLE::Characteristic::make_pointer_read_callback(value_ptr);
 }
 
-// Write callback for a pointer to any type (sets value from binary string)
+// Write callback for a pointer to any type (copies straight from the received mbuf, rejects other sizes)
 template<typename T>
-std::function<void(const std::string&)> make_pointer_write_callback(T* value_ptr) {
-    return [value_ptr](const std::string& data) {
-        if (data.size() == sizeof(T)) {
-            std::memcpy(value_ptr, data.data(), sizeof(T));
-        }
-        // else: ignore or handle error
-    };
+CustomBLE::Characteristic::WriteViewCallback make_pointer_write_callback(T* value_ptr) {
+    return CustomBLE::Characteristic::make_pointer_write_callback(value_ptr);
 }
 
-// Read callback for a fixed value (returns the value)
-inline std::function<std::string()> make_fixed_read_callback(const std::string& value) {
-    return [value]() { return value; };
+// Read callback for a fixed value (appends the value without a temporary string)
+inline CustomBLE::Characteristic::ReadSinkCallback make_fixed_read_callback(const std::string& value) {
+    return [value](CustomBLE::ValueWriter& out) { return out.append(value); };
 }
 
-// Write callback for a fixed value (updates the value)
-inline std::function<void(const std::string&)> make_fixed_write_callback(std::string& value) {
-    return [&value](const std::string& data) { value = data; };
+// Write callback for a fixed value (updates the value, reusing its capacity)
+inline CustomBLE::Characteristic::WriteViewCallback make_fixed_write_callback(std::string& value) {
+    return [&value](CustomBLE::ValueReader& in) {
+        std::string_view data = in.view();
+        value.assign(data.data(), data.size());
+        return 0;
+    };
 }
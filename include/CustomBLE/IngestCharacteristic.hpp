@@ -0,0 +1,137 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "CustomBLE/Characteristic.hpp"
+#include "CustomBLE/InlineFunction.hpp"
+
+namespace CustomBLE {
+
+/**
+ * @brief High-rate upload characteristic: Write Without Response packets into a preallocated ring.
+ *
+ * Centrals write packets of [sequence u16 LE][payload] with Write Without
+ * Response (Write Requests work too), so several packets fit in every
+ * connection event instead of one per round trip. The host task copies each
+ * packet into a ring of fixed-size slots and returns; the application drains
+ * the ring in batches on its own task (firmware update, waveform upload).
+ *
+ * Sequence numbers are tracked per upload: the first packet (after reset()
+ * or from a new connection) sets the expected number, and every packet
+ * advances it. Skipped numbers are counted as gaps, older ones as stale
+ * (dropped), and packets arriving while the ring is full as overflows
+ * (dropped; a Write Request gets BLE_ATT_ERR_INSUFFICIENT_RES).
+ *
+ * Reading the characteristic returns the status: expected sequence u16,
+ * received u32, gaps u32, overflows u32, stale u32 (little endian), so the
+ * central can resend from a known point. Create with create() and add the
+ * shared_ptr to a Service.
+ */
+class IngestCharacteristic : public Characteristic {
+private:
+    struct Token {};
+
+public:
+    static constexpr size_t header_size = 2;
+
+    struct Counters {
+        uint32_t received {0};   // packets queued
+        uint32_t gaps {0};       // sequence numbers skipped by the central
+        uint32_t overflows {0};  // packets dropped because the ring was full
+        uint32_t stale {0};      // packets older than the expected sequence
+        uint32_t malformed {0};  // writes shorter than the header
+    };
+
+    /**
+     * @brief Called on the host task after packets were queued, e.g. to notify the draining task.
+     */
+    using Wakeup = InlineFunction<void()>;
+
+    /**
+     * @param slot_count Packets the ring holds (rounded up to a power of two, allocated here)
+     * @param max_payload Largest payload after the sequence header (ATT_MTU - 5 for full packets)
+     */
+    static std::shared_ptr<IngestCharacteristic> create(const char* name, const ble_uuid128_t& uuid,
+                                                        size_t slot_count, uint16_t max_payload = 244);
+
+    IngestCharacteristic(Token, const char* name, const ble_uuid128_t& uuid, size_t slot_count, uint16_t max_payload);
+    IngestCharacteristic(const IngestCharacteristic&) = delete;
+    IngestCharacteristic& operator=(const IngestCharacteristic&) = delete;
+
+    void set_wakeup(Wakeup callback) { wakeup = std::move(callback); }
+
+    /**
+     * @brief Pass up to max_packets queued packets to f(uint16_t sequence, const uint8_t* data, size_t len).
+     *
+     * The data points into the ring and is valid until f returns; the slots
+     * are handed back to the host task after the batch. Single consumer.
+     * @return number of packets passed to f
+     */
+    template<typename F>
+    size_t drain(F&& f, size_t max_packets = SIZE_MAX) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t h = head.load(std::memory_order_acquire);
+        size_t count = 0;
+        for (; t != h && count < max_packets; ++t, ++count) {
+            const Slot& slot = slot_at(t);
+            f(slot.sequence, slot_data(slot), static_cast<size_t>(slot.length));
+        }
+        tail.store(t, std::memory_order_release);
+        return count;
+    }
+
+    /**
+     * @brief Packets waiting to be drained.
+     */
+    size_t pending() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+    size_t get_slot_count() const { return slot_count; }
+    uint16_t get_max_payload() const { return max_payload; }
+
+    /**
+     * @brief Counters since creation (or reset()). Safe from any task.
+     */
+    Counters get_counters() const;
+
+    /**
+     * @brief Start a new upload: the next packet sets the expected sequence and the counters restart.
+     * Queued packets stay in the ring. Safe from any task.
+     */
+    void reset() { reset_requested.store(true, std::memory_order_release); }
+
+private:
+    struct Slot {
+        uint16_t sequence;
+        uint16_t length;
+    };
+
+    int handle_packet(ValueReader& in);
+    int write_status(ValueWriter& out) const;
+    Slot& slot_at(size_t index) const {
+        return *reinterpret_cast<Slot*>(storage.get() + (index & (slot_count - 1)) * slot_stride);
+    }
+    static const uint8_t* slot_data(const Slot& slot) { return reinterpret_cast<const uint8_t*>(&slot + 1); }
+
+    std::unique_ptr<uint8_t[]> storage;
+    size_t slot_count;
+    size_t slot_stride;
+    uint16_t max_payload;
+    Wakeup wakeup;
+    // Free-running packet counters; written by the host task and the consumer respectively.
+    std::atomic<size_t> head {0};
+    std::atomic<size_t> tail {0};
+    std::atomic<bool> reset_requested {false};
+    // Host task state.
+    bool synced {false};
+    uint16_t expected {0};
+    uint16_t writer {BLE_HS_CONN_HANDLE_NONE};
+    std::atomic<uint32_t> received {0};
+    std::atomic<uint32_t> gaps {0};
+    std::atomic<uint32_t> overflows {0};
+    std::atomic<uint32_t> stale {0};
+    std::atomic<uint32_t> malformed {0};
+};
+
+} // namespace CustomBLE
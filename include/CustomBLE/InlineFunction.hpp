@@ -0,0 +1,171 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <sdkconfig.h>
+
+namespace CustomBLE {
+
+/**
+ * Inline storage (bytes) for callables held by InlineFunction, i.e. the maximum
+ * size of a lambda's captures. Set CONFIG_CUSTOMBLE_CALLBACK_STORAGE_SIZE via
+ * Kconfig or a compiler define; the default fits one captured std::string.
+ */
+#ifdef CONFIG_CUSTOMBLE_CALLBACK_STORAGE_SIZE
+inline constexpr size_t callback_storage_size = CONFIG_CUSTOMBLE_CALLBACK_STORAGE_SIZE;
+#else
+inline constexpr size_t callback_storage_size = sizeof(std::string);
+#endif
+
+template<typename Signature, size_t Capacity = callback_storage_size>
+class InlineFunction;
+
+/**
+ * @brief Heap-free replacement for std::function with fixed inline storage.
+ *
+ * The callable is always stored inside the object; a callable larger than
+ * Capacity is rejected at compile time instead of falling back to the heap.
+ * Invocation is a single indirect call through a function pointer stored in
+ * the object. Trivially copyable callables (function pointers, lambdas
+ * capturing pointers/integers) are copied with memcpy and need no manager.
+ */
+template<typename R, typename... Args, size_t Capacity>
+class InlineFunction<R(Args...), Capacity> {
+public:
+    InlineFunction() noexcept = default;
+    InlineFunction(std::nullptr_t) noexcept {}
+
+    template<typename F,
+             typename D = std::decay_t<F>,
+             typename = std::enable_if_t<!std::is_same_v<D, InlineFunction> &&
+                                         !std::is_same_v<D, std::nullptr_t> &&
+                                         std::is_invocable_r_v<R, D&, Args...>>>
+    InlineFunction(F&& f) {
+        static_assert(sizeof(D) <= Capacity,
+                      "Callable too large for InlineFunction: capture less or raise CONFIG_CUSTOMBLE_CALLBACK_STORAGE_SIZE");
+        static_assert(alignof(D) <= alignof(std::max_align_t), "Callable is over-aligned for InlineFunction");
+        static_assert(std::is_copy_constructible_v<D>, "InlineFunction requires a copyable callable");
+        if constexpr (std::is_pointer_v<D> || std::is_member_pointer_v<D>) {
+            if (f == nullptr) {
+                return;
+            }
+        }
+        new (storage) D(std::forward<F>(f));
+        invoker = &invoke<D>;
+        if constexpr (!(std::is_trivially_copyable_v<D> && std::is_trivially_destructible_v<D>)) {
+            manager = &manage<D>;
+        }
+    }
+
+    InlineFunction(const InlineFunction& other) {
+        copy_from(other);
+    }
+
+    InlineFunction(InlineFunction&& other) noexcept {
+        move_from(other);
+    }
+
+    InlineFunction& operator=(const InlineFunction& other) {
+        if (this != &other) {
+            reset();
+            copy_from(other);
+        }
+        return *this;
+    }
+
+    InlineFunction& operator=(InlineFunction&& other) noexcept {
+        if (this != &other) {
+            reset();
+            move_from(other);
+        }
+        return *this;
+    }
+
+    InlineFunction& operator=(std::nullptr_t) noexcept {
+        reset();
+        return *this;
+    }
+
+    ~InlineFunction() {
+        reset();
+    }
+
+    R operator()(Args... args) const {
+        return invoker(const_cast<unsigned char*>(storage), std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const noexcept { return invoker != nullptr; }
+    bool operator==(std::nullptr_t) const noexcept { return invoker == nullptr; }
+    bool operator!=(std::nullptr_t) const noexcept { return invoker != nullptr; }
+
+    static constexpr size_t capacity() { return Capacity; }
+
+private:
+    enum class Op {
+        Copy,
+        Move,
+        Destroy,
+    };
+    using Invoker = R (*)(void*, Args&&...);
+    using Manager = void (*)(Op, void* dst, void* src);
+
+    template<typename D>
+    static R invoke(void* callable, Args&&... args) {
+        return (*static_cast<D*>(callable))(std::forward<Args>(args)...);
+    }
+
+    template<typename D>
+    static void manage(Op op, void* dst, void* src) {
+        switch (op) {
+            case Op::Copy:
+                new (dst) D(*static_cast<const D*>(src));
+                break;
+            case Op::Move:
+                new (dst) D(std::move(*static_cast<D*>(src)));
+                static_cast<D*>(src)->~D();
+                break;
+            case Op::Destroy:
+                static_cast<D*>(dst)->~D();
+                break;
+        }
+    }
+
+    void copy_from(const InlineFunction& other) {
+        if (other.manager) {
+            other.manager(Op::Copy, storage, const_cast<unsigned char*>(other.storage));
+        } else if (other.invoker) {
+            std::memcpy(storage, other.storage, Capacity);
+        }
+        invoker = other.invoker;
+        manager = other.manager;
+    }
+
+    void move_from(InlineFunction& other) {
+        if (other.manager) {
+            other.manager(Op::Move, storage, other.storage);
+        } else if (other.invoker) {
+            std::memcpy(storage, other.storage, Capacity);
+        }
+        invoker = other.invoker;
+        manager = other.manager;
+        other.invoker = nullptr;
+        other.manager = nullptr;
+    }
+
+    void reset() {
+        if (manager) {
+            manager(Op::Destroy, storage, nullptr);
+        }
+        invoker = nullptr;
+        manager = nullptr;
+    }
+
+    alignas(std::max_align_t) unsigned char storage[Capacity];
+    Invoker invoker {nullptr};
+    Manager manager {nullptr};
+};
+
+} // namespace CustomBLE
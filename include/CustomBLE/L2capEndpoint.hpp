@@ -0,0 +1,163 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <host/ble_hs.h>
+#include <nimble/nimble_npl.h>
+#include <sdkconfig.h>
+#include "CustomBLE/InlineFunction.hpp"
+#include "CustomBLE/TypedCharacteristic.hpp"
+
+namespace CustomBLE {
+
+/**
+ * @brief L2CAP connection-oriented channel (LE credit based) server for bulk transfers.
+ *
+ * Data sent over a channel travels as SDUs of up to the negotiated MTU,
+ * segmented by the stack into K-frames without any ATT header, which makes
+ * it the fastest way to move firmware images or sample dumps. Centrals find
+ * the PSM by reading psm_characteristic() and then open a channel to it; at
+ * most one channel per connection is accepted.
+ *
+ * Both directions are zero-copy os_mbuf chains:
+ *   - send() hands an SDU to the stack. The peer grants credits per K-frame;
+ *     once they run out the SDU is finished as credits arrive and can_send()
+ *     stays false until the Event::TxReady callback.
+ *   - received SDUs are passed to the receive callback, which owns the chain.
+ *     The endpoint then posts the next receive buffer, which is what gives the
+ *     peer new credits; returning false from the callback withholds it (the
+ *     peer stalls) until resume_receive().
+ *
+ * Requires CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM > 0. Events and callbacks
+ * arrive on the NimBLE host task, which owns the channel table: send(),
+ * can_send() and the other per-channel calls are for the host task only
+ * (callbacks, or events posted to the default queue). Other tasks hand SDUs
+ * over with post_send(); a channel's SDUs must come from one task at a time.
+ * The endpoint is registered with NimBLE by start() and must outlive the stack.
+ */
+class L2capEndpoint {
+public:
+#ifdef CONFIG_BT_NIMBLE_MAX_CONNECTIONS
+    static constexpr size_t max_channels = CONFIG_BT_NIMBLE_MAX_CONNECTIONS;
+#else
+    static constexpr size_t max_channels = 4;
+#endif
+    static constexpr uint16_t default_mtu = 512;
+
+    enum class Event : uint8_t {
+        Connected,
+        Disconnected,
+        TxReady,  // a stalled SDU went out: send() accepts the next one
+    };
+
+    /**
+     * @brief Takes ownership of sdu (free it with os_mbuf_free_chain()).
+     * @return true to receive the next SDU, false to withhold credits until resume_receive()
+     */
+    using ReceiveCallback = InlineFunction<bool(uint16_t conn_handle, os_mbuf* sdu)>;
+    using EventCallback = InlineFunction<void(uint16_t conn_handle, Event event)>;
+
+    /**
+     * @param psm LE PSM to listen on (0x0080..0x00FF for dynamic PSMs)
+     * @param mtu Largest SDU accepted from the peer
+     */
+    explicit L2capEndpoint(uint16_t psm, uint16_t mtu = default_mtu);
+    ~L2capEndpoint();
+    L2capEndpoint(const L2capEndpoint&) = delete;
+    L2capEndpoint& operator=(const L2capEndpoint&) = delete;
+
+    void set_receive_callback(ReceiveCallback callback) { receive_callback = std::move(callback); }
+    void set_event_callback(EventCallback callback) { event_callback = std::move(callback); }
+
+    /**
+     * @brief Register the server with NimBLE (after the host has synced, e.g. next to add_services_to_nimble()).
+     * @return 0 on success, BLE_HS_* error code otherwise
+     */
+    int start();
+
+    /**
+     * @brief Read-only characteristic holding the PSM (uint16, little endian), for the application's service.
+     */
+    TypedCharacteristic<uint16_t> psm_characteristic(const char* name, const ble_uuid128_t& uuid) const;
+
+    /**
+     * @brief Send one SDU (at most get_peer_mtu() bytes) without copying it. Host task only.
+     * @return 0 if the stack took sdu (possibly waiting for credits), otherwise
+     *         sdu stays with the caller: BLE_HS_EBUSY while the previous SDU waits
+     *         for credits, BLE_HS_ENOTCONN without a channel, BLE_HS_EBADDATA if too long
+     */
+    int send(uint16_t conn_handle, os_mbuf* sdu);
+
+    /**
+     * @brief Hand one SDU to the host task, which sends it once the channel can. Safe from any task.
+     *
+     * One SDU per connection waits at a time. An SDU that cannot be sent (no
+     * channel, too long) is freed with a warning.
+     * @return 0 if sdu was taken, BLE_HS_EBUSY (sdu stays with the caller)
+     *         while the previous SDU of conn_handle still waits
+     */
+    int post_send(uint16_t conn_handle, os_mbuf* sdu);
+
+    /**
+     * @brief Copy len bytes into an SDU from the msys pool and send it.
+     * @return as above, BLE_HS_ENOMEM if no mbufs are available
+     */
+    int send(uint16_t conn_handle, const void* data, size_t len);
+
+    /**
+     * @brief Post the receive buffer withheld by a receive callback that returned false.
+     */
+    void resume_receive(uint16_t conn_handle);
+
+    /**
+     * @brief Close the channel of conn_handle (Event::Disconnected follows).
+     */
+    int disconnect(uint16_t conn_handle);
+
+    // Host task only, like send().
+    bool is_connected(uint16_t conn_handle) const { return find(conn_handle) != nullptr; }
+    bool can_send(uint16_t conn_handle) const;
+    uint16_t get_peer_mtu(uint16_t conn_handle) const;
+    size_t channel_count() const;
+    uint16_t get_psm() const { return psm; }
+    uint16_t get_mtu() const { return mtu; }
+
+private:
+    struct Channel {
+        ble_l2cap_chan* chan {nullptr};
+        uint16_t conn_handle {BLE_HS_CONN_HANDLE_NONE};
+        uint16_t peer_mtu {0};
+        bool tx_stalled {false};
+        bool rx_paused {false};       // withheld by the receive callback
+        bool rx_needs_buffer {false}; // the pool was empty, retried from rearm_event
+    };
+
+    // SDU handed over by post_send(): Free -> Filling (claimed by a task) -> Ready (for the host task).
+    struct Handover {
+        enum State : uint8_t { Free, Filling, Ready };
+        std::atomic<uint8_t> state {Free};
+        std::atomic<uint16_t> conn_handle {BLE_HS_CONN_HANDLE_NONE};
+        os_mbuf* sdu {nullptr};
+    };
+
+    static int l2cap_event(ble_l2cap_event* event, void* arg);
+    static void rearm_handler(ble_npl_event* ev);
+    static void handover_handler(ble_npl_event* ev);
+    void send_handovers();
+    int handle_event(ble_l2cap_event& event);
+    int post_receive_buffer(Channel& channel);
+    Channel* find(uint16_t conn_handle);
+    const Channel* find(uint16_t conn_handle) const;
+    Channel* find(const ble_l2cap_chan* chan);
+
+    uint16_t psm;
+    uint16_t mtu;
+    ReceiveCallback receive_callback;
+    EventCallback event_callback;
+    Channel channels[max_channels];
+    Handover handovers[max_channels];
+    ble_npl_event rearm_event;
+    ble_npl_event handover_event;
+};
+
+} // namespace CustomBLE
@@ -0,0 +1,65 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <nimble/nimble_npl.h>
+
+namespace CustomBLE {
+
+class Characteristic;
+
+/**
+ * @brief Intrusive link a Characteristic uses to sit in the pending list.
+ *
+ * Copies start unlinked (pending state belongs to the registered instance).
+ */
+struct NotificationLink {
+    std::atomic<bool> queued {false};
+    Characteristic* next {nullptr};
+
+    NotificationLink() = default;
+    NotificationLink(const NotificationLink&) {}
+    NotificationLink& operator=(const NotificationLink&) { return *this; }
+};
+
+/**
+ * @brief Batches notifications so a burst of updates costs one host task wakeup.
+ *
+ * Any task may call schedule(): the characteristic is pushed onto a lock-free
+ * pending list (at most once until it is sent) and, if no wakeup is pending
+ * yet, a single event is posted to NimBLE's default event queue. The event
+ * handler runs on the host task and sends the current value of every pending
+ * characteristic to its subscribers.
+ */
+class NotificationEngine {
+public:
+    NotificationEngine();
+    ~NotificationEngine();
+    NotificationEngine(const NotificationEngine&) = delete;
+    NotificationEngine& operator=(const NotificationEngine&) = delete;
+
+    /**
+     * @brief Queue a notification of characteristic's current value.
+     */
+    void schedule(Characteristic& characteristic);
+
+    /**
+     * @brief Send all pending notifications now (normally called from the posted event).
+     * @return number of characteristics flushed
+     */
+    size_t flush();
+
+    /**
+     * @brief Number of host task wakeups posted so far.
+     */
+    size_t wakeup_count() const { return wakeups.load(std::memory_order_relaxed); }
+
+private:
+    static void event_handler(ble_npl_event* ev);
+
+    ble_npl_event event;
+    std::atomic<bool> wakeup_posted {false};
+    std::atomic<Characteristic*> pending_head {nullptr};
+    std::atomic<size_t> wakeups {0};
+};
+
+} // namespace CustomBLE
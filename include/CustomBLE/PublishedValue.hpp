@@ -0,0 +1,133 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace CustomBLE {
+
+class Characteristic;
+
+namespace detail {
+void schedule_published_notify(Characteristic* characteristic);
+}
+
+/**
+ * @brief Value shared between one producer task and any number of readers without locks.
+ *
+ * publish() is wait-free; load() always returns a value as a whole, never a
+ * mix of two publishes, and never waits for a producer that was preempted
+ * halfway through a publish. The value is kept twice (a seqcount latch): while
+ * one copy is being written, readers are directed to the other one, so a
+ * reader only retries if a complete publish overlaps its copy.
+ *
+ * Only one task may publish; readers may be on any task (e.g. the NimBLE host
+ * task through Characteristic::from_pointer_read_only(uuid, &published_value)).
+ * T must be trivially copyable.
+ *
+ * @code
+ * static PublishedValue<Imu> imu;
+ * service->add_characteristic(Characteristic::from_pointer_read_only(imu_uuid, &imu, "IMU"));
+ * // sensor task
+ * imu.publish(sample);
+ * @endcode
+ */
+template<typename T>
+class PublishedValue {
+    static_assert(std::is_trivially_copyable_v<T>, "PublishedValue<T> requires a trivially copyable T");
+
+public:
+    PublishedValue() : PublishedValue(T {}) {}
+
+    explicit PublishedValue(const T& initial) {
+        uint32_t words[word_count] = {};
+        std::memcpy(words, &initial, sizeof(T));
+        for (auto& slot : slots) {
+            for (size_t i = 0; i < word_count; ++i) {
+                slot[i].store(words[i], std::memory_order_relaxed);
+            }
+        }
+    }
+
+    PublishedValue(const PublishedValue&) = delete;
+    PublishedValue& operator=(const PublishedValue&) = delete;
+
+    /**
+     * @brief Make value the current one (single producer) and schedule a notification, if enabled.
+     */
+    void publish(const T& value) {
+        uint32_t words[word_count] = {};
+        std::memcpy(words, &value, sizeof(T));
+        uint32_t s = sequence.load(std::memory_order_relaxed);
+        // Odd: readers use slot 1 while slot 0 is written, then even: slot 0 while slot 1 is.
+        sequence.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        store(slots[0], words);
+        sequence.store(s + 2, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_release);
+        store(slots[1], words);
+        Characteristic* target = notify_target.load(std::memory_order_acquire);
+        if (target) {
+            detail::schedule_published_notify(target);
+        }
+    }
+
+    /**
+     * @brief Consistent copy of the last published value. Safe from any task.
+     */
+    T load() const {
+        T value;
+        load(value);
+        return value;
+    }
+
+    void load(T& out) const {
+        uint32_t words[word_count];
+        uint32_t s;
+        do {
+            s = sequence.load(std::memory_order_acquire);
+            const std::atomic<uint32_t>* slot = slots[s & 1];
+            for (size_t i = 0; i < word_count; ++i) {
+                words[i] = slot[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while (sequence.load(std::memory_order_relaxed) != s);
+        std::memcpy(&out, words, sizeof(T));
+    }
+
+    /**
+     * @brief Number of publish() calls so far.
+     */
+    uint32_t version() const { return sequence.load(std::memory_order_acquire) / 2; }
+
+    /**
+     * @brief Call characteristic->schedule_notify() after every publish (nullptr to stop).
+     *
+     * The characteristic must stay registered while set, e.g. the shared_ptr
+     * added to the service.
+     */
+    void set_notify_target(Characteristic* characteristic) {
+        notify_target.store(characteristic, std::memory_order_release);
+    }
+
+private:
+    static constexpr size_t word_count = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    static void store(std::atomic<uint32_t>* slot, const uint32_t* words) {
+        for (size_t i = 0; i < word_count; ++i) {
+            slot[i].store(words[i], std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<uint32_t> sequence {0};
+    std::atomic<uint32_t> slots[2][word_count];
+    std::atomic<Characteristic*> notify_target {nullptr};
+};
+
+template<typename T>
+struct is_published_value : std::false_type {};
+template<typename T>
+struct is_published_value<PublishedValue<T>> : std::true_type {};
+
+} // namespace CustomBLE
@@ -0,0 +1,77 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace CustomBLE {
+
+/**
+ * @brief Last value produced by a read callback, valid for a fixed time.
+ *
+ * The buffer is sized from the first value stored (grown if a later value
+ * is longer, up to the limit) and only filled/served on the NimBLE host task. invalidate() may be called from any task: it bumps a
+ * generation counter, so a value that was being produced concurrently is
+ * not served afterwards either.
+ */
+class ReadCache {
+public:
+    ReadCache() = default;
+    ReadCache(const ReadCache& other) { *this = other; }
+    ReadCache& operator=(const ReadCache& other);
+
+    /**
+     * @brief Cache values of up to limit bytes for ttl_ms milliseconds (ttl_ms > 0).
+     */
+    void enable(uint32_t ttl_ms, size_t limit);
+    void disable();
+    bool enabled() const { return ttl_us != 0; }
+
+    void invalidate() { generation.fetch_add(1, std::memory_order_acq_rel); }
+
+    /**
+     * @brief Cached value if it is still valid at now_us, else nullptr.
+     */
+    const uint8_t* lookup(int64_t now_us, size_t& len) const;
+
+    /**
+     * @brief Generation to pass to store(); take it before producing the value.
+     */
+    uint32_t begin_fill() const { return generation.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Buffer for a value of len bytes, allocated or grown as needed.
+     * @return nullptr if len exceeds the limit (the value is not cached)
+     */
+    uint8_t* reserve(size_t len);
+
+    /**
+     * @brief Mark len bytes in the reserve()d buffer as the cached value produced at now_us.
+     */
+    void store(size_t len, int64_t now_us, uint32_t fill_generation);
+
+    /**
+     * @brief Bytes allocated for the buffer (0 until a value was stored).
+     */
+    size_t get_capacity() const { return capacity; }
+    size_t get_limit() const { return limit; }
+
+    uint32_t get_ttl_ms() const { return ttl_us / 1000; }
+    size_t hit_count() const { return hits; }
+    size_t miss_count() const { return misses; }
+
+private:
+    std::unique_ptr<uint8_t[]> buffer;
+    size_t capacity {0};
+    size_t limit {0};
+    size_t length {0};
+    int64_t ttl_us {0};
+    int64_t expires_us {0};
+    uint32_t stored_generation {0};
+    bool valid {false};
+    std::atomic<uint32_t> generation {0};
+    mutable size_t hits {0};
+    mutable size_t misses {0};
+};
+
+} // namespace CustomBLE
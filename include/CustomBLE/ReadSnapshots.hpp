@@ -0,0 +1,81 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <host/ble_hs.h>
+#include <sdkconfig.h>
+
+namespace CustomBLE {
+
+/**
+ * Time after which an unfinished long read is considered abandoned.
+ */
+#ifdef CONFIG_CUSTOMBLE_LONG_READ_TIMEOUT_MS
+inline constexpr uint32_t long_read_timeout_ms = CONFIG_CUSTOMBLE_LONG_READ_TIMEOUT_MS;
+#else
+inline constexpr uint32_t long_read_timeout_ms = 1000;
+#endif
+
+/**
+ * @brief Per-connection copies of values being read with Read Blob requests.
+ *
+ * NimBLE invokes the access callback for every fragment of a long read and
+ * slices the value by offset itself, without telling the callback the offset.
+ * When a value does not fit into one Read response (ATT_MTU - 1 bytes) the
+ * Characteristic stores it here once and serves the following Read Blob
+ * fragments from the copy, so the read callback runs once and all fragments
+ * come from the same value. ATT requests are sequential per connection, so
+ * one slot per connection suffices; a read of another characteristic, the
+ * last fragment, a timeout or a disconnect release it.
+ *
+ * The callback cannot tell a new Read from a Read Blob either, so a long read
+ * the central abandoned would answer the next Read of the same value on that
+ * connection from the old copy until the timeout. invalidate() (called when
+ * the characteristic notifies, is written or its read cache is invalidated)
+ * marks the copy stale: the next fragment captures the value anew, so a read
+ * never returns a value older than the last change. A long read the value
+ * changes under continues with the new value, as it would without snapshots.
+ *
+ * Static storage, only used from the NimBLE host task, except invalidate().
+ */
+class ReadSnapshots {
+public:
+    struct Snapshot {
+        std::atomic<const void*> owner;
+        std::atomic<bool> stale;
+        uint16_t conn_handle;
+        uint16_t length;
+        uint16_t sent;
+        int64_t started_us;
+        uint8_t data[BLE_ATT_ATTR_MAX_LEN];
+    };
+
+    /**
+     * @brief Snapshot of an unfinished long read of owner on conn_handle, or nullptr.
+     *
+     * Releases the connection's slot if it belongs to another owner, is stale or timed out.
+     */
+    static Snapshot* find(uint16_t conn_handle, const void* owner, int64_t now_us);
+
+    /**
+     * @brief Slot for a new long read on conn_handle, or nullptr if all are taken.
+     */
+    static Snapshot* acquire(uint16_t conn_handle);
+
+    /**
+     * @brief Start serving a long read of owner from snapshot (after filling data and length).
+     */
+    static void capture(Snapshot* snapshot, const void* owner, uint16_t conn_handle, uint16_t sent, int64_t now_us);
+
+    /**
+     * @brief Mark every snapshot of owner stale because its value changed. Safe from any task.
+     */
+    static void invalidate(const void* owner);
+
+    static void release(Snapshot* snapshot);
+    static void drop(uint16_t conn_handle);
+    static void drop_all();
+    static size_t active_count();
+};
+
+} // namespace CustomBLE
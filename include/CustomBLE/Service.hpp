@@ -20,10 +20,29 @@ public:
      * @brief Construct a Service
      * @param name Optional constant string identifying the service (pointer is NOT copied / owned)
      * @param uuid 128-bit UUID of the service
+     * @param arena Optional arena for the characteristic tables (must outlive the service)
+     */
+    Service(const char* name, const ble_uuid128_t& uuid, Arena* arena = nullptr);
+    /**
+     * @return ESP_OK, or ESP_ERR_INVALID_STATE if the service is already frozen (nothing is added)
+     */
+    esp_err_t add_characteristic(std::shared_ptr<Characteristic> characteristic);
+    esp_err_t add_characteristic(Characteristic&& characteristic);
+
+    /**
+     * @brief Lay out the characteristic table once; later adds are rejected.
+     */
+    void freeze() { characteristics_manager.freeze(); }
+    bool is_frozen() const { return characteristics_manager.is_frozen(); }
+
+    /**
+     * @brief Reserve room for count characteristics (avoids regrowing the entry table).
+     */
+    void reserve(size_t count) { characteristics_manager.reserve(count); }
+
+    /**
+     * @brief Service definition for NimBLE (freezes the service).
      */
-    Service(const char* name, const ble_uuid128_t& uuid);
-    void add_characteristic(std::shared_ptr<Characteristic> characteristic);
-    void add_characteristic(Characteristic&& characteristic);
     ble_gatt_svc_def get_svc_def();
     CharacteristicsManager& get_characteristics_manager();
 
@@ -42,6 +61,18 @@ public:
                                            Characteristic::ReadCallback read_cb = nullptr,
                                            Characteristic::WriteCallback write_cb = nullptr);
 
+    /**
+     * @brief Emplace a characteristic using sink-style read and/or view-style write callbacks.
+     */
+    template<typename R, typename W = std::nullptr_t,
+             typename = std::enable_if_t<Characteristic::has_io_callbacks_v<R, W>>>
+    std::shared_ptr<Characteristic> emplace_characteristic(const char* name,
+                                           const ble_uuid128_t& characteristic_uuid,
+                                           R&& read_cb,
+                                           W&& write_cb = nullptr) {
+        return characteristics_manager.emplace_characteristic(name, characteristic_uuid, std::forward<R>(read_cb), std::forward<W>(write_cb));
+    }
+
     /**
      * @brief Generate a string overview of the service and its characteristics.
      */
@@ -55,6 +86,7 @@ public:
      * @brief Return pointer to the internal 128-bit UUID value
      */
     const ble_uuid128_t* get_uuid() const { return &service_uuid; }
+    const char* get_name() const { return name; }
 };
 
 } // namespace CustomBLE
@@ -5,30 +5,93 @@
 #include <vector>
 #include <memory>
 #include <cstddef>
-#include <deque>
 #include <esp_ble_conn_mgr.h>
+#include <host/ble_gap.h>
+#include "CustomBLE/AdvertisingBuilder.hpp"
+#include "CustomBLE/NotificationEngine.hpp"
 
 namespace CustomBLE {
 
 class ServiceManager {
 private:
-    std::vector<std::shared_ptr<Service>> services;
-    std::vector<ble_gatt_svc_def> svc_defs;
+    Arena* arena;
+    ArenaVector<std::shared_ptr<Service>> services;
+    ArenaVector<ble_gatt_svc_def> svc_defs;
+    bool frozen {false};
     std::vector<uint8_t> adv_data; // persistent buffer used when populating advertising data
-    std::vector<std::vector<esp_ble_conn_character_t>> conn_mgr_characteristics;
-    std::vector<esp_ble_conn_svc_t> conn_mgr_services;
-    std::deque<std::string> generated_characteristic_names;
+    ArenaVector<ArenaVector<esp_ble_conn_character_t>> conn_mgr_characteristics;
+    ArenaVector<esp_ble_conn_svc_t> conn_mgr_services;
+    // Connection manager bindings: for every characteristic a ConnMgrBinding
+    // followed by its NUL-terminated name; the name pointer is the uuid_fn priv_data.
+    // priv_data is resolved through find_conn_mgr_binding(), never by reading in front of it.
+    ArenaVector<char> conn_mgr_bindings;
+    // Managers registered with the connection manager, linked through next_conn_mgr.
+    static ServiceManager* conn_mgr_managers;
+    ServiceManager* next_conn_mgr {nullptr};
+    bool conn_mgr_linked {false};
+    // Reusable buffer read values are rendered into before being handed to the connection manager,
+    // sized to the largest conn_mgr_read_limit(); longer values are refused, never allocated.
+    ArenaVector<uint8_t> conn_mgr_read_buffer;
+    NotificationEngine notification_engine;
+    // Lookup indexes: handle_index[value_handle - handle_base], and an open
+    // addressing hash table of the characteristics by UUID (power-of-two size).
+    ArenaVector<Characteristic*> handle_index;
+    ArenaVector<Characteristic*> uuid_index;
+    uint16_t handle_base {0};
+#ifdef CONFIG_CUSTOMBLE_ACCESS_STATS
+    uint16_t diagnostic_selection {0}; // value handle reported by the diagnostic service, 0 = all
+#endif
 
 public:
-    void add_service(std::shared_ptr<Service> service);
+    ServiceManager() : ServiceManager(nullptr) {}
+
+    /**
+     * @brief Manager keeping all GATT metadata in one arena.
+     *
+     * Services created with emplace_service(), their characteristics
+     * (emplace_characteristic / add_characteristic(Characteristic&&)),
+     * descriptor arrays, chr_defs, svc_defs and the connection manager tables
+     * are allocated from the arena, which must outlive the manager and every
+     * shared_ptr handed out. Size it with required() from a dry run against a
+     * measuring Arena; see Arena.
+     */
+    explicit ServiceManager(Arena* arena);
+    ~ServiceManager();
+    ServiceManager(const ServiceManager&) = delete;
+    ServiceManager& operator=(const ServiceManager&) = delete;
+    Arena* get_arena() const { return arena; }
+
+    /**
+     * @brief Reserve room for count services (avoids regrowing the service table).
+     */
+    void reserve(size_t count) { services.reserve(count); }
+
+    /**
+     * @return ESP_OK, or ESP_ERR_INVALID_STATE if the GATT table is already frozen (nothing is added)
+     */
+    esp_err_t add_service(std::shared_ptr<Service> service);
 
     /**
      * @brief Emplace a new service inline (constructs and adds).
      * @param uuid UUID of the service
-     * @return Shared pointer to the newly added Service
+     * @return Shared pointer to the newly added Service (nullptr if the GATT table is frozen)
      */
     std::shared_ptr<Service> emplace_service(const ble_uuid128_t& uuid) __attribute__((deprecated("Use emplace_service(const char*, const ble_uuid128_t&)")));
     std::shared_ptr<Service> emplace_service(const char* name, const ble_uuid128_t& uuid);
+    /**
+     * @brief Lay out all service and characteristic definitions once, with exact sizes.
+     *
+     * Called automatically by get_svc_defs(), add_services_to_nimble() and
+     * register_with_conn_mgr(); calling it again is a no-op. Afterwards the
+     * tables are returned as built and adding services or characteristics is
+     * rejected with ESP_ERR_INVALID_STATE (logged).
+     */
+    void freeze();
+    bool is_frozen() const { return frozen; }
+
+    /**
+     * @brief Service definitions for NimBLE (freezes the manager).
+     */
     ble_gatt_svc_def* get_svc_defs();
     size_t size() const;
 
@@ -43,7 +106,104 @@ public:
      * @return 0 on success, error code otherwise
      */
     int add_services_to_nimble(const char* tag = "CustomBLE");
+
+    /**
+     * @brief Add a fixed GATT table (e.g. built with StaticGatt, see StaticGattTable.hpp) to NimBLE.
+     *
+     * Same registration path as above, without any ServiceManager state: the
+     * table is handed to NimBLE as is and must outlive the stack.
+     * @param svcs Service array terminated by a BLE_GATT_SVC_TYPE_END entry
+     */
+    static int add_services_to_nimble(const ble_gatt_svc_def* svcs, const char* tag = "CustomBLE");
+
+    /**
+     * @brief Add all services to the connection manager.
+     *
+     * Callbacks are resolved from the name pointer handed out here (an address
+     * range check); a connection manager that passes a copy of the name is
+     * served by a name search over the registered managers. Several managers
+     * may be registered; call this before esp_ble_conn_start() and keep the
+     * manager alive while the connection manager runs.
+     */
     esp_err_t register_with_conn_mgr();
+
+    /**
+     * @brief Track subscriptions from NimBLE GAP events.
+     *
+     * Forward every event of the application's ble_gap_event_fn here (or pass
+     * gap_event_callback with this manager as arg). SUBSCRIBE events update the
+     * characteristic's subscriber table; DISCONNECT drops the connection everywhere.
+     * @return 0 (never consumes the event)
+     */
+    int handle_gap_event(struct ble_gap_event* event);
+    static int gap_event_callback(struct ble_gap_event* event, void* arg);
+
+    /**
+     * @brief Record a CCCD change for the characteristic whose value handle is attr_handle.
+     */
+    void on_subscribe(uint16_t conn_handle, uint16_t attr_handle, bool notify, bool indicate);
+    void on_disconnect(uint16_t conn_handle);
+
+    /**
+     * @brief Characteristic whose value handle is value_handle, or nullptr.
+     *
+     * Constant time through a table indexed by handle. Handles are assigned
+     * when the GATT server starts, so the table is built by the first lookup
+     * after that (GAP events arrive on the host task); call index_handles()
+     * once the host synced to build it up front.
+     */
+    Characteristic* find_by_value_handle(uint16_t value_handle);
+
+    /**
+     * @brief Characteristic with this UUID, or nullptr (the first registered one if several share it).
+     * Constant time through a hash table built by freeze().
+     */
+    Characteristic* find_by_uuid(const ble_uuid128_t& uuid) const;
+
+    /**
+     * @brief Build the value handle index.
+     *
+     * Characteristics registered through the connection manager get their
+     * handle here, looked up with ble_gatts_find_chr(); call this after
+     * esp_ble_conn_start() for them.
+     * @return number of characteristics with a value handle
+     */
+    size_t index_handles();
+
+    /**
+     * @brief Schedule a notification for every characteristic with subscribers.
+     *
+     * All of them are sent in a single host task wakeup.
+     * @return number of characteristics scheduled
+     */
+    size_t notify_all();
+
+    /**
+     * @brief Send all pending notifications now instead of waiting for the host task.
+     * @return number of characteristics flushed
+     */
+    size_t flush_notifications();
+    NotificationEngine& get_notification_engine() { return notification_engine; }
+
+#ifdef CONFIG_CUSTOMBLE_ACCESS_STATS
+    /**
+     * @brief Access statistics summed over all characteristics.
+     */
+    AccessStats get_access_stats() const;
+    void reset_access_stats();
+
+    /**
+     * @brief Add a diagnostic service exposing the access statistics over GATT.
+     *
+     * The service has two characteristics whose UUIDs are service_uuid with
+     * the 16-bit alias (bytes 12..13) incremented by 1 and 2:
+     *   - "Stats select" (write): value handle (uint16) of the characteristic to report, 0 for all
+     *   - "Stats" (read): uint16 handle, uint32 reads, writes, bytes_in, bytes_out, errors and
+     *     LatencyHistogram::bucket_count uint32 bucket counts, all little endian
+     * @return The service, or nullptr if the GATT table is frozen
+     */
+    std::shared_ptr<Service> emplace_diagnostic_service(const ble_uuid128_t& service_uuid);
+#endif
     
     /**
      * @brief Generate a string overview of all services.
@@ -54,22 +214,87 @@ public:
      * @brief Print the overview using printf().
      */
     void print() const;
+
+    /**
+     * @brief Bytes of GATT metadata held by this manager, its services and characteristics.
+     *
+     * Container sizes are capacities, not lengths. Objects are counted by
+     * sizeof; allocator and shared_ptr control block overhead is not included.
+     */
+    struct MemoryUsage {
+        size_t objects {0};          // Service and Characteristic objects, characteristic extensions
+        size_t callbacks {0};        // inline callback storage (part of objects)
+        size_t descriptors {0};      // descriptor arrays (user description + end marker)
+        size_t tables {0};           // service list, characteristic entries, chr_defs, svc_defs and lookup indexes
+        size_t conn_mgr {0};         // connection manager mirrors, bindings/names and read buffer
+        size_t advertising {0};      // advertising data buffer
+        size_t buffers {0};          // read caches and per-connection write buffers
+        size_t heap_bytes {0};       // part of the total held in heap blocks (the rest is in the arena)
+        size_t heap_allocations {0}; // live heap blocks, arena memory excluded
+
+        size_t total() const { return objects + descriptors + tables + conn_mgr + advertising + buffers; }
+    };
+    MemoryUsage memory_usage() const;
+
+    /**
+     * @brief Per-service and per-characteristic breakdown of memory_usage() as text.
+     */
+    std::string memory_report() const;
 public:
     /**
      * @brief Populate the provided esp_ble_conn_config_t with advertisement bytes
-     * that announce registered services (supports 128-bit UUIDs).
-     * This fills the internal adv_data buffer so the pointer remains valid
-     * after the call.
+     * that announce registered services.
+     *
+     * Built by AdvertisingBuilder in extended mode: flags, the service UUIDs in
+     * registration order (an incomplete list if they do not all fit) and
+     * config.device_name. The periodic advertising data is built in a second
+     * pass without the flags. Without services, the periodic data is cleared
+     * (nullptr) and the extended data left as it was. This fills the internal
+     * adv_data buffer so the pointers remain valid after the call.
      */
     void populate_adv_data(esp_ble_conn_config_t &config);
+
+    /**
+     * @brief Add the UUID of every service to builder, in registration order.
+     *
+     * Add the UUIDs that must reach the primary advertising packet before
+     * calling this; UUIDs already added keep their place.
+     * @return 0, or BLE_HS_ENOMEM if the builder is full (the remaining services are left out)
+     */
+    int add_service_uuids(AdvertisingBuilder& builder) const;
 private:
+    struct ConnMgrBinding {
+        Characteristic* characteristic;
+        ServiceManager* manager;
+        const char* name;  // the name stored right behind this binding
+    };
+
+    /**
+     * @brief Binding whose name is priv_data: by address if it points into a
+     * manager's binding block, otherwise by comparing the names.
+     */
+    static bool find_conn_mgr_binding(const char* name, ConnMgrBinding& binding);
+
+    /**
+     * @brief Longest value a connection manager read of characteristic returns (compressed values may grow).
+     */
+    static size_t conn_mgr_read_limit(const Characteristic& characteristic);
+
     static esp_err_t ble_conn_access_cb(const uint8_t *inbuf,
                                         uint16_t inlen,
                                         uint8_t **outbuf,
                                         uint16_t *outlen,
                                         void *priv_data,
                                         uint8_t *att_status);
-    void update_svc_defs();
+    static esp_err_t conn_mgr_access(const ConnMgrBinding& binding,
+                                     const uint8_t *inbuf,
+                                     uint16_t inlen,
+                                     uint8_t **outbuf,
+                                     uint16_t *outlen,
+                                     uint8_t *att_status);
+    void attach_characteristics();
+    MemoryUsage collect_memory_usage(std::string* report) const;
+    void index_uuids();
 };
 
 } // namespace CustomBLE
@@ -0,0 +1,211 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <host/ble_gatt.h>
+#include <host/ble_hs.h>
+#include <host/ble_uuid.h>
+#include "CustomBLE/ValueReader.hpp"
+#include "CustomBLE/ValueWriter.hpp"
+
+namespace CustomBLE {
+
+/**
+ * @brief Compile-time GATT table builder.
+ *
+ * Builds ble_gatt_svc_def / ble_gatt_chr_def / ble_gatt_dsc_def arrays as
+ * constexpr data, so a fixed GATT layout lives in .rodata (flash) and costs
+ * no heap at boot. Access callbacks are bound at compile time: either to a
+ * value of type T (like Characteristic::from_pointer_*) or to plain
+ * functions taking a ValueWriter / ValueReader. Register the result with
+ * ServiceManager::add_services_to_nimble(table.data()).
+ *
+ * @code
+ * static float speed;
+ * static uint16_t speed_handle;
+ * static constexpr ble_uuid128_t svc_uuid = BLE_UUID128_INIT(...);
+ * static constexpr ble_uuid128_t speed_uuid = BLE_UUID128_INIT(...);
+ * static constexpr auto speed_desc = StaticGatt::user_description("Speed");
+ * static constexpr auto chrs = StaticGatt::characteristics(
+ *     StaticGatt::pointer_read_write(speed_uuid, &speed, &speed_handle, speed_desc.data()));
+ * static constexpr auto svcs = StaticGatt::services(StaticGatt::primary_service(svc_uuid, chrs.data()));
+ * @endcode
+ *
+ * Objects referenced from the table (values, handles, UUIDs, descriptor
+ * arrays) must have static storage duration.
+ */
+namespace StaticGatt {
+
+using ReadFunction = int (*)(ValueWriter&);
+using WriteFunction = int (*)(ValueReader&);
+
+namespace detail {
+
+template<typename T>
+int pointer_access(uint16_t, uint16_t, ble_gatt_access_ctxt* ctxt, void* arg) {
+    T* value = static_cast<T*>(arg);
+    switch (ctxt->op) {
+        case BLE_GATT_ACCESS_OP_READ_CHR:
+            return os_mbuf_append(ctxt->om, value, sizeof(T)) == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+        case BLE_GATT_ACCESS_OP_WRITE_CHR:
+            if (OS_MBUF_PKTLEN(ctxt->om) != sizeof(T)) {
+                return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+            }
+            return os_mbuf_copydata(ctxt->om, 0, sizeof(T), value) == 0 ? 0 : BLE_ATT_ERR_UNLIKELY;
+        default:
+            return BLE_ATT_ERR_UNLIKELY;
+    }
+}
+
+template<ReadFunction Read, WriteFunction Write>
+int function_access(uint16_t, uint16_t, ble_gatt_access_ctxt* ctxt, void*) {
+    switch (ctxt->op) {
+        case BLE_GATT_ACCESS_OP_READ_CHR:
+            if constexpr (Read != nullptr) {
+                ValueWriter writer(ctxt->om);
+                return Read(writer);
+            }
+            break;
+        case BLE_GATT_ACCESS_OP_WRITE_CHR:
+            if constexpr (Write != nullptr) {
+                ValueReader reader(ctxt->om);
+                return Write(reader);
+            }
+            break;
+        default:
+            break;
+    }
+    return BLE_ATT_ERR_UNLIKELY;
+}
+
+inline int user_description_access(uint16_t, uint16_t, ble_gatt_access_ctxt* ctxt, void* arg) {
+    const char* desc = static_cast<const char*>(arg);
+    size_t len = 0;
+    while (desc[len]) {
+        ++len;
+    }
+    return os_mbuf_append(ctxt->om, desc, static_cast<uint16_t>(len)) == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
+
+inline constexpr ble_uuid16_t user_description_uuid = BLE_UUID16_INIT(0x2901);
+
+// NimBLE declares ble_gatt_chr_def::descriptors non-const but never writes through it.
+constexpr ble_gatt_dsc_def* mutable_descriptors(const ble_gatt_dsc_def* descriptors) {
+    return const_cast<ble_gatt_dsc_def*>(descriptors);
+}
+
+constexpr uint16_t with_notify(uint16_t flags) {
+    // Same rule as Characteristic: readable characteristics may notify.
+    return (flags & BLE_GATT_CHR_F_READ) ? static_cast<uint16_t>(flags | BLE_GATT_CHR_F_NOTIFY) : flags;
+}
+
+} // namespace detail
+
+/**
+ * @brief Read-only User Description descriptor (UUID 0x2901) plus end marker.
+ */
+constexpr std::array<ble_gatt_dsc_def, 2> user_description(const char* name) {
+    std::array<ble_gatt_dsc_def, 2> descriptors {};
+    descriptors[0].uuid = &detail::user_description_uuid.u;
+    descriptors[0].att_flags = BLE_ATT_F_READ;
+    descriptors[0].access_cb = &detail::user_description_access;
+    descriptors[0].arg = const_cast<char*>(name);
+    return descriptors;
+}
+
+/**
+ * @brief Characteristic with an explicit access callback and argument.
+ */
+constexpr ble_gatt_chr_def characteristic(const ble_uuid128_t& uuid, ble_gatt_access_fn* access_cb, void* arg,
+                                          uint16_t flags, uint16_t* val_handle = nullptr,
+                                          const ble_gatt_dsc_def* descriptors = nullptr) {
+    ble_gatt_chr_def chr {};
+    chr.uuid = &uuid.u;
+    chr.access_cb = access_cb;
+    chr.arg = arg;
+    chr.descriptors = detail::mutable_descriptors(descriptors);
+    chr.flags = flags;
+    chr.val_handle = val_handle;
+    return chr;
+}
+
+/**
+ * @brief Characteristic exposing the sizeof(T) bytes at value (read/notify).
+ */
+template<typename T>
+constexpr ble_gatt_chr_def pointer_read_only(const ble_uuid128_t& uuid, T* value, uint16_t* val_handle = nullptr,
+                                             const ble_gatt_dsc_def* descriptors = nullptr) {
+    static_assert(std::is_trivially_copyable_v<T>, "Pointer characteristics need a trivially copyable value");
+    return characteristic(uuid, &detail::pointer_access<T>, value,
+                          detail::with_notify(BLE_GATT_CHR_F_READ), val_handle, descriptors);
+}
+
+/**
+ * @brief Characteristic reading and writing the sizeof(T) bytes at value.
+ * Writes of any other length are rejected with BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN.
+ */
+template<typename T>
+constexpr ble_gatt_chr_def pointer_read_write(const ble_uuid128_t& uuid, T* value, uint16_t* val_handle = nullptr,
+                                              const ble_gatt_dsc_def* descriptors = nullptr) {
+    static_assert(std::is_trivially_copyable_v<T>, "Pointer characteristics need a trivially copyable value");
+    return characteristic(uuid, &detail::pointer_access<T>, value,
+                          detail::with_notify(BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE), val_handle, descriptors);
+}
+
+/**
+ * @brief Characteristic only writing the sizeof(T) bytes at value.
+ */
+template<typename T>
+constexpr ble_gatt_chr_def pointer_write_only(const ble_uuid128_t& uuid, T* value, uint16_t* val_handle = nullptr,
+                                              const ble_gatt_dsc_def* descriptors = nullptr) {
+    static_assert(std::is_trivially_copyable_v<T>, "Pointer characteristics need a trivially copyable value");
+    return characteristic(uuid, &detail::pointer_access<T>, value, BLE_GATT_CHR_F_WRITE, val_handle, descriptors);
+}
+
+/**
+ * @brief Characteristic bound to sink/view-style functions (either may be nullptr).
+ *
+ * Usage: StaticGatt::functions<&read_temperature, &write_setpoint>(uuid, &handle)
+ */
+template<ReadFunction Read, WriteFunction Write = nullptr>
+constexpr ble_gatt_chr_def functions(const ble_uuid128_t& uuid, uint16_t* val_handle = nullptr,
+                                     const ble_gatt_dsc_def* descriptors = nullptr) {
+    static_assert(Read != nullptr || Write != nullptr, "Bind at least a read or a write function");
+    uint16_t flags = 0;
+    if (Read != nullptr) {
+        flags |= BLE_GATT_CHR_F_READ;
+    }
+    if (Write != nullptr) {
+        flags |= BLE_GATT_CHR_F_WRITE;
+    }
+    return characteristic(uuid, &detail::function_access<Read, Write>, nullptr,
+                          detail::with_notify(flags), val_handle, descriptors);
+}
+
+/**
+ * @brief Characteristic array terminated by the end marker NimBLE expects.
+ */
+template<typename... Chrs>
+constexpr std::array<ble_gatt_chr_def, sizeof...(Chrs) + 1> characteristics(const Chrs&... chrs) {
+    return {{chrs..., ble_gatt_chr_def {}}};
+}
+
+constexpr ble_gatt_svc_def primary_service(const ble_uuid128_t& uuid, const ble_gatt_chr_def* characteristics) {
+    ble_gatt_svc_def svc {};
+    svc.type = BLE_GATT_SVC_TYPE_PRIMARY;
+    svc.uuid = &uuid.u;
+    svc.characteristics = characteristics;
+    return svc;
+}
+
+/**
+ * @brief Service array terminated by the end marker NimBLE expects.
+ */
+template<typename... Svcs>
+constexpr std::array<ble_gatt_svc_def, sizeof...(Svcs) + 1> services(const Svcs&... svcs) {
+    return {{svcs..., ble_gatt_svc_def {}}};
+}
+
+} // namespace StaticGatt
+} // namespace CustomBLE
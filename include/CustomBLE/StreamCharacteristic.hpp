@@ -0,0 +1,150 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <nimble/nimble_npl.h>
+#include "CustomBLE/Characteristic.hpp"
+#include "CustomBLE/Compression.hpp"
+#include "CustomBLE/InlineFunction.hpp"
+
+namespace CustomBLE {
+
+/**
+ * @brief Bulk transfer characteristic: pushes a byte stream as notifications with credit-based flow control.
+ *
+ * The application supplies a producer that fills a buffer with the bytes at
+ * a given stream offset. Once a central has subscribed and written START,
+ * the stream is cut into packets of ATT_MTU - 5 payload bytes and notified
+ * to that central, each prefixed with a 16-bit sequence number (little
+ * endian, 0 at START). One packet is sent per credit; the central grants
+ * credits with START and ACK. A header-only packet marks the end of the
+ * stream.
+ *
+ * Control writes (all integers little endian):
+ *   - START 0x01, offset u32, credits u16: (re)start at offset, e.g. the last
+ *     acknowledged offset after a reconnect
+ *   - ACK   0x02, offset u32, credits u16: bytes before offset were received;
+ *     grants credits more packets
+ *   - STOP  0x03
+ * Reads return the status: state u8 (StreamCharacteristic::State), offset
+ * u32 (next byte to send), acknowledged u32, credits u16, sequence u16.
+ *
+ * Packets are sent from an event on NimBLE's default event queue, at most
+ * burst_packets per host task wakeup, and only while the streaming central
+ * has notifications enabled (forward GAP events to the ServiceManager):
+ * START without a subscription fails with cccd_improperly_configured, and
+ * unsubscribing stops the stream. When NimBLE runs out of buffers the next
+ * attempt is made retry_delay_ms later instead of spinning on the host task.
+ * One central streams at a time; START from another connection is rejected
+ * while the stream is active. Control
+ * and status are GATT only (not through the connection manager), and
+ * notify()/notify_all() send nothing for a stream. Create with create() and
+ * add the shared_ptr to a Service.
+ *
+ * With an encoder (set_encoder()) every packet after the sequence number is
+ * one LZ4 block linked to the previous ones (see LzStreamEncoder), filled
+ * with as much data as compresses into it. Offsets (START, ACK, status,
+ * producer) stay positions in the uncompressed stream, and the central
+ * starts a new decoder with every START.
+ */
+class StreamCharacteristic : public Characteristic {
+private:
+    struct Token {};
+
+public:
+    /**
+     * @brief Fill buffer with up to capacity bytes starting at stream offset.
+     *
+     * buffer is the outgoing mbuf (or the encoder's window), so a packet
+     * spanning several mbuf segments takes several calls.
+     * @return number of bytes written, 0 if no data is available yet (call
+     *         wake() once there is), or end_of_stream
+     */
+    using Producer = InlineFunction<int(uint32_t offset, uint8_t* buffer, size_t capacity)>;
+    /**
+     * @brief Called when the central acknowledges all bytes before offset (they may be discarded).
+     */
+    using AckCallback = InlineFunction<void(uint32_t offset)>;
+
+    static constexpr int end_of_stream = -1;
+    static constexpr size_t header_size = 2;
+    static constexpr size_t burst_packets = 8;
+    static constexpr uint32_t retry_delay_ms = 10;
+    // Common profile error code (Core Specification Supplement, part B).
+    static constexpr int cccd_improperly_configured = 0xFD;
+
+    enum class State : uint8_t {
+        Idle = 0,
+        Streaming = 1,
+        Waiting = 2,  // producer had no data; wake() continues
+        Finished = 3,
+    };
+
+    enum Command : uint8_t {
+        CommandStart = 0x01,
+        CommandAck = 0x02,
+        CommandStop = 0x03,
+    };
+
+    static std::shared_ptr<StreamCharacteristic> create(const char* name, const ble_uuid128_t& uuid, Producer producer);
+
+    StreamCharacteristic(Token, const char* name, const ble_uuid128_t& uuid, Producer producer);
+    ~StreamCharacteristic();
+    StreamCharacteristic(const StreamCharacteristic&) = delete;
+    StreamCharacteristic& operator=(const StreamCharacteristic&) = delete;
+
+    void set_ack_callback(AckCallback callback) { ack_callback = std::move(callback); }
+
+    /**
+     * @brief Compress the stream with encoder (nullptr: plain). Set before registration.
+     *
+     * The encoder is owned by the caller and used from the host task only
+     * while this stream exists. The characteristic gets a Compression
+     * descriptor (mode Characteristic::CompressStream).
+     */
+    void set_encoder(LzStreamEncoder* encoder);
+
+    /**
+     * @brief Continue a stream waiting for data. Safe from any task.
+     */
+    void wake();
+
+    /**
+     * @brief Send the next burst of packets now (normally run from the posted event).
+     * @return number of packets sent
+     */
+    size_t pump();
+
+    State get_state() const { return state; }
+    uint32_t get_offset() const { return offset; }
+    uint32_t get_acknowledged() const { return acknowledged; }
+    uint16_t get_credits() const { return credits; }
+    uint16_t get_stream_conn_handle() const { return conn_handle; }
+
+private:
+    static void event_handler(ble_npl_event* ev);
+    int handle_control(ValueReader& in);
+    int write_status(ValueWriter& out) const;
+    void post();
+    /**
+     * @brief Append the payload of the next packet (at most capacity bytes) to om.
+     * @return stream bytes consumed, 0 (no data yet), end_of_stream, or a negative error
+     */
+    int produce(os_mbuf* om, size_t capacity);
+    int produce_compressed(os_mbuf* om, size_t capacity);
+
+    Producer producer;
+    AckCallback ack_callback;
+    LzStreamEncoder* encoder {nullptr};
+    size_t raw_chunk {0};  // uncompressed bytes expected to fill a packet
+    ble_npl_event event;
+    ble_npl_callout retry;  // out of buffers: pump again after retry_delay_ms
+    State state {State::Idle};
+    uint16_t conn_handle {BLE_HS_CONN_HANDLE_NONE};
+    uint32_t offset {0};
+    uint32_t acknowledged {0};
+    uint16_t credits {0};
+    uint16_t sequence {0};
+};
+
+} // namespace CustomBLE
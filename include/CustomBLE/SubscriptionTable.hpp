@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <sdkconfig.h>
+
+namespace CustomBLE {
+
+/**
+ * Maximum number of simultaneously subscribed connections per characteristic.
+ */
+#ifdef CONFIG_BT_NIMBLE_MAX_CONNECTIONS
+inline constexpr size_t max_subscribers = CONFIG_BT_NIMBLE_MAX_CONNECTIONS;
+#else
+inline constexpr size_t max_subscribers = 4;
+#endif
+
+/**
+ * @brief Per-characteristic CCCD state of every connected central.
+ *
+ * Updated from GAP subscribe/disconnect events on the NimBLE host task and
+ * read lock-free from any task that sends notifications. Copies start empty:
+ * subscriptions belong to a registered characteristic instance, not its value.
+ */
+class SubscriptionTable {
+public:
+    struct Subscriber {
+        uint16_t conn_handle;
+        bool notify;
+        bool indicate;
+    };
+
+    SubscriptionTable();
+    SubscriptionTable(const SubscriptionTable&) : SubscriptionTable() {}
+    SubscriptionTable& operator=(const SubscriptionTable&) { return *this; }
+
+    /**
+     * @brief Record the CCCD state of a connection (both false removes it).
+     * @return false if the table is full
+     */
+    bool update(uint16_t conn_handle, bool notify, bool indicate);
+    void remove(uint16_t conn_handle);
+    void clear();
+
+    size_t count() const;
+    bool empty() const { return count() == 0; }
+
+    /**
+     * @brief True if conn_handle enabled notifications.
+     */
+    bool notifies(uint16_t conn_handle) const;
+
+    /**
+     * @brief Copy the current subscribers to out.
+     * @return number of subscribers written
+     */
+    size_t snapshot(Subscriber* out, size_t capacity) const;
+
+private:
+    // Encoded as ((conn_handle + 1) << 2) | (indicate << 1) | notify; 0 marks a free slot.
+    std::atomic<uint32_t> slots[max_subscribers];
+};
+
+} // namespace CustomBLE
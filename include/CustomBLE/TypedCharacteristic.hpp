@@ -0,0 +1,113 @@
+#pragma once
+#include <type_traits>
+#include <utility>
+#include "CustomBLE/Characteristic.hpp"
+#include "CustomBLE/WireFormat.hpp"
+
+namespace CustomBLE {
+
+enum class TypedAccess {
+    ReadOnly,
+    ReadWrite,
+    WriteOnly,
+};
+
+/**
+ * @brief Characteristic whose value is a T with a fixed little-endian wire encoding (see WireCodec).
+ *
+ * Reads encode T into a stack buffer of wire_size bytes and append it to the
+ * response; writes must carry exactly wire_size bytes and are decoded into a
+ * T. Nothing is allocated and no padding or host byte order reaches the air.
+ * The maximum length is set to wire_size. The class adds no members, so it
+ * can be passed to Service::add_characteristic() by value or as shared_ptr.
+ *
+ * @code
+ * static Reading reading;
+ * service->add_characteristic(TypedCharacteristic<Reading>("Reading", uuid, &reading, TypedAccess::ReadOnly));
+ * service->add_characteristic(TypedCharacteristic<uint16_t>("Setpoint", uuid2,
+ *     []() { return setpoint; },
+ *     [](const uint16_t& value) { setpoint = value; return 0; }));
+ * @endcode
+ */
+template<typename T>
+class TypedCharacteristic : public Characteristic {
+public:
+    static constexpr size_t wire_size = WireCodec<T>::size;
+    static_assert(wire_size <= BLE_ATT_ATTR_MAX_LEN, "Wire encoding longer than the maximum attribute length");
+
+    /**
+     * @brief Characteristic bound to *value (not owned; must outlive the characteristic).
+     */
+    TypedCharacteristic(const char* name, const ble_uuid128_t& characteristic_uuid, T* value,
+                        TypedAccess access = TypedAccess::ReadWrite)
+        : Characteristic(name, characteristic_uuid, ReadCallback(), WriteCallback()) {
+        if (access != TypedAccess::WriteOnly) {
+            set_read_sink_callback([value](ValueWriter& out) { return encode(*value, out); });
+        }
+        if (access != TypedAccess::ReadOnly) {
+            set_write_view_callback([value](ValueReader& in) { return decode(in, *value); });
+        }
+        set_max_length(wire_size);
+    }
+
+    /**
+     * @brief Characteristic bound to functions (either may be nullptr).
+     * @param read_fn Callable returning T
+     * @param write_fn Callable taking const T& and returning 0 or a BLE_ATT_ERR_* code
+     */
+    template<typename R, typename W = std::nullptr_t,
+             typename = std::enable_if_t<!std::is_convertible_v<R, T*> || std::is_same_v<std::decay_t<R>, std::nullptr_t>>>
+    TypedCharacteristic(const char* name, const ble_uuid128_t& characteristic_uuid, R&& read_fn, W&& write_fn = nullptr)
+        : Characteristic(name, characteristic_uuid, ReadCallback(), WriteCallback()) {
+        if constexpr (!std::is_same_v<std::decay_t<R>, std::nullptr_t>) {
+            static_assert(std::is_invocable_r_v<T, std::decay_t<R>&>, "Read function must return T");
+            set_read_sink_callback([read_fn = std::forward<R>(read_fn)](ValueWriter& out) {
+                return encode(read_fn(), out);
+            });
+        }
+        if constexpr (!std::is_same_v<std::decay_t<W>, std::nullptr_t>) {
+            static_assert(std::is_invocable_r_v<int, std::decay_t<W>&, const T&>, "Write function must take const T& and return int");
+            set_write_view_callback([write_fn = std::forward<W>(write_fn)](ValueReader& in) {
+                T value {};
+                int rc = decode(in, value);
+                return rc == 0 ? write_fn(static_cast<const T&>(value)) : rc;
+            });
+        }
+        set_max_length(wire_size);
+    }
+
+    using Characteristic::notify;
+
+    /**
+     * @brief Notify subscribers with value instead of the read function's result.
+     */
+    int notify(const T& value) {
+        uint8_t buffer[wire_size];
+        WireCodec<T>::encode(value, buffer);
+        return Characteristic::notify(buffer, wire_size);
+    }
+
+    static int encode(const T& value, ValueWriter& out) {
+        uint8_t buffer[wire_size];
+        WireCodec<T>::encode(value, buffer);
+        return out.append(buffer, wire_size);
+    }
+
+    /**
+     * @return 0, or BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN unless exactly wire_size bytes were written
+     */
+    static int decode(ValueReader& in, T& value) {
+        if (in.size() != wire_size) {
+            return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+        }
+        uint8_t buffer[wire_size];
+        int rc = in.copy_to(buffer, wire_size);
+        if (rc != 0) {
+            return rc;
+        }
+        WireCodec<T>::decode(buffer, value);
+        return 0;
+    }
+};
+
+} // namespace CustomBLE
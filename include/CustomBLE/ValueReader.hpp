@@ -0,0 +1,71 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include <host/ble_hs.h>
+
+namespace CustomBLE {
+
+/**
+ * @brief Non-owning view of a value being written, handed to write callbacks.
+ *
+ * During a GATT write the reader wraps the received os_mbuf chain without
+ * copying it. copy_to() copies straight from the chain into the destination;
+ * view() is free for single-segment chains and otherwise flattens once into a
+ * static scratch buffer shared by all characteristics (GATT accesses are
+ * serialized on the NimBLE host task). Views are only valid until the write
+ * callback returns.
+ */
+class ValueReader {
+public:
+    explicit ValueReader(const os_mbuf* om);
+    ValueReader(const uint8_t* data, size_t len);
+
+    /**
+     * @brief Total number of bytes written by the peer.
+     */
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+
+    /**
+     * @brief Copy len bytes starting at offset into dst.
+     * @return 0 on success, BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN if the value is too short
+     */
+    int copy_to(void* dst, size_t len, size_t offset = 0) const;
+
+    /**
+     * @brief Contiguous view of the whole value (see class notes for lifetime).
+     */
+    std::string_view view() const;
+
+    /**
+     * @brief Copy the value into a new std::string.
+     */
+    std::string to_string() const;
+
+    /**
+     * @brief Invoke f(const uint8_t* data, size_t len) for every non-empty segment, in order.
+     */
+    template<typename F>
+    void for_each_segment(F&& f) const {
+        if (!om) {
+            if (length) {
+                f(flat, length);
+            }
+            return;
+        }
+        for (const os_mbuf* m = om; m; m = SLIST_NEXT(m, om_next)) {
+            if (m->om_len) {
+                f(static_cast<const uint8_t*>(m->om_data), static_cast<size_t>(m->om_len));
+            }
+        }
+    }
+
+private:
+    const os_mbuf* om {nullptr};
+    const uint8_t* flat {nullptr};
+    size_t length {0};
+};
+
+} // namespace CustomBLE
@@ -0,0 +1,86 @@
+#pragma once
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <host/ble_hs.h>
+
+namespace CustomBLE {
+
+/**
+ * @brief Append-only byte sink handed to read callbacks.
+ *
+ * During a GATT read the writer is bound directly to the outgoing os_mbuf,
+ * so bytes are copied exactly once and no temporary std::string is built.
+ * It can also target a caller-provided flat buffer (connection manager path)
+ * or a std::string (Characteristic::read_value()).
+ */
+class ValueWriter {
+public:
+    /**
+     * @brief Bind to an os_mbuf (normally ctxt->om of a read access).
+     */
+    explicit ValueWriter(os_mbuf* om);
+
+    /**
+     * @brief Bind to an os_mbuf, appending at most capacity bytes (e.g. one notification payload).
+     */
+    ValueWriter(os_mbuf* om, size_t capacity);
+
+    /**
+     * @brief Bind to a flat buffer of the given capacity.
+     */
+    ValueWriter(uint8_t* buffer, size_t capacity);
+
+    /**
+     * @brief Bind to a std::string (bytes are appended).
+     */
+    explicit ValueWriter(std::string& out);
+
+    /**
+     * @brief Append raw bytes.
+     * @return 0 on success, BLE_ATT_ERR_INSUFFICIENT_RES if the target is full
+     */
+    int append(const void* data, size_t len);
+
+    int append(const std::string& value) { return append(value.data(), value.size()); }
+
+    /**
+     * @brief Append the raw in-memory representation of value (sizeof(T) bytes).
+     */
+    template<typename T>
+    int append_raw(const T& value) { return append(&value, sizeof(T)); }
+
+    /**
+     * @brief Replace len bytes already appended, starting offset bytes after the first one
+     * appended through this writer (e.g. a length prefix written before its value).
+     * @return 0 on success, BLE_ATT_ERR_UNLIKELY if the range was not appended yet
+     */
+    int overwrite(size_t offset, const void* data, size_t len);
+
+    /**
+     * @brief Copy len bytes already appended, starting offset bytes after the first one, into out.
+     * @return 0 on success, BLE_ATT_ERR_UNLIKELY if the range was not appended yet
+     */
+    int copy_appended(size_t offset, void* out, size_t len) const;
+
+    /**
+     * @brief Number of bytes appended through this writer.
+     */
+    size_t size() const { return written; }
+
+private:
+    enum class Target : uint8_t {
+        Mbuf,
+        Flat,
+        String,
+    };
+
+    Target target;
+    os_mbuf* om {nullptr};
+    uint8_t* buffer {nullptr};
+    size_t capacity {0};
+    std::string* str {nullptr};
+    size_t written {0};
+};
+
+} // namespace CustomBLE
@@ -0,0 +1,187 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+
+namespace CustomBLE {
+
+/**
+ * @brief Wire layout of a struct: specialize with the members in wire order.
+ *
+ * @code
+ * struct Reading { uint8_t id; float value; uint16_t flags; };
+ * template<> struct CustomBLE::WireFields<Reading> {
+ *     static constexpr auto members = std::make_tuple(&Reading::id, &Reading::value, &Reading::flags);
+ * };
+ * // WireCodec<Reading>::size == 7, no padding
+ * @endcode
+ */
+template<typename T>
+struct WireFields;
+
+namespace detail {
+
+template<typename T, typename = void>
+struct has_wire_fields : std::false_type {};
+template<typename T>
+struct has_wire_fields<T, std::void_t<decltype(WireFields<T>::members)>> : std::true_type {};
+
+template<typename T>
+struct is_std_array : std::false_type {};
+template<typename U, size_t N>
+struct is_std_array<std::array<U, N>> : std::true_type {};
+
+template<typename T>
+struct dependent_false : std::false_type {};
+
+template<typename Member>
+struct member_type;
+template<typename C, typename M>
+struct member_type<M C::*> {
+    using type = M;
+};
+
+template<typename T>
+constexpr void store_le(uint8_t* out, T value) {
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+template<typename T>
+constexpr T load_le(const uint8_t* in) {
+    T value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        value |= static_cast<T>(static_cast<T>(in[i]) << (8 * i));
+    }
+    return value;
+}
+
+} // namespace detail
+
+/**
+ * @brief Compile-time little-endian wire encoding of T.
+ *
+ * Supports bool, integers, float/double (IEEE 754), enums (as their
+ * underlying type), std::array and built-in arrays of supported types, and
+ * structs (packed or not) described by WireFields<T>. Members are laid out back to back, so
+ * padding never reaches the wire and the encoding is independent of the
+ * host byte order. size is a compile-time constant; other types fail to
+ * compile.
+ */
+template<typename T>
+struct WireCodec {
+    static constexpr size_t compute_size() {
+        if constexpr (std::is_same_v<T, bool>) {
+            return 1;
+        } else if constexpr (std::is_integral_v<T> || std::is_floating_point_v<T>) {
+            static_assert(!std::is_floating_point_v<T> || sizeof(T) == 4 || sizeof(T) == 8,
+                          "Only 32- and 64-bit floating point values have a wire encoding");
+            return sizeof(T);
+        } else if constexpr (std::is_enum_v<T>) {
+            return WireCodec<std::underlying_type_t<T>>::size;
+        } else if constexpr (std::is_array_v<T>) {
+            return std::extent_v<T> * WireCodec<std::remove_extent_t<T>>::size;
+        } else if constexpr (detail::is_std_array<T>::value) {
+            return std::tuple_size_v<T> * WireCodec<typename T::value_type>::size;
+        } else if constexpr (detail::has_wire_fields<T>::value) {
+            return std::apply([](auto... members) {
+                return (size_t {0} + ... + WireCodec<typename detail::member_type<decltype(members)>::type>::size);
+            }, WireFields<T>::members);
+        } else {
+            static_assert(detail::dependent_false<T>::value,
+                          "No wire encoding for this type: describe structs with CustomBLE::WireFields<T>");
+            return 0;
+        }
+    }
+
+    static constexpr size_t size = compute_size();
+
+    /**
+     * @brief Write the size bytes encoding value to out.
+     */
+    static void encode(const T& value, uint8_t* out) {
+        if constexpr (std::is_same_v<T, bool>) {
+            out[0] = value ? 1 : 0;
+        } else if constexpr (std::is_integral_v<T>) {
+            detail::store_le(out, static_cast<std::make_unsigned_t<T>>(value));
+        } else if constexpr (std::is_floating_point_v<T>) {
+            using Bits = std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>;
+            Bits bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            detail::store_le(out, bits);
+        } else if constexpr (std::is_enum_v<T>) {
+            using Underlying = std::underlying_type_t<T>;
+            WireCodec<Underlying>::encode(static_cast<Underlying>(value), out);
+        } else if constexpr (std::is_array_v<T> || detail::is_std_array<T>::value) {
+            using Element = std::remove_cv_t<std::remove_reference_t<decltype(value[0])>>;
+            for (const auto& element : value) {
+                WireCodec<Element>::encode(element, out);
+                out += WireCodec<Element>::size;
+            }
+        } else {
+            std::apply([&value, &out](auto... members) {
+                (encode_member(value, members, out), ...);
+            }, WireFields<T>::members);
+        }
+    }
+
+    /**
+     * @brief Read value from the size bytes at in.
+     */
+    static void decode(const uint8_t* in, T& value) {
+        if constexpr (std::is_same_v<T, bool>) {
+            value = in[0] != 0;
+        } else if constexpr (std::is_integral_v<T>) {
+            value = static_cast<T>(detail::load_le<std::make_unsigned_t<T>>(in));
+        } else if constexpr (std::is_floating_point_v<T>) {
+            using Bits = std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>;
+            Bits bits = detail::load_le<Bits>(in);
+            std::memcpy(&value, &bits, sizeof(bits));
+        } else if constexpr (std::is_enum_v<T>) {
+            using Underlying = std::underlying_type_t<T>;
+            Underlying underlying {};
+            WireCodec<Underlying>::decode(in, underlying);
+            value = static_cast<T>(underlying);
+        } else if constexpr (std::is_array_v<T> || detail::is_std_array<T>::value) {
+            using Element = std::remove_reference_t<decltype(value[0])>;
+            for (auto& element : value) {
+                WireCodec<Element>::decode(in, element);
+                in += WireCodec<Element>::size;
+            }
+        } else {
+            std::apply([&value, &in](auto... members) {
+                (decode_member(in, value, members), ...);
+            }, WireFields<T>::members);
+        }
+    }
+
+private:
+    // Members are copied through byte pointers: members of packed structs may be unaligned.
+    template<typename Member>
+    static void encode_member(const T& value, Member member, uint8_t*& out) {
+        using M = typename detail::member_type<Member>::type;
+        const unsigned char* base = reinterpret_cast<const unsigned char*>(&value);
+        size_t offset = static_cast<size_t>(reinterpret_cast<const unsigned char*>(&(value.*member)) - base);
+        M copy;
+        std::memcpy(&copy, base + offset, sizeof(M));
+        WireCodec<M>::encode(copy, out);
+        out += WireCodec<M>::size;
+    }
+
+    template<typename Member>
+    static void decode_member(const uint8_t*& in, T& value, Member member) {
+        using M = typename detail::member_type<Member>::type;
+        unsigned char* base = reinterpret_cast<unsigned char*>(&value);
+        size_t offset = static_cast<size_t>(reinterpret_cast<unsigned char*>(&(value.*member)) - base);
+        M copy {};
+        WireCodec<M>::decode(in, copy);
+        std::memcpy(base + offset, &copy, sizeof(M));
+        in += WireCodec<M>::size;
+    }
+};
+
+} // namespace CustomBLE
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sdkconfig.h>
+
+namespace CustomBLE {
+
+/**
+ * @brief Per-connection buffers that reassembled writes are flattened into.
+ *
+ * NimBLE queues Prepare Write fragments itself and, on Execute Write, calls
+ * the access callback once with all fragments as a multi-segment os_mbuf
+ * chain. The chain is flattened into the writing connection's buffer, which
+ * ServiceManager preallocates at registration to the largest declared
+ * characteristic max length; std::string write callbacks get that buffer
+ * directly, so writes cause no heap traffic. ATT requests are sequential per
+ * connection, so one buffer per connection suffices.
+ *
+ * Only used from the NimBLE host task.
+ */
+class WriteBuffers {
+public:
+    /**
+     * @brief Preallocate every buffer to hold capacity bytes (never shrinks).
+     */
+    static void reserve(size_t capacity);
+    static size_t capacity();
+
+    /**
+     * @brief Heap bytes held by all buffers, and the number of buffers that own a heap block.
+     */
+    static size_t allocated_bytes();
+    static size_t allocation_count();
+
+    /**
+     * @brief Buffer of conn_handle (assigned on first use), or nullptr if
+     * nothing was reserved or all buffers belong to other connections.
+     */
+    static std::string* acquire(uint16_t conn_handle);
+
+    /**
+     * @brief Return conn_handle's buffer to the pool (keeps its allocation).
+     */
+    static void drop(uint16_t conn_handle);
+};
+
+} // namespace CustomBLE
@@ -0,0 +1,265 @@
+#include "CustomBLE/AdvertisingBuilder.hpp"
+#include <cstring>
+#include <esp_log.h>
+
+static const char *TAG = "CustomBLE/AdvertisingBuilder";
+
+namespace CustomBLE {
+namespace {
+
+constexpr size_t header_size = 2; // length, AD type
+constexpr size_t uuid_width[3] = {2, 4, 16};
+constexpr uint8_t complete_list[3] = {BLE_HS_ADV_TYPE_COMP_UUIDS16, BLE_HS_ADV_TYPE_COMP_UUIDS32,
+                                      BLE_HS_ADV_TYPE_COMP_UUIDS128};
+constexpr uint8_t incomplete_list[3] = {BLE_HS_ADV_TYPE_INCOMP_UUIDS16, BLE_HS_ADV_TYPE_INCOMP_UUIDS32,
+                                        BLE_HS_ADV_TYPE_INCOMP_UUIDS128};
+
+size_t size_class(const ble_uuid_t* uuid) {
+    switch (uuid->type) {
+        case BLE_UUID_TYPE_16: return 0;
+        case BLE_UUID_TYPE_32: return 1;
+        default: return 2;
+    }
+}
+
+/**
+ * What one packet carries; the bytes are written once every element is placed.
+ */
+struct Packet {
+    size_t capacity;
+    size_t used;
+    size_t uuid_counts[3];
+    bool manufacturer_data;
+    bool tx_power;
+    size_t name_length;  // 0: no name element
+    bool name_complete;
+
+    size_t room() const { return capacity - used; }
+};
+
+void put_header(uint8_t* out, size_t& length, size_t payload, uint8_t type) {
+    out[length++] = static_cast<uint8_t>(payload + 1);
+    out[length++] = type;
+}
+
+void put_uuid(uint8_t* out, size_t& length, const ble_uuid_t* uuid) {
+    switch (uuid->type) {
+        case BLE_UUID_TYPE_16: {
+            uint16_t value = reinterpret_cast<const ble_uuid16_t*>(uuid)->value;
+            out[length++] = static_cast<uint8_t>(value);
+            out[length++] = static_cast<uint8_t>(value >> 8);
+            break;
+        }
+        case BLE_UUID_TYPE_32: {
+            uint32_t value = reinterpret_cast<const ble_uuid32_t*>(uuid)->value;
+            for (size_t i = 0; i < 4; ++i) {
+                out[length++] = static_cast<uint8_t>(value >> (8 * i));
+            }
+            break;
+        }
+        default:
+            // Stored little endian already, as on the air.
+            memcpy(out + length, reinterpret_cast<const ble_uuid128_t*>(uuid)->value, 16);
+            length += 16;
+            break;
+    }
+}
+
+} // namespace
+
+void AdvertisingBuilder::set_name(const char* value) {
+    set_name(value, value ? strlen(value) : 0);
+}
+
+void AdvertisingBuilder::set_manufacturer_data(uint16_t company, const uint8_t* data, size_t len) {
+    company_id = company;
+    manufacturer_data = data;
+    manufacturer_length = data ? len : 0;
+    has_manufacturer_data = true;
+}
+
+int AdvertisingBuilder::add_service_uuid(const ble_uuid_t* uuid) {
+    if (!uuid) {
+        return BLE_HS_EINVAL;
+    }
+    for (size_t i = 0; i < uuid_count; ++i) {
+        if (ble_uuid_cmp(uuids[i], uuid) == 0) {
+            return 0;
+        }
+    }
+    if (uuid_count == max_uuids) {
+        return BLE_HS_ENOMEM;
+    }
+    uuids[uuid_count++] = uuid;
+    return 0;
+}
+
+void AdvertisingBuilder::clear() {
+    uuid_count = 0;
+    flags = default_flags;
+    name = nullptr;
+    name_length = 0;
+    has_tx_power = false;
+    has_manufacturer_data = false;
+    manufacturer_data = nullptr;
+    manufacturer_length = 0;
+}
+
+void AdvertisingBuilder::build(Mode build_mode) {
+    mode = build_mode;
+    size_t packet_count = mode == Mode::Legacy ? 2 : 1;
+    Packet packets[2] = {};
+    packets[0].capacity = mode == Mode::Legacy ? legacy_max_size : extended_max_size;
+    packets[1].capacity = legacy_max_size;
+    dropped_count = 0;
+    name_shortened = false;
+
+    // Places an element of bytes into the first packet with room for it.
+    auto place = [&](size_t bytes) -> Packet* {
+        for (size_t p = 0; p < packet_count; ++p) {
+            if (packets[p].room() >= bytes) {
+                packets[p].used += bytes;
+                return &packets[p];
+            }
+        }
+        return nullptr;
+    };
+
+    if (flags) {
+        packets[0].used += header_size + 1;
+    }
+
+    // UUIDs one by one: the first UUID of a size in a packet also pays for the list header.
+    uint8_t placement[max_uuids];
+    size_t totals[3] = {};
+    for (size_t i = 0; i < uuid_count; ++i) {
+        size_t size = size_class(uuids[i]);
+        ++totals[size];
+        placement[i] = static_cast<uint8_t>(packet_count);
+        for (size_t p = 0; p < packet_count; ++p) {
+            size_t need = uuid_width[size] + (packets[p].uuid_counts[size] ? 0 : header_size);
+            if (packets[p].room() >= need) {
+                packets[p].used += need;
+                ++packets[p].uuid_counts[size];
+                placement[i] = static_cast<uint8_t>(p);
+                break;
+            }
+        }
+        if (placement[i] == packet_count) {
+            ++dropped_count;
+        }
+    }
+
+    if (has_manufacturer_data) {
+        if (Packet* packet = place(header_size + 2 + manufacturer_length)) {
+            packet->manufacturer_data = true;
+        } else {
+            ++dropped_count;
+        }
+    }
+    if (has_tx_power) {
+        if (Packet* packet = place(header_size + 1)) {
+            packet->tx_power = true;
+        } else {
+            ++dropped_count;
+        }
+    }
+    if (name_length) {
+        if (Packet* packet = place(header_size + name_length)) {
+            packet->name_length = name_length;
+            packet->name_complete = true;
+        } else {
+            Packet* roomiest = &packets[0];
+            for (size_t p = 1; p < packet_count; ++p) {
+                if (packets[p].room() > roomiest->room()) {
+                    roomiest = &packets[p];
+                }
+            }
+            if (roomiest->room() >= header_size + min_short_name) {
+                roomiest->name_length = roomiest->room() - header_size;
+                roomiest->used = roomiest->capacity;
+                name_shortened = true;
+            } else {
+                ++dropped_count;
+            }
+        }
+    }
+
+    // Every packet in the same element order: flags, UUID lists (16, 32, 128 bit), manufacturer data, TX power, name.
+    auto write = [&](const Packet& packet, size_t index, uint8_t* out) {
+        size_t length = 0;
+        if (index == 0 && flags) {
+            put_header(out, length, 1, BLE_HS_ADV_TYPE_FLAGS);
+            out[length++] = flags;
+        }
+        for (size_t size = 0; size < 3; ++size) {
+            size_t count = packet.uuid_counts[size];
+            if (count == 0) {
+                continue;
+            }
+            put_header(out, length, count * uuid_width[size],
+                       count == totals[size] ? complete_list[size] : incomplete_list[size]);
+            for (size_t i = 0; i < uuid_count; ++i) {
+                if (placement[i] == index && size_class(uuids[i]) == size) {
+                    put_uuid(out, length, uuids[i]);
+                }
+            }
+        }
+        if (packet.manufacturer_data) {
+            put_header(out, length, 2 + manufacturer_length, BLE_HS_ADV_TYPE_MFG_DATA);
+            out[length++] = static_cast<uint8_t>(company_id);
+            out[length++] = static_cast<uint8_t>(company_id >> 8);
+            if (manufacturer_length) {
+                memcpy(out + length, manufacturer_data, manufacturer_length);
+                length += manufacturer_length;
+            }
+        }
+        if (packet.tx_power) {
+            put_header(out, length, 1, BLE_HS_ADV_TYPE_TX_PWR_LVL);
+            out[length++] = static_cast<uint8_t>(tx_power);
+        }
+        if (packet.name_length) {
+            put_header(out, length, packet.name_length,
+                       packet.name_complete ? BLE_HS_ADV_TYPE_COMP_NAME : BLE_HS_ADV_TYPE_INCOMP_NAME);
+            memcpy(out + length, name, packet.name_length);
+            length += packet.name_length;
+        }
+        return length;
+    };
+    adv_length = write(packets[0], 0, adv);
+    scan_response_length = packet_count > 1 ? write(packets[1], 1, scan_response) : 0;
+    adv_uuid_count = packets[0].uuid_counts[0] + packets[0].uuid_counts[1] + packets[0].uuid_counts[2];
+    if (dropped_count) {
+        ESP_LOGW(TAG, "%u advertising element(s) do not fit and were left out", static_cast<unsigned>(dropped_count));
+    }
+}
+
+int AdvertisingBuilder::apply(uint8_t instance) const {
+#ifdef CONFIG_BT_NIMBLE_EXT_ADV
+    os_mbuf* data = ble_hs_mbuf_from_flat(adv, static_cast<uint16_t>(adv_length));
+    if (!data) {
+        return BLE_HS_ENOMEM;
+    }
+    int rc = ble_gap_ext_adv_set_data(instance, data);
+    if (rc != 0 || scan_response_length == 0) {
+        return rc;
+    }
+    data = ble_hs_mbuf_from_flat(scan_response, static_cast<uint16_t>(scan_response_length));
+    if (!data) {
+        return BLE_HS_ENOMEM;
+    }
+    return ble_gap_ext_adv_rsp_set_data(instance, data);
+#else
+    (void)instance;
+    if (mode == Mode::Extended) {
+        return BLE_HS_ENOTSUP;
+    }
+    int rc = ble_gap_adv_set_data(adv, static_cast<int>(adv_length));
+    if (rc != 0) {
+        return rc;
+    }
+    return ble_gap_adv_rsp_set_data(scan_response, static_cast<int>(scan_response_length));
+#endif
+}
+
+} // namespace CustomBLE
@@ -0,0 +1,49 @@
+#include "CustomBLE/AggregateCharacteristic.hpp"
+#include <algorithm>
+
+namespace CustomBLE {
+
+std::shared_ptr<AggregateCharacteristic> AggregateCharacteristic::create(const char* name, const ble_uuid128_t& uuid,
+                                                                         std::initializer_list<std::shared_ptr<Characteristic>> members) {
+    return std::make_shared<AggregateCharacteristic>(Token {}, name, uuid, members);
+}
+
+AggregateCharacteristic::AggregateCharacteristic(Token, const char* name, const ble_uuid128_t& uuid,
+                                                 std::initializer_list<std::shared_ptr<Characteristic>> members)
+    : Characteristic(name, uuid, ReadCallback(), WriteCallback()), members(members) {
+    size_t packed = 0;
+    for (const auto& member : this->members) {
+        packed += length_size + member->get_max_length();
+    }
+    set_read_sink_callback([this](ValueWriter& out) { return write_members(out); });
+    set_max_length(static_cast<uint16_t>(std::min<size_t>(packed, BLE_ATT_ATTR_MAX_LEN)));
+}
+
+int AggregateCharacteristic::write_members(ValueWriter& out) const {
+    for (const auto& member : members) {
+        // Reserve the length, let the member append its value behind it, then fill the length in.
+        size_t prefix = out.size();
+        uint8_t length[length_size] = {0, 0};
+        int rc = out.append(length, sizeof(length));
+        if (rc != 0) {
+            return rc;
+        }
+        rc = member->read_wire(out);
+        if (rc != 0) {
+            return rc;
+        }
+        size_t value_length = out.size() - prefix - sizeof(length);
+        if (value_length > UINT16_MAX) {
+            return BLE_ATT_ERR_INSUFFICIENT_RES;
+        }
+        length[0] = static_cast<uint8_t>(value_length);
+        length[1] = static_cast<uint8_t>(value_length >> 8);
+        rc = out.overwrite(prefix, length, sizeof(length));
+        if (rc != 0) {
+            return rc;
+        }
+    }
+    return 0;
+}
+
+} // namespace CustomBLE
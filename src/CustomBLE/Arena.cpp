@@ -0,0 +1,60 @@
+#include "CustomBLE/Arena.hpp"
+#include <new>
+#include <esp_log.h>
+
+static const char *TAG = "CustomBLE/Arena";
+
+namespace CustomBLE {
+namespace {
+
+size_t align_up(size_t offset, size_t alignment) {
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+} // namespace
+
+Arena::Arena(void* buffer, size_t capacity)
+    : block(static_cast<uint8_t*>(buffer)), block_capacity(buffer ? capacity : 0) {
+}
+
+Arena::Arena(size_t capacity)
+    : block(static_cast<uint8_t*>(::operator new(capacity))), block_capacity(capacity), owns_block(true) {
+}
+
+Arena::~Arena() {
+    if (owns_block) {
+        ::operator delete(block);
+    }
+}
+
+void* Arena::allocate(size_t size, size_t alignment) {
+    // Offsets are aligned as if the block started at a max_align_t boundary,
+    // so required() is exact for any block obtained from malloc/new.
+    required_bytes = align_up(required_bytes, alignment) + size;
+    if (block) {
+        uintptr_t base = reinterpret_cast<uintptr_t>(block);
+        size_t offset = align_up(base + block_used, alignment) - base;
+        if (offset <= block_capacity && size <= block_capacity - offset) {
+            block_used = offset + size;
+            return block + offset;
+        }
+        if (overflow == 0) {
+            ESP_LOGW(TAG, "Arena of %u bytes exhausted; falling back to the heap", static_cast<unsigned>(block_capacity));
+        }
+    }
+    overflow += block ? size : 0;
+    return ::operator new(size);
+}
+
+void Arena::deallocate(void* ptr) {
+    if (ptr && !contains(ptr)) {
+        ::operator delete(ptr);
+    }
+}
+
+bool Arena::contains(const void* ptr) const {
+    const uint8_t* p = static_cast<const uint8_t*>(ptr);
+    return block && p >= block && p < block + block_capacity;
+}
+
+} // namespace CustomBLE
@@ -0,0 +1,74 @@
+#include "CustomBLE/ChangeDetector.hpp"
+
+namespace CustomBLE {
+namespace {
+
+constexpr uint64_t fnv_offset = 0xcbf29ce484222325ull;
+constexpr uint64_t fnv_prime = 0x100000001b3ull;
+
+uint64_t hash_value(const ValueReader& value) {
+    uint64_t hash = fnv_offset;
+    value.for_each_segment([&hash](const uint8_t* data, size_t len) {
+        for (size_t i = 0; i < len; ++i) {
+            hash = (hash ^ data[i]) * fnv_prime;
+        }
+    });
+    return hash;
+}
+
+} // namespace
+
+ChangeDetector& ChangeDetector::operator=(const ChangeDetector& other) {
+    // Copies carry the configuration, not the last sent value.
+    if (this != &other) {
+        mode = other.mode;
+        value_size = other.value_size;
+        std::memcpy(band, other.band, sizeof(band));
+        within_band = other.within_band;
+        has_last = false;
+        last_hash = 0;
+        last_length = 0;
+        suppressed = 0;
+    }
+    return *this;
+}
+
+void ChangeDetector::enable_hash() {
+    mode = Mode::Hash;
+    reset();
+}
+
+bool ChangeDetector::should_send(const ValueReader& value) {
+    switch (mode) {
+        case Mode::Off:
+            return true;
+        case Mode::Deadband: {
+            uint8_t current[sizeof(last_value)];
+            if (value.size() != value_size || value.copy_to(current, value_size) != 0) {
+                has_last = false;
+                return true;
+            }
+            if (has_last && within_band(last_value, current, band)) {
+                ++suppressed;
+                return false;
+            }
+            std::memcpy(last_value, current, value_size);
+            has_last = true;
+            return true;
+        }
+        case Mode::Hash: {
+            uint64_t hash = hash_value(value);
+            if (has_last && hash == last_hash && value.size() == last_length) {
+                ++suppressed;
+                return false;
+            }
+            last_hash = hash;
+            last_length = value.size();
+            has_last = true;
+            return true;
+        }
+    }
+    return true;
+}
+
+} // namespace CustomBLE
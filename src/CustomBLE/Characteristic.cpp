@@ -1,8 +1,66 @@
 #include "CustomBLE/Characteristic.hpp"
+#include "CustomBLE/Compression.hpp"
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <esp_timer.h>
 
 static const char *TAG = "CustomBLE/Characteristic";
 
 namespace CustomBLE {
+namespace {
+
+// Connection of the GATT access being dispatched; only touched from the NimBLE host task.
+uint16_t accessing_conn_handle = BLE_HS_CONN_HANDLE_NONE;
+
+// Working memory of compressed reads and writes, kept off the task stacks.
+struct CompressionScratch {
+    uint8_t raw[BLE_ATT_ATTR_MAX_LEN];
+    LzCodec::Table table;
+};
+
+CompressionScratch shared_scratch;
+std::atomic_flag shared_scratch_busy = ATOMIC_FLAG_INIT;
+
+/**
+ * Claims shared_scratch until the end of the scope. The claimant is normally
+ * the host task; a nested (aggregate of compressed members) or concurrent
+ * (notify() from another task) claim gets a heap copy instead.
+ */
+class ScratchLease {
+public:
+    ScratchLease() = default;
+    ~ScratchLease() {
+        if (scratch == &shared_scratch) {
+            shared_scratch_busy.clear(std::memory_order_release);
+        }
+    }
+    ScratchLease(const ScratchLease&) = delete;
+    ScratchLease& operator=(const ScratchLease&) = delete;
+
+    /**
+     * @return the scratch, or nullptr if a heap copy was needed and could not be allocated
+     */
+    CompressionScratch* claim() {
+        if (scratch) {
+            return scratch;
+        }
+        if (!shared_scratch_busy.test_and_set(std::memory_order_acquire)) {
+            scratch = &shared_scratch;
+        } else {
+            owned.reset(new (std::nothrow) CompressionScratch);
+            scratch = owned.get();
+        }
+        return scratch;
+    }
+
+private:
+    CompressionScratch* scratch {nullptr};
+    std::unique_ptr<CompressionScratch> owned;
+};
+
+} // namespace
+
 std::string Characteristic::overview() const {
     char uuid_str[40];
     // BLE UUID 128-bit: xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx
@@ -40,14 +98,15 @@ Characteristic::Characteristic(const char* name,
                                                              const ble_uuid128_t& characteristic_uuid,
                                                              ReadCallback read_cb,
                                                              WriteCallback write_cb)
-        : uuid(characteristic_uuid), handle(0), read_callback(read_cb),
-            write_callback(write_cb), name(name) {
+        : uuid(characteristic_uuid), handle(0), name(name) {
     // Set flags based on available callbacks
     flags = 0;
-    if (read_callback) {
+    if (read_cb) {
+        read_handler = std::move(read_cb);
         flags |= BLE_GATT_CHR_F_READ;
     }
-    if (write_callback) {
+    if (write_cb) {
+        write_handler = std::move(write_cb);
         flags |= BLE_GATT_CHR_F_WRITE;
     }
     // Always allow notify if we have read capability
@@ -56,41 +115,155 @@ Characteristic::Characteristic(const char* name,
     }
 }
 
+int Characteristic::read_into(ValueWriter& writer) const {
+    Extension* ext = extension.get();
+    if (!ext || !ext->read_cache.enabled()) {
+        return read_uncached(writer);
+    }
+    ReadCache& read_cache = ext->read_cache;
+    int64_t now = esp_timer_get_time();
+    size_t cached_len = 0;
+    if (const uint8_t* cached = read_cache.lookup(now, cached_len)) {
+        return writer.append(cached, cached_len);
+    }
+    // Produce the value straight into writer (the callback runs once) and keep a copy if it fits the cache.
+    uint32_t generation = read_cache.begin_fill();
+    size_t start = writer.size();
+    int rc = read_uncached(writer);
+    if (rc != 0) {
+        return rc;
+    }
+    size_t len = writer.size() - start;
+    if (uint8_t* buffer = read_cache.reserve(len)) {
+        if (writer.copy_appended(start, buffer, len) == 0) {
+            read_cache.store(len, now, generation);
+        }
+    }
+    return 0;
+}
+
+int Characteristic::read_uncached(ValueWriter& writer) const {
+    if (const auto* sink = std::get_if<ReadSinkCallback>(&read_handler)) {
+        return (*sink)(writer);
+    }
+    if (const auto* callback = std::get_if<ReadCallback>(&read_handler)) {
+        return writer.append((*callback)());
+    }
+    return 0;
+}
+
+int Characteristic::read_wire(ValueWriter& writer, bool cached) const {
+    if (!(compression & CompressReads)) {
+        return cached ? read_into(writer) : read_uncached(writer);
+    }
+    ScratchLease lease;
+    CompressionScratch* scratch = lease.claim();
+    if (!scratch) {
+        return BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+    ValueWriter raw_writer(scratch->raw, sizeof(scratch->raw));
+    int rc = cached ? read_into(raw_writer) : read_uncached(raw_writer);
+    if (rc != 0) {
+        return rc;
+    }
+    return LzCodec::compress(scratch->raw, raw_writer.size(), writer, scratch->table);
+}
+
 int Characteristic::handle_access(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt) {
-    int rc;
+    accessing_conn_handle = conn_handle;
+#ifdef CONFIG_CUSTOMBLE_ACCESS_STATS
+    uint32_t start = AccessStats::now();
+    uint16_t length_before = OS_MBUF_PKTLEN(ctxt->om);
+    int rc = dispatch_access(conn_handle, ctxt);
+    bool write = ctxt->op == BLE_GATT_ACCESS_OP_WRITE_CHR;
+    size_t bytes = write ? length_before : OS_MBUF_PKTLEN(ctxt->om) - length_before;
+    access_stats.record(write, bytes, rc, AccessStats::now() - start);
+#else
+    int rc = dispatch_access(conn_handle, ctxt);
+#endif
+    accessing_conn_handle = BLE_HS_CONN_HANDLE_NONE;
+    return rc;
+}
+
+uint16_t Characteristic::access_conn_handle() {
+    return accessing_conn_handle;
+}
+
+int Characteristic::dispatch_access(uint16_t conn_handle, struct ble_gatt_access_ctxt *ctxt) {
     switch (ctxt->op) {
         case BLE_GATT_ACCESS_OP_READ_CHR: {
             // ESP_LOGI(TAG, "Characteristic read (handle: %d)", attr_handle);
-            std::string value;
-            if (read_callback) {
-                value = read_callback();
-            } else {
-                value = "";
-            }
-            rc = os_mbuf_append(ctxt->om, value.c_str(), value.length());
-            return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+            return read_fragment(conn_handle, ctxt->om);
         }
         case BLE_GATT_ACCESS_OP_WRITE_CHR: {
             // ESP_LOGI(TAG, "Characteristic write (handle: %d)", attr_handle);
-            uint16_t om_len = OS_MBUF_PKTLEN(ctxt->om);
-            if (om_len > 0) {
-                char buffer[om_len];
-                rc = ble_hs_mbuf_to_flat(ctxt->om, buffer, sizeof(buffer), NULL);
-                if (rc == 0) {
-                    std::string received_value(buffer, om_len);
-                    if (write_callback) {
-                        write_callback(received_value);
-                    }
-                    ESP_LOGI(TAG, "Characteristic updated to: %s", received_value.c_str());
+            // Reject oversize values before touching the payload.
+            size_t limit = compression & CompressWrites ? LzCodec::bound(max_length) : max_length;
+            if (OS_MBUF_PKTLEN(ctxt->om) > limit) {
+                return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+            }
+            ValueReader reader(ctxt->om);
+            if (compression & CompressWrites) {
+                std::string_view packed = reader.view();
+                return receive_bytes(packed.data(), packed.size());
+            }
+            if (reader.empty() && !std::holds_alternative<WriteViewCallback>(write_handler)) {
+                return 0;
+            }
+            if (DeferredWriteQueue* write_queue = get_write_queue()) {
+                return write_queue->push(*this, reader);
+            }
+            // Reassembled long writes arrive as a chain and std::string callbacks need a
+            // flat copy: use the connection's preallocated buffer for both.
+            if (SLIST_NEXT(ctxt->om, om_next) || std::holds_alternative<WriteCallback>(write_handler)) {
+                std::string* buffer = WriteBuffers::acquire(conn_handle);
+                if (buffer && buffer->capacity() >= reader.size()) {
+                    buffer->resize(reader.size());
+                    reader.copy_to(&(*buffer)[0], reader.size());
+                    ValueReader flat(reinterpret_cast<const uint8_t*>(buffer->data()), buffer->size());
+                    return dispatch_write(flat, buffer);
                 }
             }
-            return 0;
+            return dispatch_write(reader);
         }
         default:
             return BLE_ATT_ERR_UNLIKELY;
     }
 }
 
+int Characteristic::read_fragment(uint16_t conn_handle, os_mbuf* om) const {
+    if (conn_handle == BLE_HS_CONN_HANDLE_NONE) {
+        ValueWriter writer(om);
+        return read_wire(writer);
+    }
+    // NimBLE slices the returned value by offset; a Read/Read Blob response carries ATT_MTU - 1 bytes.
+    uint16_t fragment = ble_att_mtu(conn_handle) - 1;
+    int64_t now = esp_timer_get_time();
+    if (ReadSnapshots::Snapshot* snapshot = ReadSnapshots::find(conn_handle, this, now)) {
+        // Read Blob continuation: serve the value captured at offset 0.
+        int rc = os_mbuf_append(om, snapshot->data, snapshot->length) == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+        snapshot->sent += fragment;
+        // A value that is a multiple of the fragment size ends with an empty Read Blob.
+        if (snapshot->sent > snapshot->length) {
+            ReadSnapshots::release(snapshot);
+        }
+        return rc;
+    }
+    ValueWriter writer(om);
+    int rc = read_wire(writer);
+    uint16_t length = OS_MBUF_PKTLEN(om);
+    if (rc != 0 || length < fragment || length > BLE_ATT_ATTR_MAX_LEN) {
+        return rc;
+    }
+    // The central will fetch the rest with Read Blob requests.
+    ReadSnapshots::Snapshot* snapshot = ReadSnapshots::acquire(conn_handle);
+    if (snapshot && os_mbuf_copydata(om, 0, length, snapshot->data) == 0) {
+        snapshot->length = length;
+        ReadSnapshots::capture(snapshot, this, conn_handle, fragment, now);
+    }
+    return 0;
+}
+
 int Characteristic::gatt_access_callback(uint16_t conn_handle, uint16_t attr_handle,
                                    struct ble_gatt_access_ctxt *ctxt, void *arg) {
     Characteristic* characteristic = static_cast<Characteristic*>(arg);
@@ -114,30 +287,274 @@ uint16_t Characteristic::get_handle() const {
 }
 
 void Characteristic::set_read_callback(ReadCallback callback) {
-    read_callback = callback;
-    if (callback && !(flags & BLE_GATT_CHR_F_READ)) {
+    if (!callback) {
+        read_handler = std::monostate{};
+        return;
+    }
+    read_handler = std::move(callback);
+    if (!(flags & BLE_GATT_CHR_F_READ)) {
         flags |= BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY;
     }
 }
 
-std::string Characteristic::read_value() const {
-    if (read_callback) {
-        return read_callback();
+void Characteristic::set_read_sink_callback(ReadSinkCallback callback) {
+    if (!callback) {
+        read_handler = std::monostate{};
+        return;
+    }
+    read_handler = std::move(callback);
+    if (!(flags & BLE_GATT_CHR_F_READ)) {
+        flags |= BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY;
     }
-    return {};
+}
+
+std::string Characteristic::read_value() const {
+    std::string value;
+    ValueWriter writer(value);
+    read_into(writer);
+    return value;
 }
 
 void Characteristic::write_value(const std::string& value) const {
-    if (write_callback) {
-        write_callback(value);
+    write_bytes(value.data(), value.size());
+}
+
+int Characteristic::write_bytes(const void* data, size_t len) const {
+    if (len > max_length) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+    ValueReader reader(static_cast<const uint8_t*>(data), len);
+    return dispatch_write(reader);
+}
+
+int Characteristic::receive_bytes(const void* data, size_t len) const {
+    ScratchLease lease;
+    if (compression & CompressWrites) {
+        CompressionScratch* scratch = lease.claim();
+        if (!scratch) {
+            return BLE_ATT_ERR_INSUFFICIENT_RES;
+        }
+        uint8_t* raw = scratch->raw;
+        int raw_len = LzCodec::decompress(static_cast<const uint8_t*>(data), len, raw, std::min<size_t>(max_length, sizeof(scratch->raw)));
+        if (raw_len < 0) {
+            ESP_LOGD(TAG, "Characteristic '%s': malformed or oversize compressed write", name ? name : "");
+            return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+        }
+        data = raw;
+        len = static_cast<size_t>(raw_len);
+    }
+    DeferredWriteQueue* write_queue = get_write_queue();
+    if (!write_queue) {
+        return write_bytes(data, len);
+    }
+    if (len > max_length) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+    return write_queue->push(*this, ValueReader(static_cast<const uint8_t*>(data), len));
+}
+
+int Characteristic::dispatch_write(ValueReader& reader, const std::string* flat_copy) const {
+    // The write may change the value an unfinished long read captured.
+    ReadSnapshots::invalidate(this);
+    if (const auto* view = std::get_if<WriteViewCallback>(&write_handler)) {
+        return (*view)(reader);
+    }
+    if (const auto* callback = std::get_if<WriteCallback>(&write_handler)) {
+        if (flat_copy) {
+            (*callback)(*flat_copy);
+        } else {
+            (*callback)(reader.to_string());
+        }
+        ESP_LOGD(TAG, "Characteristic '%s' written (%u bytes)", name ? name : "", static_cast<unsigned>(reader.size()));
+    }
+    return 0;
+}
+
+void Characteristic::set_write_view_callback(WriteViewCallback callback) {
+    if (!callback) {
+        write_handler = std::monostate{};
+        return;
+    }
+    write_handler = std::move(callback);
+    if (!(flags & BLE_GATT_CHR_F_WRITE)) {
+        flags |= BLE_GATT_CHR_F_WRITE;
     }
 }
 
 void Characteristic::set_write_callback(WriteCallback callback) {
-    write_callback = callback;
-    if (callback && !(flags & BLE_GATT_CHR_F_WRITE)) {
+    if (!callback) {
+        write_handler = std::monostate{};
+        return;
+    }
+    write_handler = std::move(callback);
+    if (!(flags & BLE_GATT_CHR_F_WRITE)) {
         flags |= BLE_GATT_CHR_F_WRITE;
     }
 
-} // namespace CustomBLE
 }
+
+int Characteristic::notify() {
+    ReadSnapshots::invalidate(this);
+    if (handle == 0 || !has_subscribers()) {
+        return 0;
+    }
+    os_mbuf* om = os_msys_get_pkthdr(0, 0);
+    if (!om) {
+        return BLE_HS_ENOMEM;
+    }
+    ValueWriter writer(om);
+    int rc = read_wire(writer, false);
+    if (rc != 0) {
+        os_mbuf_free_chain(om);
+        return rc;
+    }
+    return send_to_subscribers(om);
+}
+
+int Characteristic::notify(const void* data, size_t len) {
+    ReadSnapshots::invalidate(this);
+    if (handle == 0 || !has_subscribers()) {
+        return 0;
+    }
+    if (len > UINT16_MAX) {
+        return BLE_HS_EMSGSIZE;
+    }
+    if (compression & CompressReads) {
+        os_mbuf* om = os_msys_get_pkthdr(0, 0);
+        if (!om) {
+            return BLE_HS_ENOMEM;
+        }
+        ScratchLease lease;
+        CompressionScratch* scratch = lease.claim();
+        ValueWriter writer(om);
+        if (!scratch || LzCodec::compress(static_cast<const uint8_t*>(data), len, writer, scratch->table) != 0) {
+            os_mbuf_free_chain(om);
+            return BLE_HS_ENOMEM;
+        }
+        return send_to_subscribers(om);
+    }
+    os_mbuf* om = ble_hs_mbuf_from_flat(data, static_cast<uint16_t>(len));
+    if (!om) {
+        return BLE_HS_ENOMEM;
+    }
+    return send_to_subscribers(om);
+}
+
+int Characteristic::send_to_subscribers(os_mbuf* om) {
+    // Only called after has_subscribers(), so the extension exists.
+    Extension& ext = *extension.get();
+    if (ext.change_detector.get_mode() != ChangeDetector::Mode::Off &&
+        !ext.change_detector.should_send(ValueReader(om))) {
+        os_mbuf_free_chain(om);
+        return 0;
+    }
+    SubscriptionTable::Subscriber subscribers[max_subscribers];
+    size_t count = ext.subscriptions.snapshot(subscribers, max_subscribers);
+    int result = 0;
+    for (size_t i = 0; i < count; ++i) {
+        os_mbuf* txom = om;
+        if (i + 1 < count) {
+            // NimBLE consumes the mbuf; every connection but the last gets a copy.
+            txom = os_msys_get_pkthdr(0, 0);
+            if (!txom || os_mbuf_appendfrom(txom, om, 0, OS_MBUF_PKTLEN(om)) != 0) {
+                os_mbuf_free_chain(txom);
+                result = BLE_HS_ENOMEM;
+                continue;
+            }
+        }
+        int rc = subscribers[i].notify
+            ? ble_gatts_notify_custom(subscribers[i].conn_handle, handle, txom)
+            : ble_gatts_indicate_custom(subscribers[i].conn_handle, handle, txom);
+        if (rc != 0) {
+            result = rc;
+        }
+    }
+    if (count == 0) {
+        os_mbuf_free_chain(om);
+    }
+    return result;
+}
+
+void Characteristic::schedule_notify() {
+    ReadSnapshots::invalidate(this);
+    if (notification_engine) {
+        notification_engine->schedule(*this);
+    } else {
+        notify();
+    }
+}
+
+namespace detail {
+
+void schedule_published_notify(Characteristic* characteristic) {
+    characteristic->schedule_notify();
+}
+
+} // namespace detail
+
+void Characteristic::set_indicate_enabled(bool enabled) {
+    if (enabled) {
+        flags |= BLE_GATT_CHR_F_INDICATE;
+    } else {
+        flags &= ~BLE_GATT_CHR_F_INDICATE;
+    }
+}
+
+void Characteristic::set_write_without_response_enabled(bool enabled) {
+    if (enabled) {
+        flags |= BLE_GATT_CHR_F_WRITE_NO_RSP;
+    } else {
+        flags &= ~BLE_GATT_CHR_F_WRITE_NO_RSP;
+    }
+}
+
+void Characteristic::on_subscribe(uint16_t conn_handle, bool notify, bool indicate) {
+    Extension* ext = extension.get();
+    if (!ext) {
+        if (!notify && !indicate) {
+            return;
+        }
+        ext = &extension.ensure();
+    }
+    if (notify || indicate) {
+        // The new subscriber has not seen the last value yet.
+        ext->change_detector.reset();
+    }
+    if (!ext->subscriptions.update(conn_handle, notify, indicate)) {
+        ESP_LOGW(TAG, "Subscription table full for '%s' (conn %u)", name ? name : "", conn_handle);
+    }
+}
+
+void Characteristic::on_disconnect(uint16_t conn_handle) {
+    if (Extension* ext = extension.get()) {
+        ext->subscriptions.remove(conn_handle);
+    }
+}
+
+const ReadCache& Characteristic::get_read_cache() const {
+    static const ReadCache disabled;
+    const Extension* ext = extension.get();
+    return ext ? ext->read_cache : disabled;
+}
+
+const SubscriptionTable& Characteristic::get_subscriptions() const {
+    static const SubscriptionTable empty;
+    const Extension* ext = extension.get();
+    return ext ? ext->subscriptions : empty;
+}
+
+Characteristic::Extension& Characteristic::ExtensionPtr::ensure() {
+    Extension* current = ptr.load(std::memory_order_acquire);
+    if (current) {
+        return *current;
+    }
+    // Configuration and GAP events may race on different tasks: the first allocation wins.
+    Extension* created = new Extension();
+    if (ptr.compare_exchange_strong(current, created, std::memory_order_acq_rel, std::memory_order_acquire)) {
+        return *created;
+    }
+    delete created;
+    return *current;
+}
+
+} // namespace CustomBLE
@@ -1,7 +1,15 @@
 
 #include "CustomBLE/CharacteristicsManager.hpp"
+#include "CustomBLE/Compression.hpp"
+
+static const char *TAG = "CustomBLE/CharacteristicsManager";
 
 namespace CustomBLE {
+
+CharacteristicsManager::CharacteristicsManager(Arena* arena)
+    : arena(arena), entries(ArenaAllocator<CharacteristicEntry>(arena)), chr_defs(ArenaAllocator<ble_gatt_chr_def>(arena)) {
+}
+
 std::string CharacteristicsManager::overview() const {
     std::string out = "Characteristics:\n";
     size_t idx = 0;
@@ -33,13 +41,18 @@ void CharacteristicsManager::print() const {
     printf("%s", overview().c_str());
 }
 
-void CharacteristicsManager::add_characteristic(std::shared_ptr<Characteristic> characteristic) {
-    CharacteristicEntry entry;
-    entry.characteristic = std::move(characteristic);
+esp_err_t CharacteristicsManager::add_characteristic(std::shared_ptr<Characteristic> characteristic) {
+    if (frozen) {
+        const char* name = characteristic ? characteristic->get_name() : nullptr;
+        ESP_LOGE(TAG, "Characteristic '%s' added after the GATT table was frozen; ignored", name ? name : "");
+        return ESP_ERR_INVALID_STATE;
+    }
+    CharacteristicEntry entry {std::move(characteristic), {}, ArenaVector<ble_gatt_dsc_def>(ArenaAllocator<ble_gatt_dsc_def>(arena))};
     // If the characteristic has a name, create a user description descriptor (UUID 0x2901)
     const char* name = entry.characteristic->get_name();
     if (name && *name) {
         // Prepare descriptor definition list with end marker.
+        entry.descriptors.reserve(2);
         ble_gatt_dsc_def user_desc = {};
         static const ble_uuid16_t user_desc_uuid16 = BLE_UUID16_INIT(0x2901);
         user_desc.uuid = &user_desc_uuid16.u;
@@ -63,30 +76,32 @@ void CharacteristicsManager::add_characteristic(std::shared_ptr<Characteristic>
         entry.descriptors.empty() ? nullptr : entry.descriptors.data(), // descriptors
         entry.characteristic->get_flags(),
         0, // min_key_size
-        nullptr, // handle pointer (set elsewhere if needed)
+        entry.characteristic->get_handle_storage(), // NimBLE fills in the value handle
         nullptr // cpfd
     };
     entries.push_back(std::move(entry));
-    update_chr_defs();
+    return ESP_OK;
 }
 
 std::shared_ptr<Characteristic> CharacteristicsManager::emplace_characteristic(const ble_uuid128_t& characteristic_uuid,
                                                                Characteristic::ReadCallback read_cb,
                                                                Characteristic::WriteCallback write_cb) {
-    return emplace_characteristic(nullptr, characteristic_uuid, read_cb, write_cb);
+    return emplace_characteristic(nullptr, characteristic_uuid, std::move(read_cb), std::move(write_cb));
 }
 
 std::shared_ptr<Characteristic> CharacteristicsManager::emplace_characteristic(const char* name,
                                                                const ble_uuid128_t& characteristic_uuid,
                                                                Characteristic::ReadCallback read_cb,
                                                                Characteristic::WriteCallback write_cb) {
-    auto characteristic = std::make_shared<Characteristic>(name, characteristic_uuid, read_cb, write_cb);
-    add_characteristic(characteristic);
+    auto characteristic = make_characteristic(name, characteristic_uuid, std::move(read_cb), std::move(write_cb));
+    if (add_characteristic(characteristic) != ESP_OK) {
+        return nullptr;
+    }
     return characteristic;
 }
 
 ble_gatt_chr_def* CharacteristicsManager::get_chr_defs() {
-    update_chr_defs();
+    freeze();
     return chr_defs.data();
 }
 
@@ -94,20 +109,58 @@ size_t CharacteristicsManager::size() const {
     return entries.size();
 }
 
-void CharacteristicsManager::update_chr_defs() {
+void CharacteristicsManager::add_compression_descriptor(CharacteristicEntry& entry) {
+    // Compression can be enabled after add_characteristic(), so the descriptor is added when freezing.
+    ble_gatt_dsc_def compression_desc = {};
+    compression_desc.uuid = &LzCodec::descriptor_uuid.u;
+    compression_desc.att_flags = BLE_ATT_F_READ;
+    compression_desc.access_cb = [](uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt, void *arg) -> int {
+        const Characteristic* characteristic = static_cast<const Characteristic*>(arg);
+        uint8_t modes = characteristic->get_compression();
+        uint16_t block = (modes & Characteristic::CompressStream) ? LzStreamEncoder::max_chunk : characteristic->get_max_length();
+        uint16_t window = LzStreamEncoder::window;
+        uint8_t value[LzCodec::descriptor_size] = {
+            LzCodec::format_lz4_block, modes,
+            static_cast<uint8_t>(block), static_cast<uint8_t>(block >> 8),
+            static_cast<uint8_t>(window), static_cast<uint8_t>(window >> 8),
+        };
+        int rc = os_mbuf_append(ctxt->om, value, sizeof(value));
+        return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+    };
+    compression_desc.arg = entry.characteristic.get();
+    if (entry.descriptors.empty()) {
+        ble_gatt_dsc_def end_marker = {};
+        end_marker.uuid = nullptr;
+        entry.descriptors.push_back(compression_desc);
+        entry.descriptors.push_back(end_marker);
+    } else {
+        entry.descriptors.insert(entry.descriptors.end() - 1, compression_desc);
+    }
+}
+
+void CharacteristicsManager::freeze() {
+    if (frozen) {
+        return;
+    }
     chr_defs.clear();
-    for (const auto& entry : entries) {
-        ble_gatt_chr_def chr = entry.chr_def; // copy
+    chr_defs.reserve(entries.size() + 1);
+    for (auto& entry : entries) {
+        if (entry.characteristic->get_compression() != Characteristic::CompressNone) {
+            add_compression_descriptor(entry);
+        }
         if (!entry.descriptors.empty()) {
             // Refresh descriptor pointer in case vector storage moved.
-            chr.descriptors = const_cast<ble_gatt_dsc_def*>(entry.descriptors.data());
+            entry.chr_def.descriptors = entry.descriptors.data();
         }
-        chr_defs.push_back(chr);
+        // Flags may change after add_characteristic() (set_indicate_enabled() etc.).
+        entry.chr_def.flags = entry.characteristic->get_flags();
+        chr_defs.push_back(entry.chr_def);
     }
     // Always ensure the last element is the end marker
     ble_gatt_chr_def end_marker = {};
     end_marker.uuid = nullptr;
     chr_defs.push_back(end_marker);
+    frozen = true;
 }
 
 } // namespace CustomBLE
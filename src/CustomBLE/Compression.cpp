@@ -0,0 +1,257 @@
+#include "CustomBLE/Compression.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace CustomBLE {
+namespace {
+
+// LZ4 block format limits: matches are at least 4 bytes, the last 5 bytes of
+// a block are always literals and the last match starts 12 or more bytes
+// before the end.
+constexpr size_t min_match = 4;
+constexpr size_t last_literals = 5;
+constexpr size_t match_limit = 12;
+
+uint32_t read32(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint32_t hash(uint32_t sequence, unsigned bits) {
+    return (sequence * 2654435761u) >> (32 - bits);
+}
+
+// Lengths of 15 or more continue after the token as 255, 255, ..., remainder.
+int append_length(ValueWriter& out, size_t length) {
+    static const uint8_t run[16] = {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255};
+    length -= 15;
+    while (length >= 255) {
+        size_t count = std::min(length / 255, sizeof(run));
+        int rc = out.append(run, count);
+        if (rc != 0) {
+            return rc;
+        }
+        length -= count * 255;
+    }
+    uint8_t last = static_cast<uint8_t>(length);
+    return out.append(&last, 1);
+}
+
+/**
+ * One sequence: token, literal length, literals, then offset and match length
+ * unless match_length is 0 (the last sequence of a block).
+ */
+int emit_sequence(ValueWriter& out, const uint8_t* literals, size_t literal_length, size_t offset, size_t match_length) {
+    size_t code = match_length ? match_length - min_match : 0;
+    uint8_t token = static_cast<uint8_t>(((literal_length < 15 ? literal_length : 15) << 4) | (code < 15 ? code : 15));
+    int rc = out.append(&token, 1);
+    if (rc == 0 && literal_length >= 15) {
+        rc = append_length(out, literal_length);
+    }
+    if (rc == 0 && literal_length) {
+        rc = out.append(literals, literal_length);
+    }
+    if (rc != 0 || match_length == 0) {
+        return rc;
+    }
+    uint8_t le_offset[2] = {static_cast<uint8_t>(offset), static_cast<uint8_t>(offset >> 8)};
+    rc = out.append(le_offset, sizeof(le_offset));
+    if (rc == 0 && code >= 15) {
+        rc = append_length(out, code);
+    }
+    return rc;
+}
+
+/**
+ * Compress buffer[start, end) as one block. buffer[0, start) was compressed
+ * before (the history); matches may reach back window bytes into it. table
+ * holds 16-bit stream positions (base + index) of earlier 4-byte sequences;
+ * stale or foreign entries are harmless because every candidate is verified.
+ */
+int compress_block(const uint8_t* buffer, size_t start, size_t end, uint32_t base,
+                   uint16_t* table, unsigned bits, size_t window, ValueWriter& out) {
+    size_t anchor = start;
+    if (end - start > match_limit) {
+        size_t ip = start;
+        size_t match_end = end - last_literals;
+        size_t misses = 0;
+        while (ip + match_limit <= end) {
+            uint32_t sequence = read32(buffer + ip);
+            uint16_t* slot = &table[hash(sequence, bits)];
+            uint16_t position = static_cast<uint16_t>(base + ip);
+            size_t distance = static_cast<uint16_t>(position - *slot);
+            *slot = position;
+            if (distance == 0 || distance > window || distance > ip || read32(buffer + ip - distance) != sequence) {
+                // Skip faster through data that does not compress.
+                ip += 1 + (misses++ >> 5);
+                continue;
+            }
+            misses = 0;
+            size_t ref = ip - distance;
+            while (ip > anchor && ref > 0 && buffer[ip - 1] == buffer[ref - 1]) {
+                --ip;
+                --ref;
+            }
+            size_t length = min_match;
+            while (ip + length < match_end && buffer[ip + length] == buffer[ref + length]) {
+                ++length;
+            }
+            int rc = emit_sequence(out, buffer + anchor, ip - anchor, distance, length);
+            if (rc != 0) {
+                return rc;
+            }
+            ip += length;
+            anchor = ip;
+            // Index a position inside the match so that repeats of it are found too.
+            table[hash(read32(buffer + ip - 2), bits)] = static_cast<uint16_t>(base + ip - 2);
+        }
+    }
+    return emit_sequence(out, buffer + anchor, end - anchor, 0, 0);
+}
+
+bool get_length(const uint8_t* data, size_t len, size_t& ip, size_t& length) {
+    uint8_t byte;
+    do {
+        if (ip >= len) {
+            return false;
+        }
+        byte = data[ip++];
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+} // namespace
+
+const ble_uuid128_t LzCodec::descriptor_uuid = BLE_UUID128_INIT(0x01, 0x00, 0x7A, 0x6C, 0x5E, 0x4B, 0x1E, 0x5C,
+                                                                0x1C, 0x9D, 0x53, 0x8A, 0x01, 0xB1, 0x3C, 0xC0);
+
+int LzCodec::compress(const uint8_t* data, size_t len, ValueWriter& out, Table& table) {
+    if (len > UINT16_MAX) {
+        return BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+    // Start empty so equal values always compress to the same bytes.
+    std::memset(table.slots, 0, sizeof(table.slots));
+    constexpr size_t slots = sizeof(table.slots) / sizeof(table.slots[0]);
+    static_assert((slots & (slots - 1)) == 0, "table size must be a power of two");
+    constexpr unsigned bits = __builtin_ctz(slots);
+    return compress_block(data, 0, len, 0, table.slots, bits, UINT16_MAX, out);
+}
+
+int LzCodec::compress(const uint8_t* data, size_t len, ValueWriter& out) {
+    Table table;
+    return compress(data, len, out, table);
+}
+
+int LzCodec::decompress(const uint8_t* data, size_t len, uint8_t* out, size_t capacity, size_t history) {
+    size_t ip = 0;
+    size_t op = 0;
+    while (ip < len) {
+        uint8_t token = data[ip++];
+        size_t literal_length = token >> 4;
+        if (literal_length == 15 && !get_length(data, len, ip, literal_length)) {
+            return -1;
+        }
+        if (literal_length > len - ip || literal_length > capacity - op) {
+            return -1;
+        }
+        std::memcpy(out + op, data + ip, literal_length);
+        ip += literal_length;
+        op += literal_length;
+        if (ip == len) {
+            break;
+        }
+        if (len - ip < 2) {
+            return -1;
+        }
+        size_t offset = static_cast<size_t>(data[ip] | (data[ip + 1] << 8));
+        ip += 2;
+        size_t length = token & 0x0F;
+        if (length == 15 && !get_length(data, len, ip, length)) {
+            return -1;
+        }
+        length += min_match;
+        if (offset == 0 || offset > op + history || length > capacity - op) {
+            return -1;
+        }
+        const uint8_t* ref = out + op - offset;
+        if (offset >= length) {
+            std::memcpy(out + op, ref, length);
+        } else {
+            // Overlapping match: repeats the last offset bytes.
+            for (size_t i = 0; i < length; ++i) {
+                out[op + i] = ref[i];
+            }
+        }
+        op += length;
+    }
+    return static_cast<int>(op);
+}
+
+void LzStreamEncoder::reset() {
+    history = 0;
+    staged = 0;
+    base = 0;
+    std::memset(table, 0, sizeof(table));
+}
+
+int LzStreamEncoder::compress(const uint8_t* data, size_t len, uint8_t* out, size_t capacity) {
+    if (len > max_chunk) {
+        staged = 0;
+        return -1;
+    }
+    std::memcpy(stage(), data, len);
+    ValueWriter writer(out, capacity);
+    if (compress_staged(len, writer) != 0) {
+        return -1;
+    }
+    return static_cast<int>(writer.size());
+}
+
+uint8_t* LzStreamEncoder::stage() {
+    staged = 0;
+    if (history > window) {
+        // Keep the last window bytes; the table stores stream positions, so it stays valid.
+        size_t drop = history - window;
+        std::memmove(buffer, buffer + drop, window);
+        base += static_cast<uint32_t>(drop);
+        history = window;
+    }
+    return buffer + history;
+}
+
+int LzStreamEncoder::compress_staged(size_t len, ValueWriter& out) {
+    staged = 0;
+    if (len > max_chunk) {
+        return -1;
+    }
+    if (compress_block(buffer, history, history + len, base, table, hash_bits, window, out) != 0) {
+        return -1;
+    }
+    staged = len;
+    return 0;
+}
+
+void LzStreamEncoder::commit() {
+    history += staged;
+    staged = 0;
+}
+
+int LzStreamDecoder::decompress(const uint8_t* data, size_t len, const uint8_t** out) {
+    history += last;
+    last = 0;
+    if (history > window) {
+        std::memmove(buffer, buffer + history - window, window);
+        history = window;
+    }
+    int decoded = LzCodec::decompress(data, len, buffer + history, max_chunk, history);
+    if (decoded < 0) {
+        return -1;
+    }
+    last = static_cast<size_t>(decoded);
+    *out = buffer + history;
+    return decoded;
+}
+
+} // namespace CustomBLE
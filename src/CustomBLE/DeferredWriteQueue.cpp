@@ -0,0 +1,87 @@
+#include "CustomBLE/DeferredWriteQueue.hpp"
+#include "CustomBLE/Characteristic.hpp"
+
+static const char *TAG = "CustomBLE/DeferredWriteQueue";
+
+namespace CustomBLE {
+
+DeferredWriteQueue::DeferredWriteQueue(size_t capacity, OverflowPolicy policy)
+    : storage(new Record[(capacity + sizeof(Record) - 1) / sizeof(Record)]),
+      capacity((capacity + sizeof(Record) - 1) / sizeof(Record) * sizeof(Record)),
+      policy(policy) {}
+
+int DeferredWriteQueue::push(const Characteristic& characteristic, const ValueReader& value) {
+    size_t need = align(sizeof(Record) + value.size());
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t t = tail.load(std::memory_order_acquire);
+    // One alignment unit always stays free, so head == tail means empty.
+    constexpr size_t gap = alignof(Record);
+    size_t position = h;
+    bool fits;
+    if (h >= t) {
+        fits = need <= capacity - h && need + gap <= capacity - h + t;
+        if (!fits && need + gap <= t) {
+            // Not enough room before the end: continue at the start of the ring.
+            if (capacity - h >= sizeof(Record)) {
+                *reinterpret_cast<Record*>(at(h)) = Record {nullptr, 0};
+            }
+            position = 0;
+            fits = true;
+        }
+    } else {
+        fits = need + gap <= t - h;
+    }
+    if (!fits) {
+        if (policy == OverflowPolicy::Drop) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return 0;
+        }
+        if (rejected.fetch_add(1, std::memory_order_relaxed) == 0) {
+            ESP_LOGW(TAG, "Write queue full (%u bytes), rejecting writes", static_cast<unsigned>(capacity));
+        }
+        return BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+
+    uint8_t* record = at(position);
+    *reinterpret_cast<Record*>(record) = Record {&characteristic, static_cast<uint32_t>(value.size())};
+    value.copy_to(record + sizeof(Record), value.size());
+    size_t next = (position + need) % capacity;
+    head.store(next, std::memory_order_release);
+
+    queued.fetch_add(1, std::memory_order_relaxed);
+    size_t used = (next + capacity - t) % capacity;
+    if (used > high_water_bytes.load(std::memory_order_relaxed)) {
+        high_water_bytes.store(used, std::memory_order_relaxed);
+    }
+    if (wakeup) {
+        wakeup();
+    }
+    return 0;
+}
+
+size_t DeferredWriteQueue::drain(size_t max_writes) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t count = 0;
+    while (count < max_writes) {
+        size_t h = head.load(std::memory_order_acquire);
+        if (t == h) {
+            break;
+        }
+        const Record* record = capacity - t >= sizeof(Record) ? reinterpret_cast<const Record*>(at(t)) : nullptr;
+        if (!record || !record->characteristic) {
+            t = 0;
+            continue;
+        }
+        ValueReader reader(reinterpret_cast<const uint8_t*>(record + 1), record->length);
+        record->characteristic->dispatch_write(reader);
+        t = (t + align(sizeof(Record) + record->length)) % capacity;
+        // Hand the space back after every write so the host task can queue more meanwhile.
+        tail.store(t, std::memory_order_release);
+        ++count;
+    }
+    tail.store(t, std::memory_order_release);
+    dispatched.fetch_add(count, std::memory_order_relaxed);
+    return count;
+}
+
+} // namespace CustomBLE
@@ -0,0 +1,118 @@
+#include "CustomBLE/IngestCharacteristic.hpp"
+
+namespace CustomBLE {
+namespace {
+
+constexpr size_t status_size = 18;
+
+size_t round_up_pow2(size_t value) {
+    size_t rounded = 1;
+    while (rounded < value) {
+        rounded <<= 1;
+    }
+    return rounded;
+}
+
+void put_le(uint8_t*& p, uint32_t value, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        *p++ = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+} // namespace
+
+std::shared_ptr<IngestCharacteristic> IngestCharacteristic::create(const char* name, const ble_uuid128_t& uuid,
+                                                                   size_t slot_count, uint16_t max_payload) {
+    return std::make_shared<IngestCharacteristic>(Token {}, name, uuid, slot_count, max_payload);
+}
+
+IngestCharacteristic::IngestCharacteristic(Token, const char* name, const ble_uuid128_t& uuid,
+                                           size_t slot_count, uint16_t max_payload)
+    : Characteristic(name, uuid, ReadCallback(), WriteCallback()),
+      slot_count(round_up_pow2(slot_count)),
+      // Slots stay aligned for their header.
+      slot_stride((sizeof(Slot) + max_payload + alignof(Slot) - 1) & ~(alignof(Slot) - 1)),
+      max_payload(max_payload) {
+    storage.reset(new uint8_t[this->slot_count * slot_stride]);
+    set_write_view_callback([this](ValueReader& in) { return handle_packet(in); });
+    set_read_sink_callback([this](ValueWriter& out) { return write_status(out); });
+    set_write_without_response_enabled(true);
+    set_max_length(static_cast<uint16_t>(header_size + max_payload));
+}
+
+int IngestCharacteristic::handle_packet(ValueReader& in) {
+    if (reset_requested.exchange(false, std::memory_order_acq_rel)) {
+        synced = false;
+        received.store(0, std::memory_order_relaxed);
+        gaps.store(0, std::memory_order_relaxed);
+        overflows.store(0, std::memory_order_relaxed);
+        stale.store(0, std::memory_order_relaxed);
+        malformed.store(0, std::memory_order_relaxed);
+    }
+    uint16_t conn_handle = access_conn_handle();
+    if (conn_handle != writer) {
+        // A new connection starts a new upload.
+        writer = conn_handle;
+        synced = false;
+    }
+    uint8_t header[header_size];
+    if (in.size() < header_size || in.copy_to(header, header_size) != 0) {
+        malformed.fetch_add(1, std::memory_order_relaxed);
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+    uint16_t sequence = static_cast<uint16_t>(header[0] | (header[1] << 8));
+    uint16_t delta = 0;
+    if (synced) {
+        delta = static_cast<uint16_t>(sequence - expected);
+        if (delta >= 0x8000) {
+            stale.fetch_add(1, std::memory_order_relaxed);
+            return 0;
+        }
+    }
+    // A rejected packet leaves the expected sequence alone, so the central's retry is accepted.
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= slot_count) {
+        overflows.fetch_add(1, std::memory_order_relaxed);
+        return BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+    if (delta != 0) {
+        gaps.fetch_add(delta, std::memory_order_relaxed);
+    }
+    expected = static_cast<uint16_t>(sequence + 1);
+    synced = true;
+
+    Slot& slot = slot_at(h);
+    slot.sequence = sequence;
+    slot.length = static_cast<uint16_t>(in.size() - header_size);
+    in.copy_to(&slot + 1, slot.length, header_size);
+    head.store(h + 1, std::memory_order_release);
+    received.fetch_add(1, std::memory_order_relaxed);
+    if (wakeup) {
+        wakeup();
+    }
+    return 0;
+}
+
+int IngestCharacteristic::write_status(ValueWriter& out) const {
+    Counters counters = get_counters();
+    uint8_t status[status_size];
+    uint8_t* p = status;
+    put_le(p, synced ? expected : 0, 2);
+    put_le(p, counters.received, 4);
+    put_le(p, counters.gaps, 4);
+    put_le(p, counters.overflows, 4);
+    put_le(p, counters.stale, 4);
+    return out.append(status, sizeof(status));
+}
+
+IngestCharacteristic::Counters IngestCharacteristic::get_counters() const {
+    Counters counters;
+    counters.received = received.load(std::memory_order_relaxed);
+    counters.gaps = gaps.load(std::memory_order_relaxed);
+    counters.overflows = overflows.load(std::memory_order_relaxed);
+    counters.stale = stale.load(std::memory_order_relaxed);
+    counters.malformed = malformed.load(std::memory_order_relaxed);
+    return counters;
+}
+
+} // namespace CustomBLE
@@ -0,0 +1,301 @@
+#include "CustomBLE/L2capEndpoint.hpp"
+#include <nimble/nimble_port.h>
+#include <esp_log.h>
+
+static const char *TAG = "CustomBLE/L2capEndpoint";
+
+namespace CustomBLE {
+
+L2capEndpoint::L2capEndpoint(uint16_t psm, uint16_t mtu) : psm(psm), mtu(mtu) {
+    ble_npl_event_init(&rearm_event, &L2capEndpoint::rearm_handler, this);
+    ble_npl_event_init(&handover_event, &L2capEndpoint::handover_handler, this);
+}
+
+L2capEndpoint::~L2capEndpoint() {
+    ble_npl_eventq_remove(nimble_port_get_dflt_eventq(), &rearm_event);
+    ble_npl_eventq_remove(nimble_port_get_dflt_eventq(), &handover_event);
+    for (Handover& handover : handovers) {
+        if (handover.state.load(std::memory_order_acquire) == Handover::Ready) {
+            os_mbuf_free_chain(handover.sdu);
+        }
+    }
+}
+
+int L2capEndpoint::start() {
+    int rc = ble_l2cap_create_server(psm, mtu, &L2capEndpoint::l2cap_event, this);
+    if (rc != 0) {
+        ESP_LOGE(TAG, "ble_l2cap_create_server(psm 0x%04x) failed: %d", psm, rc);
+    }
+    return rc;
+}
+
+TypedCharacteristic<uint16_t> L2capEndpoint::psm_characteristic(const char* name, const ble_uuid128_t& uuid) const {
+    return TypedCharacteristic<uint16_t>(name, uuid, [psm = psm]() { return psm; });
+}
+
+int L2capEndpoint::send(uint16_t conn_handle, os_mbuf* sdu) {
+    Channel* channel = find(conn_handle);
+    if (!channel) {
+        return BLE_HS_ENOTCONN;
+    }
+    if (channel->tx_stalled) {
+        return BLE_HS_EBUSY;
+    }
+    int rc = ble_l2cap_send(channel->chan, sdu);
+    if (rc == BLE_HS_ESTALLED) {
+        // Taken, but out of credits: the rest goes out as the peer grants more.
+        channel->tx_stalled = true;
+        return 0;
+    }
+    return rc;
+}
+
+int L2capEndpoint::send(uint16_t conn_handle, const void* data, size_t len) {
+    if (len > UINT16_MAX) {
+        return BLE_HS_EBADDATA;
+    }
+    if (!can_send(conn_handle)) {
+        return is_connected(conn_handle) ? BLE_HS_EBUSY : BLE_HS_ENOTCONN;
+    }
+    os_mbuf* sdu = ble_hs_mbuf_from_flat(data, static_cast<uint16_t>(len));
+    if (!sdu) {
+        return BLE_HS_ENOMEM;
+    }
+    int rc = send(conn_handle, sdu);
+    if (rc != 0) {
+        os_mbuf_free_chain(sdu);
+    }
+    return rc;
+}
+
+int L2capEndpoint::post_send(uint16_t conn_handle, os_mbuf* sdu) {
+    Handover* slot = nullptr;
+    for (Handover& handover : handovers) {
+        uint8_t state = handover.state.load(std::memory_order_acquire);
+        if (state != Handover::Free && handover.conn_handle.load(std::memory_order_relaxed) == conn_handle) {
+            // Keeps the SDUs of a channel in order: the previous one is still waiting.
+            return BLE_HS_EBUSY;
+        }
+        uint8_t expected = Handover::Free;
+        if (!slot && state == Handover::Free &&
+            handover.state.compare_exchange_strong(expected, Handover::Filling, std::memory_order_acquire)) {
+            slot = &handover;
+        }
+    }
+    if (!slot) {
+        return BLE_HS_EBUSY;
+    }
+    slot->conn_handle.store(conn_handle, std::memory_order_relaxed);
+    slot->sdu = sdu;
+    slot->state.store(Handover::Ready, std::memory_order_release);
+    if (!ble_npl_event_is_queued(&handover_event)) {
+        ble_npl_eventq_put(nimble_port_get_dflt_eventq(), &handover_event);
+    }
+    return 0;
+}
+
+void L2capEndpoint::send_handovers() {
+    for (Handover& handover : handovers) {
+        if (handover.state.load(std::memory_order_acquire) != Handover::Ready) {
+            continue;
+        }
+        uint16_t conn_handle = handover.conn_handle.load(std::memory_order_relaxed);
+        int rc = send(conn_handle, handover.sdu);
+        if (rc == BLE_HS_EBUSY) {
+            continue;  // waiting for credits: sent again on TX_UNSTALLED
+        }
+        if (rc != 0) {
+            ESP_LOGW(TAG, "Dropped an SDU posted for connection %u: %d", conn_handle, rc);
+            os_mbuf_free_chain(handover.sdu);
+        }
+        handover.sdu = nullptr;
+        handover.state.store(Handover::Free, std::memory_order_release);
+    }
+}
+
+void L2capEndpoint::resume_receive(uint16_t conn_handle) {
+    Channel* channel = find(conn_handle);
+    if (channel && channel->rx_paused) {
+        channel->rx_paused = false;
+        post_receive_buffer(*channel);
+    }
+}
+
+int L2capEndpoint::disconnect(uint16_t conn_handle) {
+    Channel* channel = find(conn_handle);
+    if (!channel) {
+        return BLE_HS_ENOTCONN;
+    }
+    return ble_l2cap_disconnect(channel->chan);
+}
+
+bool L2capEndpoint::can_send(uint16_t conn_handle) const {
+    const Channel* channel = find(conn_handle);
+    return channel && !channel->tx_stalled;
+}
+
+uint16_t L2capEndpoint::get_peer_mtu(uint16_t conn_handle) const {
+    const Channel* channel = find(conn_handle);
+    return channel ? channel->peer_mtu : 0;
+}
+
+size_t L2capEndpoint::channel_count() const {
+    size_t count = 0;
+    for (const Channel& channel : channels) {
+        count += channel.chan ? 1 : 0;
+    }
+    return count;
+}
+
+int L2capEndpoint::post_receive_buffer(Channel& channel) {
+    os_mbuf* sdu = os_msys_get_pkthdr(mtu, 0);
+    if (!sdu) {
+        // No receive buffer means no credits for the peer: retry once the host task has freed mbufs.
+        channel.rx_needs_buffer = true;
+        ble_npl_eventq_put(nimble_port_get_dflt_eventq(), &rearm_event);
+        return BLE_HS_ENOMEM;
+    }
+    channel.rx_needs_buffer = false;
+    int rc = ble_l2cap_recv_ready(channel.chan, sdu);
+    if (rc != 0) {
+        os_mbuf_free_chain(sdu);
+        ESP_LOGW(TAG, "ble_l2cap_recv_ready failed: %d", rc);
+    }
+    return rc;
+}
+
+int L2capEndpoint::handle_event(ble_l2cap_event& event) {
+    switch (event.type) {
+        case BLE_L2CAP_EVENT_COC_ACCEPT: {
+            if (find(event.accept.conn_handle)) {
+                ESP_LOGW(TAG, "Connection %u already has a channel", event.accept.conn_handle);
+                return BLE_HS_EALREADY;
+            }
+            Channel* channel = find(nullptr);
+            if (!channel) {
+                ESP_LOGW(TAG, "No free channel for connection %u", event.accept.conn_handle);
+                return BLE_HS_ENOMEM;
+            }
+            *channel = Channel {};
+            channel->chan = event.accept.chan;
+            channel->conn_handle = event.accept.conn_handle;
+            channel->peer_mtu = event.accept.peer_sdu_size;
+            int rc = post_receive_buffer(*channel);
+            if (rc != 0) {
+                *channel = Channel {};
+            }
+            return rc;
+        }
+        case BLE_L2CAP_EVENT_COC_CONNECTED: {
+            Channel* channel = find(event.connect.chan);
+            if (!channel) {
+                return 0;
+            }
+            if (event.connect.status != 0) {
+                *channel = Channel {};
+                return 0;
+            }
+            ble_l2cap_chan_info info;
+            if (ble_l2cap_get_chan_info(event.connect.chan, &info) == 0) {
+                channel->peer_mtu = info.peer_coc_mtu;
+            }
+            if (event_callback) {
+                event_callback(channel->conn_handle, Event::Connected);
+            }
+            return 0;
+        }
+        case BLE_L2CAP_EVENT_COC_DISCONNECTED: {
+            Channel* channel = find(event.disconnect.chan);
+            if (!channel) {
+                return 0;
+            }
+            uint16_t conn_handle = channel->conn_handle;
+            *channel = Channel {};
+            // An SDU posted for the closed channel is dropped now, not sent on a later one.
+            send_handovers();
+            if (event_callback) {
+                event_callback(conn_handle, Event::Disconnected);
+            }
+            return 0;
+        }
+        case BLE_L2CAP_EVENT_COC_DATA_RECEIVED: {
+            Channel* channel = find(event.receive.chan);
+            if (!channel) {
+                os_mbuf_free_chain(event.receive.sdu_rx);
+                return 0;
+            }
+            bool more = true;
+            if (receive_callback) {
+                more = receive_callback(channel->conn_handle, event.receive.sdu_rx);
+            } else {
+                os_mbuf_free_chain(event.receive.sdu_rx);
+            }
+            // The callback may have closed the channel.
+            if (channel->chan != event.receive.chan) {
+                return 0;
+            }
+            if (more) {
+                post_receive_buffer(*channel);
+            } else {
+                channel->rx_paused = true;
+            }
+            return 0;
+        }
+        case BLE_L2CAP_EVENT_COC_TX_UNSTALLED: {
+            Channel* channel = find(event.tx_unstalled.chan);
+            if (!channel) {
+                return 0;
+            }
+            channel->tx_stalled = false;
+            uint16_t conn_handle = channel->conn_handle;
+            send_handovers();
+            if (event_callback && can_send(conn_handle)) {
+                event_callback(conn_handle, Event::TxReady);
+            }
+            return 0;
+        }
+        default:
+            return 0;
+    }
+}
+
+int L2capEndpoint::l2cap_event(ble_l2cap_event* event, void* arg) {
+    return static_cast<L2capEndpoint*>(arg)->handle_event(*event);
+}
+
+void L2capEndpoint::rearm_handler(ble_npl_event* ev) {
+    auto* endpoint = static_cast<L2capEndpoint*>(ble_npl_event_get_arg(ev));
+    for (Channel& channel : endpoint->channels) {
+        if (channel.chan && channel.rx_needs_buffer && !channel.rx_paused) {
+            endpoint->post_receive_buffer(channel);
+        }
+    }
+}
+
+void L2capEndpoint::handover_handler(ble_npl_event* ev) {
+    static_cast<L2capEndpoint*>(ble_npl_event_get_arg(ev))->send_handovers();
+}
+
+L2capEndpoint::Channel* L2capEndpoint::find(uint16_t conn_handle) {
+    for (Channel& channel : channels) {
+        if (channel.chan && channel.conn_handle == conn_handle) {
+            return &channel;
+        }
+    }
+    return nullptr;
+}
+
+const L2capEndpoint::Channel* L2capEndpoint::find(uint16_t conn_handle) const {
+    return const_cast<L2capEndpoint*>(this)->find(conn_handle);
+}
+
+L2capEndpoint::Channel* L2capEndpoint::find(const ble_l2cap_chan* chan) {
+    for (Channel& channel : channels) {
+        if (channel.chan == chan) {
+            return &channel;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace CustomBLE
@@ -0,0 +1,70 @@
+#include "CustomBLE/NotificationEngine.hpp"
+#include "CustomBLE/Characteristic.hpp"
+#include <nimble/nimble_port.h>
+
+namespace CustomBLE {
+
+NotificationEngine::NotificationEngine() {
+    ble_npl_event_init(&event, &NotificationEngine::event_handler, this);
+}
+
+NotificationEngine::~NotificationEngine() {
+    ble_npl_eventq_remove(nimble_port_get_dflt_eventq(), &event);
+}
+
+void NotificationEngine::schedule(Characteristic& characteristic) {
+    Characteristic::Extension* ext = characteristic.extension.get();
+    if (!ext) {
+        // Never subscribed: there is nobody to send to.
+        return;
+    }
+    NotificationLink& link = ext->notification_link;
+    bool expected = false;
+    if (!link.queued.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+        // Already pending: the next flush sends the then-current value.
+        return;
+    }
+    Characteristic* head = pending_head.load(std::memory_order_relaxed);
+    do {
+        link.next = head;
+    } while (!pending_head.compare_exchange_weak(head, &characteristic,
+                                                 std::memory_order_release, std::memory_order_relaxed));
+    if (!wakeup_posted.exchange(true, std::memory_order_acq_rel)) {
+        wakeups.fetch_add(1, std::memory_order_relaxed);
+        ble_npl_eventq_put(nimble_port_get_dflt_eventq(), &event);
+    }
+}
+
+size_t NotificationEngine::flush() {
+    // Clear the wakeup flag first so anything scheduled from here on posts a new event.
+    wakeup_posted.store(false, std::memory_order_release);
+    Characteristic* list = pending_head.exchange(nullptr, std::memory_order_acquire);
+
+    // The pending list is LIFO; reverse it so notifications go out in schedule order.
+    Characteristic* ordered = nullptr;
+    while (list) {
+        NotificationLink& link = list->extension.get()->notification_link;
+        Characteristic* next = link.next;
+        link.next = ordered;
+        ordered = list;
+        list = next;
+    }
+
+    size_t count = 0;
+    while (ordered) {
+        NotificationLink& link = ordered->extension.get()->notification_link;
+        Characteristic* next = link.next;
+        link.next = nullptr;
+        link.queued.store(false, std::memory_order_release);
+        ordered->notify();
+        ordered = next;
+        ++count;
+    }
+    return count;
+}
+
+void NotificationEngine::event_handler(ble_npl_event* ev) {
+    static_cast<NotificationEngine*>(ble_npl_event_get_arg(ev))->flush();
+}
+
+} // namespace CustomBLE
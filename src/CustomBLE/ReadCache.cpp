@@ -0,0 +1,67 @@
+#include "CustomBLE/ReadCache.hpp"
+
+namespace CustomBLE {
+
+ReadCache& ReadCache::operator=(const ReadCache& other) {
+    // Copies carry the configuration, not the cached value.
+    if (this != &other) {
+        if (other.enabled()) {
+            enable(static_cast<uint32_t>(other.ttl_us / 1000), other.limit);
+        } else {
+            disable();
+        }
+    }
+    return *this;
+}
+
+void ReadCache::enable(uint32_t ttl_ms, size_t new_limit) {
+    if (capacity > new_limit) {
+        buffer.reset();
+        capacity = 0;
+    }
+    limit = new_limit;
+    ttl_us = static_cast<int64_t>(ttl_ms) * 1000;
+    valid = false;
+    invalidate();
+}
+
+void ReadCache::disable() {
+    buffer.reset();
+    capacity = 0;
+    limit = 0;
+    length = 0;
+    ttl_us = 0;
+    valid = false;
+}
+
+const uint8_t* ReadCache::lookup(int64_t now_us, size_t& len) const {
+    if (valid && now_us < expires_us &&
+        stored_generation == generation.load(std::memory_order_acquire)) {
+        ++hits;
+        len = length;
+        return buffer.get();
+    }
+    ++misses;
+    return nullptr;
+}
+
+uint8_t* ReadCache::reserve(size_t len) {
+    if (len > limit) {
+        return nullptr;
+    }
+    if (!buffer || len > capacity) {
+        valid = false;
+        buffer.reset(new uint8_t[len ? len : 1]);
+        capacity = len;
+    }
+    return buffer.get();
+}
+
+void ReadCache::store(size_t len, int64_t now_us, uint32_t fill_generation) {
+    length = len;
+    expires_us = now_us + ttl_us;
+    stored_generation = fill_generation;
+    valid = true;
+}
+
+} // namespace CustomBLE
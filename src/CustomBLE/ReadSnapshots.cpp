@@ -0,0 +1,92 @@
+#include "CustomBLE/ReadSnapshots.hpp"
+
+namespace CustomBLE {
+namespace {
+
+#ifdef CONFIG_BT_NIMBLE_MAX_CONNECTIONS
+constexpr size_t snapshot_slots = CONFIG_BT_NIMBLE_MAX_CONNECTIONS;
+#else
+constexpr size_t snapshot_slots = 4;
+#endif
+
+ReadSnapshots::Snapshot snapshots[snapshot_slots];
+
+} // namespace
+
+ReadSnapshots::Snapshot* ReadSnapshots::find(uint16_t conn_handle, const void* owner, int64_t now_us) {
+    for (auto& snapshot : snapshots) {
+        const void* current = snapshot.owner.load(std::memory_order_relaxed);
+        if (!current || snapshot.conn_handle != conn_handle) {
+            continue;
+        }
+        if (current != owner || snapshot.stale.load(std::memory_order_acquire) ||
+            now_us - snapshot.started_us > static_cast<int64_t>(long_read_timeout_ms) * 1000) {
+            release(&snapshot);
+            return nullptr;
+        }
+        return &snapshot;
+    }
+    return nullptr;
+}
+
+ReadSnapshots::Snapshot* ReadSnapshots::acquire(uint16_t conn_handle) {
+    Snapshot* free_slot = nullptr;
+    for (auto& snapshot : snapshots) {
+        bool used = snapshot.owner.load(std::memory_order_relaxed) != nullptr;
+        if (used && snapshot.conn_handle == conn_handle) {
+            return &snapshot;
+        }
+        if (!used && !free_slot) {
+            free_slot = &snapshot;
+        }
+    }
+    return free_slot;
+}
+
+void ReadSnapshots::capture(Snapshot* snapshot, const void* owner, uint16_t conn_handle, uint16_t sent, int64_t now_us) {
+    snapshot->conn_handle = conn_handle;
+    snapshot->sent = sent;
+    snapshot->started_us = now_us;
+    snapshot->stale.store(false, std::memory_order_relaxed);
+    snapshot->owner.store(owner, std::memory_order_release);
+}
+
+void ReadSnapshots::invalidate(const void* owner) {
+    for (auto& snapshot : snapshots) {
+        if (snapshot.owner.load(std::memory_order_acquire) == owner) {
+            snapshot.stale.store(true, std::memory_order_release);
+        }
+    }
+}
+
+void ReadSnapshots::release(Snapshot* snapshot) {
+    if (snapshot) {
+        snapshot->owner.store(nullptr, std::memory_order_release);
+    }
+}
+
+void ReadSnapshots::drop(uint16_t conn_handle) {
+    for (auto& snapshot : snapshots) {
+        if (snapshot.owner.load(std::memory_order_relaxed) && snapshot.conn_handle == conn_handle) {
+            release(&snapshot);
+        }
+    }
+}
+
+void ReadSnapshots::drop_all() {
+    for (auto& snapshot : snapshots) {
+        release(&snapshot);
+    }
+}
+
+size_t ReadSnapshots::active_count() {
+    size_t count = 0;
+    for (const auto& snapshot : snapshots) {
+        if (snapshot.owner.load(std::memory_order_relaxed)) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+} // namespace CustomBLE
@@ -1,9 +1,11 @@
 #include "CustomBLE/Service.hpp"
 
+static const char *TAG = "CustomBLE/Service";
+
 namespace CustomBLE {
 
-Service::Service(const char* name, const ble_uuid128_t& uuid)
-    : service_uuid(uuid), name(name) {
+Service::Service(const char* name, const ble_uuid128_t& uuid, Arena* arena)
+    : service_uuid(uuid), characteristics_manager(arena), name(name) {
     svc_def = {};
     svc_def.type = BLE_GATT_SVC_TYPE_PRIMARY;
     svc_def.uuid = &service_uuid.u;
@@ -11,12 +13,18 @@ Service::Service(const char* name, const ble_uuid128_t& uuid)
     // svc_def.chrs = nullptr; // Will be set in get_svc_def() -- REMOVE, not present in ble_gatt_svc_def
 }
 
-void Service::add_characteristic(std::shared_ptr<Characteristic> characteristic) {
-    characteristics_manager.add_characteristic(std::move(characteristic));
+esp_err_t Service::add_characteristic(std::shared_ptr<Characteristic> characteristic) {
+    return characteristics_manager.add_characteristic(std::move(characteristic));
 }
 
-void Service::add_characteristic(Characteristic&& characteristic) {
-    characteristics_manager.add_characteristic(std::make_shared<Characteristic>(std::move(characteristic)));
+esp_err_t Service::add_characteristic(Characteristic&& characteristic) {
+    if (characteristics_manager.is_frozen()) {
+        const char* characteristic_name = characteristic.get_name();
+        ESP_LOGE(TAG, "Characteristic '%s' added after the GATT table was frozen; ignored",
+                 characteristic_name ? characteristic_name : "");
+        return ESP_ERR_INVALID_STATE;
+    }
+    return characteristics_manager.add_characteristic(characteristics_manager.make_characteristic(std::move(characteristic)));
 }
 
 ble_gatt_svc_def Service::get_svc_def() {
@@ -79,14 +87,14 @@ void Service::print() const {
 std::shared_ptr<Characteristic> Service::emplace_characteristic(const ble_uuid128_t& characteristic_uuid,
                                                 Characteristic::ReadCallback read_cb,
                                                 Characteristic::WriteCallback write_cb) {
-    return characteristics_manager.emplace_characteristic(nullptr, characteristic_uuid, read_cb, write_cb);
+    return characteristics_manager.emplace_characteristic(nullptr, characteristic_uuid, std::move(read_cb), std::move(write_cb));
 }
 
 std::shared_ptr<Characteristic> Service::emplace_characteristic(const char* name,
                                                 const ble_uuid128_t& characteristic_uuid,
                                                 Characteristic::ReadCallback read_cb,
                                                 Characteristic::WriteCallback write_cb) {
-    return characteristics_manager.emplace_characteristic(name, characteristic_uuid, read_cb, write_cb);
+    return characteristics_manager.emplace_characteristic(name, characteristic_uuid, std::move(read_cb), std::move(write_cb));
 }
 
 } // namespace CustomBLE
@@ -1,13 +1,17 @@
 #include "CustomBLE/ServiceManager.hpp"
+#include "CustomBLE/Compression.hpp"
 #include <algorithm>
+#include <cstdint>
 #include <cstdlib>
-#include <unordered_map>
+#include <cstring>
 #include "esp_ble_conn_mgr.h"
 
 extern "C" {
 #include "nimble/nimble_port_freertos.h"
 }
 
+static const char *TAG = "CustomBLE/ServiceManager";
+
 namespace CustomBLE {
 namespace {
 
@@ -40,8 +44,6 @@ static int ensure_nimble_npl_ready(const char* tag) {
 #define BLE_SERVICE_VERBOSE_LOGI(...)
 #endif
 
-std::unordered_map<std::string, Characteristic*> g_ble_conn_characteristics;
-
 uint16_t convert_flags(uint16_t flags) {
     uint16_t converted = 0;
 
@@ -64,14 +66,45 @@ uint16_t convert_flags(uint16_t flags) {
     return converted;
 }
 
+const uint8_t* uuid_value(const Characteristic& characteristic) {
+    return reinterpret_cast<const ble_uuid128_t*>(characteristic.get_uuid())->value;
+}
+
+// FNV-1a over all 16 bytes: vendor UUIDs often differ only in the 16-bit alias (bytes 12..13).
+uint32_t uuid_hash(const uint8_t* value) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < BLE_UUID128_VAL_LEN; ++i) {
+        hash = (hash ^ value[i]) * 16777619u;
+    }
+    return hash;
+}
+
 } // namespace
 
-int ServiceManager::add_services_to_nimble(const char* tag) {
-    int npl_rc = ensure_nimble_npl_ready(tag);
-    if (npl_rc != 0) {
-        return npl_rc;
+ServiceManager::ServiceManager(Arena* arena)
+    : arena(arena),
+      services(ArenaAllocator<std::shared_ptr<Service>>(arena)),
+      svc_defs(ArenaAllocator<ble_gatt_svc_def>(arena)),
+      conn_mgr_characteristics(ArenaAllocator<ArenaVector<esp_ble_conn_character_t>>(arena)),
+      conn_mgr_services(ArenaAllocator<esp_ble_conn_svc_t>(arena)),
+      conn_mgr_bindings(ArenaAllocator<char>(arena)),
+      conn_mgr_read_buffer(ArenaAllocator<uint8_t>(arena)),
+      handle_index(ArenaAllocator<Characteristic*>(arena)),
+      uuid_index(ArenaAllocator<Characteristic*>(arena)) {
+}
+
+ServiceManager* ServiceManager::conn_mgr_managers = nullptr;
+
+ServiceManager::~ServiceManager() {
+    for (ServiceManager** link = &conn_mgr_managers; *link; link = &(*link)->next_conn_mgr) {
+        if (*link == this) {
+            *link = next_conn_mgr;
+            break;
+        }
     }
+}
 
+int ServiceManager::add_services_to_nimble(const char* tag) {
     ble_gatt_svc_def* svcs = get_svc_defs();
     if (svcs == nullptr) {
         ESP_LOGE(tag, "Service definition pointer is null (services=%u, svc_defs=%u)",
@@ -79,6 +112,23 @@ int ServiceManager::add_services_to_nimble(const char* tag) {
                  static_cast<unsigned>(svc_defs.size()));
         return BLE_HS_EINVAL;
     }
+    int rc = add_services_to_nimble(svcs, tag);
+    if (rc != 0) {
+        return rc;
+    }
+    attach_characteristics();
+    return 0;
+}
+
+int ServiceManager::add_services_to_nimble(const ble_gatt_svc_def* svcs, const char* tag) {
+    int npl_rc = ensure_nimble_npl_ready(tag);
+    if (npl_rc != 0) {
+        return npl_rc;
+    }
+    if (svcs == nullptr) {
+        ESP_LOGE(tag, "Service definition pointer is null");
+        return BLE_HS_EINVAL;
+    }
 
     // Verbose-only dump to inspect generated GATT definitions.
     for (int s = 0; svcs[s].type != BLE_GATT_SVC_TYPE_END; s++) {
@@ -132,22 +182,89 @@ esp_err_t ServiceManager::ble_conn_access_cb(const uint8_t *inbuf,
         return ESP_ERR_INVALID_ARG;
     }
 
-    auto it = g_ble_conn_characteristics.find(characteristic_name);
-    if (it == g_ble_conn_characteristics.end() || !it->second) {
+    ConnMgrBinding binding;
+    if (!find_conn_mgr_binding(characteristic_name, binding)) {
+        ESP_LOGE(TAG, "Connection manager access to unknown characteristic '%s'", characteristic_name);
         if (att_status) {
             *att_status = ESP_IOT_ATT_INVALID_HANDLE;
         }
         return ESP_ERR_NOT_FOUND;
     }
+#ifdef CONFIG_CUSTOMBLE_ACCESS_STATS
+    uint32_t start = AccessStats::now();
+    esp_err_t err = conn_mgr_access(binding, inbuf, inlen, outbuf, outlen, att_status);
+    size_t bytes = inbuf ? inlen : (outlen ? *outlen : 0);
+    binding.characteristic->access_stats.record(inbuf != nullptr, bytes, err, AccessStats::now() - start);
+    return err;
+#else
+    return conn_mgr_access(binding, inbuf, inlen, outbuf, outlen, att_status);
+#endif
+}
+
+size_t ServiceManager::conn_mgr_read_limit(const Characteristic& characteristic) {
+    size_t limit = characteristic.get_max_length();
+    return characteristic.get_compression() & Characteristic::CompressReads ? LzCodec::bound(limit) : limit;
+}
 
-    Characteristic* characteristic = it->second;
+bool ServiceManager::find_conn_mgr_binding(const char* name, ConnMgrBinding& binding) {
+    // Usually priv_data is the name pointer handed out by register_with_conn_mgr():
+    // inside a binding block, right behind its binding.
+    uintptr_t address = reinterpret_cast<uintptr_t>(name);
+    for (const ServiceManager* manager = conn_mgr_managers; manager; manager = manager->next_conn_mgr) {
+        uintptr_t begin = reinterpret_cast<uintptr_t>(manager->conn_mgr_bindings.data());
+        uintptr_t end = begin + manager->conn_mgr_bindings.size();
+        if (address >= begin + sizeof(ConnMgrBinding) && address < end) {
+            memcpy(&binding, name - sizeof(binding), sizeof(binding));
+            if (binding.name == name) {
+                return true;
+            }
+            break;
+        }
+    }
+    // A copy of the name: walk the blocks (binding, name, binding, name, ...).
+    for (const ServiceManager* manager = conn_mgr_managers; manager; manager = manager->next_conn_mgr) {
+        const char* next = manager->conn_mgr_bindings.data();
+        const char* end = next + manager->conn_mgr_bindings.size();
+        while (static_cast<size_t>(end - next) > sizeof(ConnMgrBinding)) {
+            memcpy(&binding, next, sizeof(binding));
+            if (!binding.name) {
+                break;  // block still being filled in
+            }
+            if (strcmp(binding.name, name) == 0) {
+                return true;
+            }
+            next = binding.name + strlen(binding.name) + 1;
+        }
+    }
+    return false;
+}
+
+esp_err_t ServiceManager::conn_mgr_access(const ConnMgrBinding& binding,
+                                          const uint8_t *inbuf,
+                                          uint16_t inlen,
+                                          uint8_t **outbuf,
+                                          uint16_t *outlen,
+                                          uint8_t *att_status) {
+    Characteristic* characteristic = binding.characteristic;
     if (!inbuf) {
-        std::string value = characteristic->read_value();
+        ArenaVector<uint8_t>& buffer = binding.manager->conn_mgr_read_buffer;
+        ValueWriter writer(buffer.data(), std::min(buffer.size(), conn_mgr_read_limit(*characteristic)));
+        const uint8_t* value = buffer.data();
+        int rc = characteristic->read_wire(writer);
+        if (rc != 0) {
+            // BLE_ATT_ERR_INSUFFICIENT_RES (ESP_IOT_ATT_INSUF_RESOURCE): longer than the declared max length.
+            if (att_status) {
+                *att_status = static_cast<uint8_t>(rc);
+            }
+            return rc == BLE_ATT_ERR_INSUFFICIENT_RES ? ESP_ERR_INVALID_SIZE : ESP_FAIL;
+        }
+        size_t value_size = writer.size();
         if (outlen) {
-            *outlen = static_cast<uint16_t>(value.size());
+            *outlen = static_cast<uint16_t>(value_size);
         }
-        if (!value.empty() && outbuf) {
-            *outbuf = static_cast<uint8_t*>(malloc(value.size()));
+        if (value_size > 0 && outbuf) {
+            // The connection manager free()s outbuf, so this one copy has to live on the heap.
+            *outbuf = static_cast<uint8_t*>(malloc(value_size));
             if (!*outbuf) {
                 if (att_status) {
                     *att_status = ESP_IOT_ATT_INSUF_RESOURCE;
@@ -157,20 +274,62 @@ esp_err_t ServiceManager::ble_conn_access_cb(const uint8_t *inbuf,
                 }
                 return ESP_ERR_NO_MEM;
             }
-            memcpy(*outbuf, value.data(), value.size());
+            memcpy(*outbuf, value, value_size);
         }
         return ESP_OK;
     }
 
-    characteristic->write_value(std::string(reinterpret_cast<const char*>(inbuf), inlen));
+    int rc = characteristic->receive_bytes(inbuf, inlen);
+    if (rc != 0) {
+        if (att_status) {
+            *att_status = static_cast<uint8_t>(rc);
+        }
+        return rc == BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN ? ESP_ERR_INVALID_SIZE : ESP_FAIL;
+    }
     return ESP_OK;
 }
 
 esp_err_t ServiceManager::register_with_conn_mgr() {
+    freeze();
     conn_mgr_characteristics.clear();
     conn_mgr_services.clear();
-    generated_characteristic_names.clear();
-    g_ble_conn_characteristics.clear();
+
+    // Characteristics without a name get a generated one; the connection manager needs a name.
+    auto binding_name = [](const Characteristic& characteristic, size_t index, char (&generated)[48]) {
+        const char* name = characteristic.get_name();
+        if (name && *name) {
+            return name;
+        }
+        const ble_uuid128_t* uuid = reinterpret_cast<const ble_uuid128_t*>(characteristic.get_uuid());
+        snprintf(generated, sizeof(generated), "customble-%02x%02x%02x%02x-%zu",
+                 uuid->value[0], uuid->value[1], uuid->value[2], uuid->value[3], index);
+        return static_cast<const char*>(generated);
+    };
+
+    // Size the binding block up front: name pointers handed out below must stay valid.
+    char generated_name[48];
+    size_t bindings_size = 0;
+    size_t max_read_length = 0;
+    for (const auto& service : services) {
+        if (!service) {
+            continue;
+        }
+        const auto& entries = service->get_characteristics_manager().get_entries();
+        for (size_t index = 0; index < entries.size(); ++index) {
+            bindings_size += sizeof(ConnMgrBinding) + strlen(binding_name(*entries[index].characteristic, index, generated_name)) + 1;
+            if (entries[index].characteristic->get_flags() & BLE_GATT_CHR_F_READ) {
+                max_read_length = std::max(max_read_length, conn_mgr_read_limit(*entries[index].characteristic));
+            }
+        }
+    }
+    conn_mgr_bindings.assign(bindings_size, 0);
+    if (!conn_mgr_linked) {
+        next_conn_mgr = conn_mgr_managers;
+        conn_mgr_managers = this;
+        conn_mgr_linked = true;
+    }
+    conn_mgr_read_buffer.assign(max_read_length, 0);
+    char* next_binding = conn_mgr_bindings.data();
 
     conn_mgr_characteristics.reserve(services.size());
     conn_mgr_services.reserve(services.size());
@@ -185,22 +344,19 @@ esp_err_t ServiceManager::register_with_conn_mgr() {
             continue;
         }
 
-        conn_mgr_characteristics.emplace_back();
+        conn_mgr_characteristics.emplace_back(ArenaAllocator<esp_ble_conn_character_t>(arena));
         auto& chars = conn_mgr_characteristics.back();
         chars.reserve(entries.size());
 
         for (size_t index = 0; index < entries.size(); ++index) {
             const auto& entry = entries[index];
-            const char* name = entry.characteristic->get_name();
-            if (!name || !*name) {
-                const ble_uuid128_t* uuid = reinterpret_cast<const ble_uuid128_t*>(entry.characteristic->get_uuid());
-                char generated_name[48];
-                snprintf(generated_name, sizeof(generated_name),
-                         "customble-%02x%02x%02x%02x-%zu",
-                         uuid->value[0], uuid->value[1], uuid->value[2], uuid->value[3], index);
-                generated_characteristic_names.emplace_back(generated_name);
-                name = generated_characteristic_names.back().c_str();
-            }
+            const char* source_name = binding_name(*entry.characteristic, index, generated_name);
+            size_t name_length = strlen(source_name);
+            char* name = next_binding + sizeof(ConnMgrBinding);
+            ConnMgrBinding binding = {entry.characteristic.get(), this, name};
+            memcpy(next_binding, &binding, sizeof(binding));
+            memcpy(name, source_name, name_length + 1);
+            next_binding = name + name_length + 1;
 
             esp_ble_conn_character_t chr = {};
             chr.name = name;
@@ -211,7 +367,6 @@ esp_err_t ServiceManager::register_with_conn_mgr() {
             chr.flag = convert_flags(entry.characteristic->get_flags());
             chr.uuid_fn = &ServiceManager::ble_conn_access_cb;
             chars.push_back(chr);
-            g_ble_conn_characteristics[name] = entry.characteristic.get();
         }
 
         esp_ble_conn_svc_t svc = {};
@@ -229,15 +384,281 @@ esp_err_t ServiceManager::register_with_conn_mgr() {
         }
     }
 
+    attach_characteristics();
     return ESP_OK;
 }
 
+void ServiceManager::attach_characteristics() {
+    size_t max_write_length = 0;
+    for (const auto& service : services) {
+        if (!service) {
+            continue;
+        }
+        for (const auto& entry : service->get_characteristics_manager().get_entries()) {
+            entry.characteristic->set_notification_engine(&notification_engine);
+            if (entry.characteristic->get_flags() & (BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_NO_RSP)) {
+                max_write_length = std::max<size_t>(max_write_length, entry.characteristic->get_max_length());
+            }
+        }
+    }
+    // Preallocate the per-connection write buffers once, sized for the longest writable value.
+    WriteBuffers::reserve(max_write_length);
+}
+
+size_t ServiceManager::index_handles() {
+    uint16_t low = UINT16_MAX;
+    uint16_t high = 0;
+    size_t indexed = 0;
+    for (const auto& service : services) {
+        if (!service) {
+            continue;
+        }
+        for (const auto& entry : service->get_characteristics_manager().get_entries()) {
+            Characteristic& characteristic = *entry.characteristic;
+            if (characteristic.get_handle() == 0) {
+                // Registered through the connection manager: NimBLE never saw our chr_def.
+                uint16_t handle = 0;
+                if (ble_gatts_find_chr(&service->get_uuid()->u, characteristic.get_uuid(), nullptr, &handle) == 0) {
+                    characteristic.set_handle(handle);
+                }
+            }
+            uint16_t handle = characteristic.get_handle();
+            if (handle != 0) {
+                low = std::min(low, handle);
+                high = std::max(high, handle);
+                ++indexed;
+            }
+        }
+    }
+    handle_index.clear();
+    handle_base = 0;
+    if (indexed == 0) {
+        return 0;
+    }
+    // Value handles of one table are dense (declaration, value, CCCD, descriptors), so a flat table wastes little.
+    handle_index.assign(static_cast<size_t>(high - low) + 1, nullptr);
+    handle_base = low;
+    for (const auto& service : services) {
+        if (!service) {
+            continue;
+        }
+        for (const auto& entry : service->get_characteristics_manager().get_entries()) {
+            uint16_t handle = entry.characteristic->get_handle();
+            if (handle != 0) {
+                handle_index[handle - low] = entry.characteristic.get();
+            }
+        }
+    }
+    return indexed;
+}
+
+void ServiceManager::index_uuids() {
+    size_t count = 0;
+    for (const auto& service : services) {
+        if (service) {
+            count += service->get_characteristics_manager().size();
+        }
+    }
+    // At most half full, so probe runs stay short.
+    size_t capacity = 2;
+    while (capacity < 2 * count) {
+        capacity <<= 1;
+    }
+    uuid_index.assign(capacity, nullptr);
+    for (const auto& service : services) {
+        if (!service) {
+            continue;
+        }
+        for (const auto& entry : service->get_characteristics_manager().get_entries()) {
+            const uint8_t* value = uuid_value(*entry.characteristic);
+            size_t slot = uuid_hash(value) & (capacity - 1);
+            while (uuid_index[slot] && memcmp(uuid_value(*uuid_index[slot]), value, BLE_UUID128_VAL_LEN) != 0) {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            // Duplicates keep the first registered characteristic.
+            if (!uuid_index[slot]) {
+                uuid_index[slot] = entry.characteristic.get();
+            }
+        }
+    }
+}
+
+Characteristic* ServiceManager::find_by_value_handle(uint16_t value_handle) {
+    if (value_handle == 0) {
+        return nullptr;
+    }
+    if (handle_index.empty()) {
+        index_handles();
+    }
+    size_t slot = static_cast<size_t>(value_handle - handle_base);
+    if (value_handle < handle_base || slot >= handle_index.size()) {
+        return nullptr;
+    }
+    return handle_index[slot];
+}
+
+Characteristic* ServiceManager::find_by_uuid(const ble_uuid128_t& uuid) const {
+    if (uuid_index.empty()) {
+        return nullptr;
+    }
+    size_t mask = uuid_index.size() - 1;
+    for (size_t slot = uuid_hash(uuid.value) & mask; uuid_index[slot]; slot = (slot + 1) & mask) {
+        if (memcmp(uuid_value(*uuid_index[slot]), uuid.value, BLE_UUID128_VAL_LEN) == 0) {
+            return uuid_index[slot];
+        }
+    }
+    return nullptr;
+}
+
+int ServiceManager::handle_gap_event(struct ble_gap_event* event) {
+    if (!event) {
+        return 0;
+    }
+    switch (event->type) {
+        case BLE_GAP_EVENT_SUBSCRIBE:
+            on_subscribe(event->subscribe.conn_handle, event->subscribe.attr_handle,
+                         event->subscribe.cur_notify, event->subscribe.cur_indicate);
+            break;
+        case BLE_GAP_EVENT_DISCONNECT:
+            on_disconnect(event->disconnect.conn.conn_handle);
+            break;
+        default:
+            break;
+    }
+    return 0;
+}
+
+int ServiceManager::gap_event_callback(struct ble_gap_event* event, void* arg) {
+    return static_cast<ServiceManager*>(arg)->handle_gap_event(event);
+}
+
+void ServiceManager::on_subscribe(uint16_t conn_handle, uint16_t attr_handle, bool notify, bool indicate) {
+    Characteristic* characteristic = find_by_value_handle(attr_handle);
+    if (characteristic) {
+        characteristic->on_subscribe(conn_handle, notify, indicate);
+    }
+}
+
+void ServiceManager::on_disconnect(uint16_t conn_handle) {
+    ReadSnapshots::drop(conn_handle);
+    WriteBuffers::drop(conn_handle);
+    for (const auto& service : services) {
+        if (!service) {
+            continue;
+        }
+        for (const auto& entry : service->get_characteristics_manager().get_entries()) {
+            entry.characteristic->on_disconnect(conn_handle);
+        }
+    }
+}
+
+size_t ServiceManager::notify_all() {
+    size_t scheduled = 0;
+    for (const auto& service : services) {
+        if (!service) {
+            continue;
+        }
+        for (const auto& entry : service->get_characteristics_manager().get_entries()) {
+            if (entry.characteristic->has_subscribers()) {
+                notification_engine.schedule(*entry.characteristic);
+                ++scheduled;
+            }
+        }
+    }
+    return scheduled;
+}
+
+size_t ServiceManager::flush_notifications() {
+    return notification_engine.flush();
+}
+
+#ifdef CONFIG_CUSTOMBLE_ACCESS_STATS
+AccessStats ServiceManager::get_access_stats() const {
+    AccessStats total;
+    for (const auto& service : services) {
+        if (!service) {
+            continue;
+        }
+        for (const auto& entry : service->get_characteristics_manager().get_entries()) {
+            total.merge(entry.characteristic->get_access_stats());
+        }
+    }
+    return total;
+}
+
+void ServiceManager::reset_access_stats() {
+    for (const auto& service : services) {
+        if (!service) {
+            continue;
+        }
+        for (const auto& entry : service->get_characteristics_manager().get_entries()) {
+            entry.characteristic->reset_access_stats();
+        }
+    }
+}
+
+std::shared_ptr<Service> ServiceManager::emplace_diagnostic_service(const ble_uuid128_t& service_uuid) {
+    auto service = emplace_service("Diagnostics", service_uuid);
+    if (!service) {
+        return nullptr;
+    }
+    auto derived_uuid = [&service_uuid](uint16_t increment) {
+        ble_uuid128_t uuid = service_uuid;
+        uint16_t alias = static_cast<uint16_t>(uuid.value[12] | (uuid.value[13] << 8)) + increment;
+        uuid.value[12] = static_cast<uint8_t>(alias);
+        uuid.value[13] = static_cast<uint8_t>(alias >> 8);
+        return uuid;
+    };
+    service->emplace_characteristic("Stats select", derived_uuid(1), nullptr, [this](ValueReader& in) {
+        uint8_t handle[2];
+        if (in.size() != sizeof(handle)) {
+            return static_cast<int>(BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN);
+        }
+        in.copy_to(handle, sizeof(handle));
+        diagnostic_selection = static_cast<uint16_t>(handle[0] | (handle[1] << 8));
+        return 0;
+    });
+    service->emplace_characteristic("Stats", derived_uuid(2), [this](ValueWriter& out) {
+        AccessStats stats;
+        if (diagnostic_selection == 0) {
+            stats = get_access_stats();
+        } else if (Characteristic* characteristic = find_by_value_handle(diagnostic_selection)) {
+            stats = characteristic->get_access_stats();
+        } else {
+            return static_cast<int>(BLE_ATT_ERR_INVALID_HANDLE);
+        }
+        uint8_t value[2 + 5 * 4 + LatencyHistogram::bucket_count * 4];
+        uint8_t* p = value;
+        auto put = [&p](uint32_t field, size_t size) {
+            for (size_t i = 0; i < size; ++i) {
+                *p++ = static_cast<uint8_t>(field >> (8 * i));
+            }
+        };
+        put(diagnostic_selection, 2);
+        put(stats.reads, 4);
+        put(stats.writes, 4);
+        put(stats.bytes_in, 4);
+        put(stats.bytes_out, 4);
+        put(stats.errors, 4);
+        for (size_t i = 0; i < LatencyHistogram::bucket_count; ++i) {
+            put(stats.latency.count(i), 4);
+        }
+        return out.append(value, sizeof(value));
+    });
+    return service;
+}
+#endif
+
 std::shared_ptr<Service> ServiceManager::emplace_service(const ble_uuid128_t& uuid) {
     return emplace_service(nullptr, uuid);
 }
 
 std::shared_ptr<Service> ServiceManager::emplace_service(const char* name, const ble_uuid128_t& uuid) {
-    auto service = std::make_shared<Service>(name, uuid);
+    if (frozen) {
+        ESP_LOGE(TAG, "Service '%s' added after the GATT table was frozen; ignored", name ? name : "");
+        return nullptr;
+    }
+    auto service = std::allocate_shared<Service>(ArenaAllocator<Service>(arena), name, uuid, arena);
     add_service(service);
     return service;
 }
@@ -257,13 +678,125 @@ void ServiceManager::print() const {
     printf("%s", overview().c_str());
 }
 
-void ServiceManager::add_service(std::shared_ptr<Service> service) {
+ServiceManager::MemoryUsage ServiceManager::memory_usage() const {
+    return collect_memory_usage(nullptr);
+}
+
+std::string ServiceManager::memory_report() const {
+    std::string out = "ServiceManager memory report:\n";
+    collect_memory_usage(&out);
+    return out;
+}
+
+ServiceManager::MemoryUsage ServiceManager::collect_memory_usage(std::string* report) const {
+    MemoryUsage usage;
+    // Adds a block to a category and counts it as a heap allocation unless it lives in the arena.
+    auto account = [&](const void* ptr, size_t bytes, size_t& category) {
+        if (!ptr || bytes == 0) {
+            return bytes;
+        }
+        category += bytes;
+        if (!arena || !arena->contains(ptr)) {
+            usage.heap_bytes += bytes;
+            ++usage.heap_allocations;
+        }
+        return bytes;
+    };
+    auto vector_bytes = [](const auto& vector) {
+        return vector.capacity() * sizeof(vector[0]);
+    };
+    auto append = [&](const char* format, auto... args) {
+        if (report) {
+            char line[160];
+            snprintf(line, sizeof(line), format, args...);
+            *report += line;
+        }
+    };
+
+    account(services.data(), vector_bytes(services), usage.tables);
+    size_t service_index = 0;
+    for (const auto& service : services) {
+        if (!service) {
+            continue;
+        }
+        const CharacteristicsManager& characteristics = service->get_characteristics_manager();
+        const auto& entries = characteristics.get_entries();
+        const auto& chr_defs = characteristics.get_chr_def_table();
+        size_t object = account(service.get(), sizeof(Service), usage.objects);
+        size_t entry_table = account(entries.data(), vector_bytes(entries), usage.tables);
+        size_t chr_def_table = account(chr_defs.data(), vector_bytes(chr_defs), usage.tables);
+        const char* service_name = service->get_name();
+        append("Service [%zu] '%s': object %zu B, characteristic entries %zu B, chr_defs %zu B\n",
+               service_index++, service_name ? service_name : "", object, entry_table, chr_def_table);
+
+        for (size_t index = 0; index < entries.size(); ++index) {
+            const Characteristic& characteristic = *entries[index].characteristic;
+            size_t chr_object = account(&characteristic, sizeof(Characteristic), usage.objects);
+            usage.callbacks += Characteristic::callback_storage_size();
+            size_t descriptors = account(entries[index].descriptors.data(), vector_bytes(entries[index].descriptors), usage.descriptors);
+            // The extension and the read cache buffer are always separate heap blocks.
+            const Characteristic::Extension* ext = characteristic.extension.get();
+            size_t extension = ext ? sizeof(Characteristic::Extension) : 0;
+            if (extension > 0) {
+                usage.objects += extension;
+                usage.heap_bytes += extension;
+                ++usage.heap_allocations;
+            }
+            size_t cache = characteristic.get_read_cache().get_capacity();
+            if (cache > 0) {
+                usage.buffers += cache;
+                usage.heap_bytes += cache;
+                ++usage.heap_allocations;
+            }
+            const char* name = characteristic.get_name();
+            append("  [%zu] '%s': object %zu B (callbacks %zu B), extension %zu B, descriptors %zu B, read cache %zu B\n",
+                   index, name ? name : "", chr_object, Characteristic::callback_storage_size(), extension, descriptors, cache);
+        }
+    }
+    size_t svc_def_table = account(svc_defs.data(), vector_bytes(svc_defs), usage.tables);
+    append("Service definitions: %zu B\n", svc_def_table);
+    size_t handle_table = account(handle_index.data(), vector_bytes(handle_index), usage.tables);
+    size_t uuid_table = account(uuid_index.data(), vector_bytes(uuid_index), usage.tables);
+    append("Lookup indexes: handles %zu B, UUIDs %zu B\n", handle_table, uuid_table);
+
+    size_t conn_mgr_chrs = account(conn_mgr_characteristics.data(), vector_bytes(conn_mgr_characteristics), usage.conn_mgr);
+    for (const auto& chars : conn_mgr_characteristics) {
+        conn_mgr_chrs += account(chars.data(), vector_bytes(chars), usage.conn_mgr);
+    }
+    size_t conn_mgr_svcs = account(conn_mgr_services.data(), vector_bytes(conn_mgr_services), usage.conn_mgr);
+    size_t bindings = account(conn_mgr_bindings.data(), vector_bytes(conn_mgr_bindings), usage.conn_mgr);
+    size_t read_buffer = account(conn_mgr_read_buffer.data(), vector_bytes(conn_mgr_read_buffer), usage.conn_mgr);
+    append("Connection manager: characteristics %zu B, services %zu B, bindings/names %zu B, read buffer %zu B\n",
+           conn_mgr_chrs, conn_mgr_svcs, bindings, read_buffer);
+
+    size_t advertising = account(adv_data.data(), vector_bytes(adv_data), usage.advertising);
+    append("Advertising data: %zu B\n", advertising);
+
+    size_t write_buffers = WriteBuffers::allocated_bytes();
+    usage.buffers += write_buffers;
+    usage.heap_bytes += write_buffers;
+    usage.heap_allocations += WriteBuffers::allocation_count();
+    append("Write buffers (shared): %zu B\n", write_buffers);
+
+    append("Total: %zu B (callbacks %zu B), heap %zu B in %zu allocations\n",
+           usage.total(), usage.callbacks, usage.heap_bytes, usage.heap_allocations);
+    if (arena) {
+        append("Arena: %zu of %zu B used\n", arena->used(), arena->capacity());
+    }
+    return usage;
+}
+
+esp_err_t ServiceManager::add_service(std::shared_ptr<Service> service) {
+    if (frozen) {
+        ESP_LOGE(TAG, "Service added after the GATT table was frozen; ignored");
+        return ESP_ERR_INVALID_STATE;
+    }
     services.push_back(std::move(service));
-    update_svc_defs();
+    return ESP_OK;
 }
 
 ble_gatt_svc_def* ServiceManager::get_svc_defs() {
-    update_svc_defs();
+    freeze();
     if (svc_defs.empty()) {
         return nullptr;
     }
@@ -274,7 +807,10 @@ size_t ServiceManager::size() const {
     return services.size();
 }
 
-void ServiceManager::update_svc_defs() {
+void ServiceManager::freeze() {
+    if (frozen) {
+        return;
+    }
     svc_defs.clear();
     svc_defs.reserve(services.size() + 1);
 
@@ -282,6 +818,7 @@ void ServiceManager::update_svc_defs() {
         if (!service) {
             continue;
         }
+        // Lays out the service's characteristic table exactly once.
         ble_gatt_svc_def svc_def = service->get_svc_def();
         if (svc_def.type == BLE_GATT_SVC_TYPE_END) {
             continue;
@@ -296,48 +833,55 @@ void ServiceManager::update_svc_defs() {
     ble_gatt_svc_def end_marker = {};
     end_marker.type = BLE_GATT_SVC_TYPE_END;
     svc_defs.push_back(end_marker);
+    index_uuids();
+    frozen = true;
 }
 
 void ServiceManager::populate_adv_data(esp_ble_conn_config_t &config) {
     adv_data.clear();
-    // For each registered service, if it has a 128-bit UUID, add a Complete List of 128-bit Service UUIDs AD element.
-    // We will build a single AD element that contains all 128-bit UUIDs (if any).
-    std::vector<const ble_uuid128_t*> uuids128;
-    for (const auto &svc : services) {
-        const ble_uuid128_t* u = svc->get_uuid();
-        if (u) {
-            uuids128.push_back(u);
-        }
-    }
-    if (uuids128.empty()) {
+    bool has_services = std::any_of(services.begin(), services.end(),
+                                    [](const auto& service) { return service != nullptr; });
+    if (!has_services) {
         config.periodic_adv_data = nullptr;
         config.periodic_adv_len = 0;
         return;
     }
+    AdvertisingBuilder builder;
+    const char* device_name = reinterpret_cast<const char*>(config.device_name);
+    builder.set_name(device_name, strnlen(device_name, MAX_BLE_DEVNAME_LEN));
+    add_service_uuids(builder);
+    builder.build(AdvertisingBuilder::Mode::Extended);
+    size_t extended_len = builder.get_adv_length();
+    adv_data.assign(builder.get_adv_data(), builder.get_adv_data() + extended_len);
+
+    // Periodic advertising must not carry flags: a second pass without them,
+    // which may fit more than the extended payload does.
+    builder.set_flags(0);
+    builder.build(AdvertisingBuilder::Mode::Extended);
+    adv_data.insert(adv_data.end(), builder.get_adv_data(), builder.get_adv_data() + builder.get_adv_length());
 
-    // AD format: <len = 1 + (16 * n)><type=0x07><16*n bytes UUIDs (each little-endian)>
-    size_t payload_len = 1 + uuids128.size() * 16; // 1 for type
-    if (payload_len > 0xFF) {
-        // unlikely, but guard
-        payload_len = 0xFF;
-    }
-    adv_data.reserve(2 + payload_len);
-    adv_data.push_back(static_cast<uint8_t>(payload_len));
-    adv_data.push_back(0x07); // Complete list of 128-bit Service UUIDs
+    // Populate both extended and periodic advertising fields so callers can
+    // choose either mode at runtime. Both live in adv_data, set up last so
+    // neither pointer is invalidated by the buffer growing.
+    config.extended_adv_data = reinterpret_cast<const char*>(adv_data.data());
+    config.extended_adv_len = static_cast<uint16_t>(extended_len);
+    config.periodic_adv_data = reinterpret_cast<const char*>(adv_data.data() + extended_len);
+    config.periodic_adv_len = static_cast<uint16_t>(adv_data.size() - extended_len);
+}
 
-    for (const auto *u : uuids128) {
-        // bleed_uuid128_t stores value[] likely little-endian already as used elsewhere
-        for (int i = 0; i < 16; ++i) {
-            adv_data.push_back(u->value[i]);
+int ServiceManager::add_service_uuids(AdvertisingBuilder& builder) const {
+    for (size_t index = 0; index < services.size(); ++index) {
+        if (!services[index]) {
+            continue;
+        }
+        int rc = builder.add_service_uuid(&services[index]->get_uuid()->u);
+        if (rc != 0) {
+            ESP_LOGW(TAG, "Advertising builder full, %u service UUID(s) left out",
+                     static_cast<unsigned>(services.size() - index));
+            return rc;
         }
     }
-
-    // Populate both extended and periodic advertising fields so callers can
-    // choose either mode at runtime (extended advertising or periodic adv).
-    config.extended_adv_data = reinterpret_cast<const char*>(adv_data.data());
-    config.extended_adv_len = adv_data.size();
-    config.periodic_adv_data = reinterpret_cast<const char*>(adv_data.data());
-    config.periodic_adv_len = adv_data.size();
+    return 0;
 }
 
 } // namespace CustomBLE
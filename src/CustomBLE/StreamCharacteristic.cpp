@@ -0,0 +1,291 @@
+#include "CustomBLE/StreamCharacteristic.hpp"
+#include <algorithm>
+#include <nimble/nimble_port.h>
+
+static const char *TAG = "CustomBLE/StreamCharacteristic";
+
+namespace CustomBLE {
+namespace {
+
+constexpr size_t command_size = 7;
+constexpr size_t status_size = 13;
+// produce(): the packet could not take the data for lack of mbufs.
+constexpr int out_of_buffers = StreamCharacteristic::end_of_stream - 1;
+
+uint32_t get_le32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+void put_le(uint8_t*& p, uint32_t value, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        *p++ = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+} // namespace
+
+std::shared_ptr<StreamCharacteristic> StreamCharacteristic::create(const char* name, const ble_uuid128_t& uuid, Producer producer) {
+    return std::make_shared<StreamCharacteristic>(Token {}, name, uuid, std::move(producer));
+}
+
+StreamCharacteristic::StreamCharacteristic(Token, const char* name, const ble_uuid128_t& uuid, Producer producer)
+    : Characteristic(name, uuid, ReadCallback(), WriteCallback()), producer(std::move(producer)) {
+    ble_npl_event_init(&event, &StreamCharacteristic::event_handler, this);
+    ble_npl_callout_init(&retry, nimble_port_get_dflt_eventq(), &StreamCharacteristic::event_handler, this);
+    set_read_sink_callback([this](ValueWriter& out) { return write_status(out); });
+    set_write_view_callback([this](ValueReader& in) { return handle_control(in); });
+    set_max_length(status_size);
+}
+
+StreamCharacteristic::~StreamCharacteristic() {
+    ble_npl_eventq_remove(nimble_port_get_dflt_eventq(), &event);
+    ble_npl_callout_deinit(&retry);
+}
+
+void StreamCharacteristic::set_encoder(LzStreamEncoder* stream_encoder) {
+    encoder = stream_encoder;
+    raw_chunk = 0;
+    set_compression(encoder ? CompressStream : CompressNone);
+}
+
+void StreamCharacteristic::wake() {
+    post();
+}
+
+void StreamCharacteristic::post() {
+    if (!ble_npl_event_is_queued(&event)) {
+        ble_npl_eventq_put(nimble_port_get_dflt_eventq(), &event);
+    }
+}
+
+int StreamCharacteristic::handle_control(ValueReader& in) {
+    uint8_t command[command_size] = {};
+    if (in.empty() || in.size() > sizeof(command)) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+    in.copy_to(command, in.size());
+    uint16_t writer = access_conn_handle();
+    if (writer == BLE_HS_CONN_HANDLE_NONE) {
+        // Streams need a GATT connection to notify (not available through the connection manager).
+        return BLE_ATT_ERR_WRITE_NOT_PERMITTED;
+    }
+    bool active = state != State::Idle && state != State::Finished && ble_att_mtu(conn_handle) != 0;
+
+    switch (command[0]) {
+        case CommandStart:
+            if (in.size() != command_size) {
+                return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+            }
+            if (active && writer != conn_handle) {
+                ESP_LOGW(TAG, "START from connection %u while streaming to %u", writer, conn_handle);
+                return BLE_ATT_ERR_INSUFFICIENT_RES;
+            }
+            if (!get_subscriptions().notifies(writer)) {
+                return cccd_improperly_configured;
+            }
+            conn_handle = writer;
+            offset = get_le32(command + 1);
+            acknowledged = offset;
+            credits = static_cast<uint16_t>(command[5] | (command[6] << 8));
+            sequence = 0;
+            if (encoder) {
+                encoder->reset();
+            }
+            state = State::Streaming;
+            post();
+            return 0;
+        case CommandAck: {
+            if (in.size() != command_size) {
+                return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+            }
+            if (writer != conn_handle) {
+                return BLE_ATT_ERR_UNLIKELY;
+            }
+            uint32_t acked = get_le32(command + 1);
+            if (acked > acknowledged && acked <= offset) {
+                acknowledged = acked;
+                if (ack_callback) {
+                    ack_callback(acked);
+                }
+            }
+            uint32_t granted = credits + static_cast<uint32_t>(command[5] | (command[6] << 8));
+            credits = static_cast<uint16_t>(granted > UINT16_MAX ? UINT16_MAX : granted);
+            post();
+            return 0;
+        }
+        case CommandStop:
+            if (writer == conn_handle) {
+                state = State::Idle;
+            }
+            return 0;
+        default:
+            return BLE_ATT_ERR_UNLIKELY;
+    }
+}
+
+int StreamCharacteristic::write_status(ValueWriter& out) const {
+    // The notified value is the data stream: the status only answers GATT reads,
+    // so notify()/notify_all() never inject it into the stream.
+    if (access_conn_handle() == BLE_HS_CONN_HANDLE_NONE) {
+        return BLE_ATT_ERR_READ_NOT_PERMITTED;
+    }
+    uint8_t status[status_size];
+    uint8_t* p = status;
+    put_le(p, static_cast<uint8_t>(state), 1);
+    put_le(p, offset, 4);
+    put_le(p, acknowledged, 4);
+    put_le(p, credits, 2);
+    put_le(p, sequence, 2);
+    return out.append(status, sizeof(status));
+}
+
+int StreamCharacteristic::produce(os_mbuf* om, size_t capacity) {
+    if (encoder) {
+        return produce_compressed(om, capacity);
+    }
+    // Let the producer fill the mbuf segments in place, chaining new ones as they fill up.
+    os_mbuf* last = om;
+    while (SLIST_NEXT(last, om_next)) {
+        last = SLIST_NEXT(last, om_next);
+    }
+    size_t length = 0;
+    while (length < capacity) {
+        os_mbuf* segment = OS_MBUF_TRAILINGSPACE(last) ? last : os_msys_get(0, 0);
+        if (!segment) {
+            return length ? static_cast<int>(length) : out_of_buffers;
+        }
+        size_t space = std::min<size_t>(OS_MBUF_TRAILINGSPACE(segment), capacity - length);
+        int produced = producer(offset + static_cast<uint32_t>(length), segment->om_data + segment->om_len, space);
+        if (produced <= 0) {
+            if (segment != last) {
+                os_mbuf_free(segment);
+            }
+            return length ? static_cast<int>(length) : produced;
+        }
+        size_t added = std::min(static_cast<size_t>(produced), space);
+        if (segment != last) {
+            SLIST_NEXT(last, om_next) = segment;
+            last = segment;
+        }
+        segment->om_len += static_cast<uint16_t>(added);
+        OS_MBUF_PKTLEN(om) += static_cast<uint16_t>(added);
+        length += added;
+        if (added < space) {
+            break;  // the producer has no more for now: send what there is
+        }
+    }
+    return static_cast<int>(length);
+}
+
+int StreamCharacteristic::produce_compressed(os_mbuf* om, size_t capacity) {
+    // The producer writes straight into the encoder's window; the block is compressed into om.
+    uint8_t* raw = encoder->stage();
+    size_t want = std::min(raw_chunk ? raw_chunk : capacity, LzStreamEncoder::max_chunk);
+    int produced = producer(offset, raw, want);
+    if (produced <= 0) {
+        return produced;
+    }
+    size_t length = std::min(static_cast<size_t>(produced), want);
+    size_t packet_length = OS_MBUF_PKTLEN(om);
+    for (;;) {
+        ValueWriter writer(om, capacity);
+        if (encoder->compress_staged(length, writer) == 0) {
+            size_t packed = writer.size();
+            if (length == want) {
+                // Aim the next chunk at a full packet, assuming the data compresses alike.
+                raw_chunk = std::max<size_t>(1, std::min(length * capacity * 15 / 16 / packed, LzStreamEncoder::max_chunk));
+            }
+            return static_cast<int>(length);
+        }
+        // Drop the partial block before retrying.
+        os_mbuf_adj(om, -static_cast<int>(OS_MBUF_PKTLEN(om) - packet_length));
+        if (length == 1) {
+            // A single byte always fits a packet: the mbufs ran out.
+            return out_of_buffers;
+        }
+        // Compressed larger than a packet: send a prefix of the staged data.
+        length = std::max<size_t>(1, length * 3 / 4);
+        raw_chunk = length;
+    }
+}
+
+size_t StreamCharacteristic::pump() {
+    if (state == State::Waiting) {
+        state = State::Streaming;
+    }
+    uint16_t mtu = ble_att_mtu(conn_handle);
+    if (state != State::Streaming || mtu == 0) {
+        if (mtu == 0 && state == State::Streaming) {
+            // Disconnected: the central resumes with START at its acknowledged offset.
+            state = State::Idle;
+        }
+        return 0;
+    }
+    if (!get_subscriptions().notifies(conn_handle)) {
+        ESP_LOGD(TAG, "Connection %u disabled notifications, stopping the stream", conn_handle);
+        state = State::Idle;
+        return 0;
+    }
+    if (ble_npl_callout_is_active(&retry)) {
+        // Backing off after running out of buffers; the callout pumps again.
+        return 0;
+    }
+    // Notification: 3 bytes ATT header, then the sequence number.
+    size_t capacity = mtu - 3 - header_size;
+    size_t sent = 0;
+    while (credits > 0 && sent < burst_packets) {
+        // The packet is built in the mbuf that is sent: sequence number, then the payload.
+        uint8_t header[header_size] = {static_cast<uint8_t>(sequence), static_cast<uint8_t>(sequence >> 8)};
+        os_mbuf* om = os_msys_get_pkthdr(static_cast<uint16_t>(header_size + capacity), 0);
+        int produced = out_of_buffers;
+        if (om && os_mbuf_append(om, header, sizeof(header)) == 0) {
+            produced = produce(om, capacity);
+        }
+        if (produced == 0 || produced == out_of_buffers) {
+            if (om) {
+                os_mbuf_free_chain(om);
+            }
+            if (produced == 0) {
+                state = State::Waiting;
+            } else {
+                // Out of mbufs: give TX completions time to return some.
+                ble_npl_callout_reset(&retry, ble_npl_time_ms_to_ticks32(retry_delay_ms));
+            }
+            return sent;
+        }
+        bool last = produced < 0;
+        int rc = ble_gatts_notify_custom(conn_handle, get_handle(), om);
+        if (rc == BLE_HS_ENOMEM) {
+            ble_npl_callout_reset(&retry, ble_npl_time_ms_to_ticks32(retry_delay_ms));
+            return sent;
+        }
+        if (rc != 0) {
+            ESP_LOGW(TAG, "Stream notification failed: %d", rc);
+            state = State::Idle;
+            return sent;
+        }
+        if (encoder) {
+            encoder->commit();
+        }
+        ++sequence;
+        --credits;
+        ++sent;
+        if (last) {
+            state = State::Finished;
+            return sent;
+        }
+        offset += static_cast<uint32_t>(produced);
+    }
+    if (credits > 0) {
+        // Burst done: yield to other host work, continue in the next wakeup.
+        post();
+    }
+    return sent;
+}
+
+void StreamCharacteristic::event_handler(ble_npl_event* ev) {
+    static_cast<StreamCharacteristic*>(ble_npl_event_get_arg(ev))->pump();
+}
+
+} // namespace CustomBLE
@@ -0,0 +1,93 @@
+#include "CustomBLE/SubscriptionTable.hpp"
+
+namespace CustomBLE {
+namespace {
+
+constexpr uint32_t encode(uint16_t conn_handle, bool notify, bool indicate) {
+    return (static_cast<uint32_t>(conn_handle + 1) << 2) | (indicate ? 0x2u : 0u) | (notify ? 0x1u : 0u);
+}
+
+constexpr uint16_t decode_conn(uint32_t slot) {
+    return static_cast<uint16_t>((slot >> 2) - 1);
+}
+
+} // namespace
+
+SubscriptionTable::SubscriptionTable() {
+    clear();
+}
+
+bool SubscriptionTable::update(uint16_t conn_handle, bool notify, bool indicate) {
+    if (!notify && !indicate) {
+        remove(conn_handle);
+        return true;
+    }
+    std::atomic<uint32_t>* free_slot = nullptr;
+    for (auto& slot : slots) {
+        uint32_t value = slot.load(std::memory_order_relaxed);
+        if (value == 0) {
+            if (!free_slot) {
+                free_slot = &slot;
+            }
+            continue;
+        }
+        if (decode_conn(value) == conn_handle) {
+            slot.store(encode(conn_handle, notify, indicate), std::memory_order_release);
+            return true;
+        }
+    }
+    if (!free_slot) {
+        return false;
+    }
+    free_slot->store(encode(conn_handle, notify, indicate), std::memory_order_release);
+    return true;
+}
+
+void SubscriptionTable::remove(uint16_t conn_handle) {
+    for (auto& slot : slots) {
+        uint32_t value = slot.load(std::memory_order_relaxed);
+        if (value != 0 && decode_conn(value) == conn_handle) {
+            slot.store(0, std::memory_order_release);
+        }
+    }
+}
+
+void SubscriptionTable::clear() {
+    for (auto& slot : slots) {
+        slot.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t SubscriptionTable::count() const {
+    size_t n = 0;
+    for (const auto& slot : slots) {
+        if (slot.load(std::memory_order_acquire) != 0) {
+            ++n;
+        }
+    }
+    return n;
+}
+
+bool SubscriptionTable::notifies(uint16_t conn_handle) const {
+    for (const auto& slot : slots) {
+        uint32_t value = slot.load(std::memory_order_acquire);
+        if (value != 0 && decode_conn(value) == conn_handle) {
+            return (value & 0x1u) != 0;
+        }
+    }
+    return false;
+}
+
+size_t SubscriptionTable::snapshot(Subscriber* out, size_t capacity) const {
+    size_t n = 0;
+    for (const auto& slot : slots) {
+        uint32_t value = slot.load(std::memory_order_acquire);
+        if (value == 0 || n >= capacity) {
+            continue;
+        }
+        out[n++] = {decode_conn(value), (value & 0x1u) != 0, (value & 0x2u) != 0};
+    }
+    return n;
+}
+
+} // namespace CustomBLE
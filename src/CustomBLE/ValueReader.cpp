@@ -0,0 +1,53 @@
+#include "CustomBLE/ValueReader.hpp"
+#include <cstring>
+
+namespace CustomBLE {
+namespace {
+
+// Flattening target for multi-segment writes; only touched from the NimBLE host task.
+uint8_t flatten_buffer[BLE_ATT_ATTR_MAX_LEN];
+
+} // namespace
+
+ValueReader::ValueReader(const os_mbuf* om)
+    : om(om), length(om ? OS_MBUF_PKTLEN(om) : 0) {
+}
+
+ValueReader::ValueReader(const uint8_t* data, size_t len)
+    : flat(data), length(data ? len : 0) {
+}
+
+int ValueReader::copy_to(void* dst, size_t len, size_t offset) const {
+    if (offset > length || len > length - offset) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+    if (len == 0) {
+        return 0;
+    }
+    if (!om) {
+        std::memcpy(dst, flat + offset, len);
+        return 0;
+    }
+    return os_mbuf_copydata(om, static_cast<int>(offset), static_cast<int>(len), dst) == 0
+        ? 0 : BLE_ATT_ERR_UNLIKELY;
+}
+
+std::string_view ValueReader::view() const {
+    if (!om) {
+        return std::string_view(reinterpret_cast<const char*>(flat), length);
+    }
+    if (!SLIST_NEXT(om, om_next)) {
+        return std::string_view(reinterpret_cast<const char*>(om->om_data), om->om_len);
+    }
+    uint16_t copied = 0;
+    ble_hs_mbuf_to_flat(om, flatten_buffer, sizeof(flatten_buffer), &copied);
+    return std::string_view(reinterpret_cast<const char*>(flatten_buffer), copied);
+}
+
+std::string ValueReader::to_string() const {
+    std::string out(length, '\0');
+    copy_to(&out[0], length);
+    return out;
+}
+
+} // namespace CustomBLE
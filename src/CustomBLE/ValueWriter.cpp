@@ -0,0 +1,93 @@
+#include "CustomBLE/ValueWriter.hpp"
+#include <cstdint>
+#include <cstring>
+
+namespace CustomBLE {
+
+ValueWriter::ValueWriter(os_mbuf* om)
+    : target(Target::Mbuf), om(om), capacity(SIZE_MAX) {
+}
+
+ValueWriter::ValueWriter(os_mbuf* om, size_t capacity)
+    : target(Target::Mbuf), om(om), capacity(capacity) {
+}
+
+ValueWriter::ValueWriter(uint8_t* buffer, size_t capacity)
+    : target(Target::Flat), buffer(buffer), capacity(capacity) {
+}
+
+ValueWriter::ValueWriter(std::string& out)
+    : target(Target::String), str(&out) {
+}
+
+int ValueWriter::append(const void* data, size_t len) {
+    if (len == 0) {
+        return 0;
+    }
+    switch (target) {
+        case Target::Mbuf:
+            if (len > UINT16_MAX || len > capacity - written ||
+                os_mbuf_append(om, data, static_cast<uint16_t>(len)) != 0) {
+                return BLE_ATT_ERR_INSUFFICIENT_RES;
+            }
+            break;
+        case Target::Flat:
+            if (len > capacity - written) {
+                return BLE_ATT_ERR_INSUFFICIENT_RES;
+            }
+            std::memcpy(buffer + written, data, len);
+            break;
+        case Target::String:
+            str->append(static_cast<const char*>(data), len);
+            break;
+    }
+    written += len;
+    return 0;
+}
+
+int ValueWriter::overwrite(size_t offset, const void* data, size_t len) {
+    if (offset > written || len > written - offset) {
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+    switch (target) {
+        case Target::Mbuf: {
+            // The mbuf may have held data before this writer was bound to it.
+            size_t position = OS_MBUF_PKTLEN(om) - written + offset;
+            if (os_mbuf_copyinto(om, static_cast<int>(position), data, static_cast<int>(len)) != 0) {
+                return BLE_ATT_ERR_UNLIKELY;
+            }
+            break;
+        }
+        case Target::Flat:
+            std::memcpy(buffer + offset, data, len);
+            break;
+        case Target::String:
+            str->replace(str->size() - written + offset, len, static_cast<const char*>(data), len);
+            break;
+    }
+    return 0;
+}
+
+int ValueWriter::copy_appended(size_t offset, void* out, size_t len) const {
+    if (offset > written || len > written - offset) {
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+    switch (target) {
+        case Target::Mbuf: {
+            size_t position = OS_MBUF_PKTLEN(om) - written + offset;
+            if (os_mbuf_copydata(om, static_cast<int>(position), static_cast<int>(len), out) != 0) {
+                return BLE_ATT_ERR_UNLIKELY;
+            }
+            break;
+        }
+        case Target::Flat:
+            std::memcpy(out, buffer + offset, len);
+            break;
+        case Target::String:
+            str->copy(static_cast<char*>(out), len, str->size() - written + offset);
+            break;
+    }
+    return 0;
+}
+
+} // namespace CustomBLE
@@ -0,0 +1,87 @@
+#include "CustomBLE/WriteBuffers.hpp"
+#include <host/ble_hs.h>
+
+namespace CustomBLE {
+namespace {
+
+#ifdef CONFIG_BT_NIMBLE_MAX_CONNECTIONS
+constexpr size_t buffer_slots = CONFIG_BT_NIMBLE_MAX_CONNECTIONS;
+#else
+constexpr size_t buffer_slots = 4;
+#endif
+
+struct Slot {
+    uint16_t conn_handle {BLE_HS_CONN_HANDLE_NONE};
+    std::string buffer;
+};
+
+Slot slots[buffer_slots];
+size_t reserved = 0;
+
+} // namespace
+
+void WriteBuffers::reserve(size_t capacity) {
+    if (capacity <= reserved) {
+        return;
+    }
+    for (auto& slot : slots) {
+        slot.buffer.reserve(capacity);
+    }
+    reserved = capacity;
+}
+
+size_t WriteBuffers::capacity() {
+    return reserved;
+}
+
+size_t WriteBuffers::allocated_bytes() {
+    size_t bytes = 0;
+    for (const auto& slot : slots) {
+        // Capacities up to the small-string buffer live inside the slot itself.
+        if (slot.buffer.capacity() > std::string().capacity()) {
+            bytes += slot.buffer.capacity() + 1;
+        }
+    }
+    return bytes;
+}
+
+size_t WriteBuffers::allocation_count() {
+    size_t count = 0;
+    for (const auto& slot : slots) {
+        if (slot.buffer.capacity() > std::string().capacity()) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+std::string* WriteBuffers::acquire(uint16_t conn_handle) {
+    if (reserved == 0 || conn_handle == BLE_HS_CONN_HANDLE_NONE) {
+        return nullptr;
+    }
+    Slot* free_slot = nullptr;
+    for (auto& slot : slots) {
+        if (slot.conn_handle == conn_handle) {
+            return &slot.buffer;
+        }
+        if (slot.conn_handle == BLE_HS_CONN_HANDLE_NONE && !free_slot) {
+            free_slot = &slot;
+        }
+    }
+    if (!free_slot) {
+        return nullptr;
+    }
+    free_slot->conn_handle = conn_handle;
+    return &free_slot->buffer;
+}
+
+void WriteBuffers::drop(uint16_t conn_handle) {
+    for (auto& slot : slots) {
+        if (slot.conn_handle == conn_handle) {
+            slot.conn_handle = BLE_HS_CONN_HANDLE_NONE;
+            slot.buffer.clear();
+        }
+    }
+}
+
+} // namespace CustomBLE